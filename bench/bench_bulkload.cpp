@@ -0,0 +1,198 @@
+// Loading a full arrangement: every bundled PCMEnv-data/*.synthSequence back
+// to back, ten times over (thousands of notes). Compares setup time and peak
+// heap for
+//   per note: what SynthSequencer::add and playSequence do, a voice allocated
+//     up front for every note and an ordered insert into a list of events;
+//   bulk: readSynthSequence into one vector, one sort, and PatternPlayer
+//     taking voices from a fixed pool (VoicePool) only as notes fire.
+// The voice here is a stand-in with PCMEnv's 1 KB envelope block and the
+// note's parameters; allolib's real voices also own their parameters, so
+// the per-note figures are a lower bound. The bulk arrangement is then
+// played through to check the pool is never exhausted. Run from the
+// repository root; exits non-zero if voices ran out or notes went missing.
+
+#include <glob.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "SequenceFile.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+const int REPEATS = 10;
+const int RATE = 48000;
+const int BUFFER = 128;
+const int POOL = 64; // VoiceManager's default maxVoices
+
+// Heap accounting: every allocation carries its size in front
+std::atomic<long> liveBytes{0}, peakBytes{0};
+
+void* operator new(size_t size)
+{
+  size_t* block = static_cast<size_t*>(std::malloc(size + 16));
+  if (!block)
+  {
+    throw std::bad_alloc();
+  }
+  *block = size;
+  long live = liveBytes += long(size);
+  long peak = peakBytes.load();
+  while (live > peak && !peakBytes.compare_exchange_weak(peak, live))
+  {
+  }
+  return reinterpret_cast<char*>(block) + 16;
+}
+
+void operator delete(void* pointer) noexcept
+{
+  if (pointer)
+  {
+    size_t* block = reinterpret_cast<size_t*>(static_cast<char*>(pointer) - 16);
+    liveBytes -= long(*block);
+    std::free(block);
+  }
+}
+
+void operator delete(void* pointer, size_t) noexcept { operator delete(pointer); }
+
+struct StandInVoice
+{
+  float envelope[256]; // PCMEnv::BLOCK floats
+  PatternEvent parameters;
+  bool active = false;
+  float freeAt = 0;
+};
+
+struct ListEvent
+{
+  double start, duration;
+  StandInVoice* voice;
+};
+
+struct Measure
+{
+  double us;
+  long peak, kept;
+};
+
+template <typename Load>
+Measure measure(Load load)
+{
+  long base = liveBytes.load();
+  peakBytes = base;
+  auto start = Clock::now();
+  load();
+  return {std::chrono::duration<double, std::micro>(Clock::now() - start).count(), peakBytes - base,
+          liveBytes - base};
+}
+
+int main()
+{
+  glob_t matches;
+  glob("PCMEnv-data/*.synthSequence", 0, nullptr, &matches);
+  std::vector<std::string> paths(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+  globfree(&matches);
+  if (paths.empty())
+  {
+    return 1;
+  }
+
+  // Per note: a voice each, inserted in time order as it is read
+  std::list<ListEvent> eager;
+  Measure perNote = measure([&] {
+    double end = 0;
+    std::vector<PatternEvent> file;
+    for (int r = 0; r < REPEATS; r++)
+    {
+      for (const std::string& path : paths)
+      {
+        file.clear();
+        end = readSynthSequence(path, file, end);
+        for (const PatternEvent& e : file)
+        {
+          StandInVoice* voice = new StandInVoice();
+          voice->parameters = e;
+          auto at = eager.begin();
+          while (at != eager.end() && at->start <= e.start)
+          {
+            ++at;
+          }
+          eager.insert(at, {e.start, e.duration, voice});
+        }
+      }
+    }
+  });
+
+  // Bulk: one vector, one sort, a fixed pool
+  PatternBuffer bulk;
+  std::vector<StandInVoice> pool;
+  Measure batched = measure([&] {
+    double end = 0;
+    for (int r = 0; r < REPEATS; r++)
+    {
+      for (const std::string& path : paths)
+      {
+        end = readSynthSequence(path, bulk.events, end);
+      }
+    }
+    bulk.finish();
+    pool.resize(POOL);
+  });
+
+  std::cout << eager.size() << " notes from " << paths.size() << " files x " << REPEATS << std::endl;
+  std::cout << "per note: " << perNote.us / 1000 << " ms setup, " << perNote.peak / 1024 << " KB peak, "
+            << perNote.kept / 1024 << " KB held" << std::endl;
+  std::cout << "bulk:     " << batched.us / 1000 << " ms setup, " << batched.peak / 1024 << " KB peak, "
+            << batched.kept / 1024 << " KB held (" << sizeof(PatternEvent) << " bytes a note, " << POOL
+            << " pooled voices)" << std::endl;
+
+  // Play the bulk arrangement, voices busy from note-on to note-off plus release
+  PatternPlayer player;
+  player.play(bulk.begin(), bulk.end(), RATE);
+  long fired = 0, exhausted = 0, busiest = 0;
+  for (long callback = 0; !player.done(); callback++)
+  {
+    float now = float(callback) * BUFFER / RATE;
+    long busy = 0;
+    for (StandInVoice& voice : pool)
+    {
+      voice.active = voice.active && voice.freeAt > now;
+      busy += voice.active;
+    }
+    busiest = std::max(busiest, busy);
+
+    player.advance(
+      BUFFER,
+      [&](const PatternEvent& e, int, int) {
+        fired++;
+        for (StandInVoice& voice : pool)
+        {
+          if (!voice.active)
+          {
+            voice.active = true;
+            voice.parameters = e;
+            voice.freeAt = e.start + e.duration + e.release;
+            return;
+          }
+        }
+        exhausted++;
+      },
+      [](int, int) {});
+  }
+
+  std::cout << "played: " << fired << " notes fired, at most " << busiest << " of " << POOL << " voices busy, "
+            << exhausted << " found the pool empty" << std::endl;
+
+  for (ListEvent& e : eager)
+  {
+    delete e.voice;
+  }
+  return fired == long(eager.size()) && exhausted == 0 ? 0 : 1;
+}
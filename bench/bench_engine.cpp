@@ -0,0 +1,249 @@
+// Voices per core at 128-frame buffers for the two voice engines: one heap
+// object per note with a virtual onProcess (PCMEnv's shape), against proxies
+// that forward their controls to PCMVoiceEngine, which renders every slot in
+// one pass. Both read the same set of samples with the same parameters.
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "VoiceEngine.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+const int BUFFER = 128;
+const int RATE = 48000;
+const int BLOCKS = 1000;
+const int RUNS = 3;
+const int SAMPLES = 16;
+const float ATTACK = 0.01f;
+
+// Stands in for SynthVoice's internal parameters, looked up by name
+struct Parameters
+{
+  std::map<std::string, float> values{
+    {"amplitude", 0.8f}, {"pan", 0.3f}, {"interpolate", INTERP_LINEAR}, {"attackTime", ATTACK}, {"releaseTime", 0.5f}};
+
+  float get(const std::string& name) const { return values.find(name)->second; }
+};
+
+void panGains(float pan, float& left, float& right)
+{
+  float angle = (pan + 1) * float(M_PI) / 4;
+  left = std::cos(angle);
+  right = std::sin(angle);
+}
+
+struct Voice
+{
+  virtual ~Voice() {}
+  virtual void onProcess(float* left, float* right) = 0;
+};
+
+// Per-frame envelope object, called like gam::Env; same ramps as the engine's
+struct LinearEnv
+{
+  float level = 0, step = 1;
+
+  float operator()()
+  {
+    float out = level;
+    if (level < 1)
+    {
+      level += step;
+      if (level >= 1)
+      {
+        level = 1;
+      }
+    }
+    return out;
+  }
+};
+
+// PCMEnv's layout and per-block work, minus allolib
+struct ObjectVoice : Voice
+{
+  Parameters parameters;
+  LinearEnv env;
+  char graphics[1024]; // PCMEnv also carries a Mesh and unused oscillators
+  SampleReader reader;
+  int length = 0;
+  PlayHead head;
+  float envelope[PCMVoiceEngine::BLOCK];
+  ParamRamp leftGain, rightGain;
+  bool primed = false;
+  float lastPan = 2, panLeft = 0, panRight = 0;
+
+  void onProcess(float* left, float* right) override
+  {
+    int interpolation = parameters.get("interpolate");
+    float amplitude = parameters.get("amplitude");
+    float pan = parameters.get("pan");
+    env.step = 1 / std::max(parameters.get("attackTime") * RATE, 1.f);
+    parameters.get("releaseTime");
+
+    if (pan != lastPan)
+    {
+      panGains(pan, panLeft, panRight);
+      lastPan = pan;
+    }
+
+    float gain = amplitude / 2;
+    if (primed)
+    {
+      leftGain.rampTo(gain * panLeft, BUFFER);
+      rightGain.rampTo(gain * panRight, BUFFER);
+    }
+    else
+    {
+      leftGain.reset(gain * panLeft);
+      rightGain.reset(gain * panRight);
+      primed = true;
+    }
+
+    for (int i = 0; i < BUFFER; i++)
+    {
+      envelope[i] = env();
+    }
+    renderPCM(reader, length, head, interpolation, envelope, leftGain, rightGain, left, right, BUFFER);
+    leftGain.settle();
+    rightGain.settle();
+  }
+};
+
+// PCMBatchVoice: per-block snapshot, then the engine does the rest
+struct ProxyVoice : Voice
+{
+  Parameters parameters;
+  char graphics[1024];
+  int slot = -1;
+  float lastPan = 2, panLeft = 0, panRight = 0;
+
+  void onProcess(float*, float*) override
+  {
+    float amplitude = parameters.get("amplitude");
+    float pan = parameters.get("pan");
+
+    if (pan != lastPan)
+    {
+      panGains(pan, panLeft, panRight);
+      lastPan = pan;
+    }
+
+    float gain = amplitude / 2;
+    pcmVoiceEngine().control(slot, parameters.get("interpolate"), gain * panLeft, gain * panRight,
+                             parameters.get("attackTime"), parameters.get("releaseTime"));
+  }
+};
+
+// Voice v's sample and rate; samples are spread so neighbours rarely share one
+int sampleFor(int v) { return v * 7 % SAMPLES; }
+float rateFor(int v) { return std::exp2((v * 5 % 13 - 12) / 12.f); }
+
+// Allocate voices one by one between other allocations, as a long-running
+// PolySynth's voices end up scattered over the heap
+template <class T>
+std::vector<std::unique_ptr<Voice>> scatter(int count, std::vector<std::unique_ptr<char[]>>& clutter)
+{
+  std::vector<std::unique_ptr<Voice>> voices;
+  for (int v = 0; v < count; v++)
+  {
+    clutter.emplace_back(new char[512 + v * 97 % 4096]);
+    voices.emplace_back(new T());
+  }
+  return voices;
+}
+
+// Nanoseconds per 128-frame block for all voices; `mix` holds the last block
+double timeBlocks(std::vector<std::unique_ptr<Voice>>& voices, bool batched, std::vector<float>& mix)
+{
+  auto start = Clock::now();
+
+  for (int block = 0; block < BLOCKS; block++)
+  {
+    std::fill(mix.begin(), mix.end(), 0.f);
+    for (auto& voice : voices)
+    {
+      voice->onProcess(mix.data(), mix.data() + BUFFER);
+    }
+    if (batched)
+    {
+      pcmVoiceEngine().render(mix.data(), mix.data() + BUFFER, BUFFER);
+    }
+  }
+
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / BLOCKS;
+}
+
+int main()
+{
+  pcmVoiceEngine().sampleRate = RATE;
+
+  // Long enough that no voice runs out during a run
+  std::vector<std::unique_ptr<SampleBuffer>> samples;
+  int length = BUFFER * BLOCKS * RUNS + 1024;
+  for (int s = 0; s < SAMPLES; s++)
+  {
+    auto pcm = std::make_shared<std::vector<int16_t>>(length);
+    for (int i = 0; i < length; i++)
+    {
+      (*pcm)[i] = clampToPcm16(0.5 * std::sin(2 * M_PI * (110 + 20 * s) * i / RATE));
+    }
+    samples.emplace_back(new SampleBuffer("tone"));
+    samples.back()->adopt(pcm->data(), length, RATE, s, pcm);
+  }
+
+  double budget = 1e9 * BUFFER / RATE;
+  std::cout << BUFFER << "-frame buffers at " << RATE << " Hz, " << SAMPLES << " samples, linear interpolation"
+            << std::endl;
+
+  for (int count : {32, 128, 256})
+  {
+    std::vector<std::unique_ptr<char[]>> clutter;
+    auto objects = scatter<ObjectVoice>(count, clutter);
+    auto proxies = scatter<ProxyVoice>(count, clutter);
+
+    for (int v = 0; v < count; v++)
+    {
+      ObjectVoice& object = static_cast<ObjectVoice&>(*objects[v]);
+      object.reader = samples[sampleFor(v)]->read();
+      object.length = samples[sampleFor(v)]->playableFrames(object.reader);
+      object.head.start(rateFor(v));
+
+      ProxyVoice& proxy = static_cast<ProxyVoice&>(*proxies[v]);
+      proxy.slot = pcmVoiceEngine().start(*samples[sampleFor(v)], rateFor(v));
+    }
+
+    std::vector<float> objectMix(BUFFER * 2), batchMix(BUFFER * 2);
+
+    // Best of a few runs, to keep other load on the machine out of the figure
+    double objectNs = 1e30, batchNs = 1e30;
+    for (int run = 0; run < RUNS; run++)
+    {
+      objectNs = std::min(objectNs, timeBlocks(objects, false, objectMix));
+      batchNs = std::min(batchNs, timeBlocks(proxies, true, batchMix));
+    }
+
+    // Same notes from the same start, so only summation order differs
+    float difference = 0;
+    for (int i = 0; i < BUFFER * 2; i++)
+    {
+      difference = std::max(difference, std::fabs(objectMix[i] - batchMix[i]));
+    }
+
+    std::cout << count << " voices: per-object " << int(count * budget / objectNs) << " voices per core, batched "
+              << int(count * budget / batchNs) << " (" << objectNs / batchNs << "x), max difference "
+              << difference << std::endl;
+
+    for (auto& proxy : proxies)
+    {
+      pcmVoiceEngine().stop(static_cast<ProxyVoice&>(*proxy).slot);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,163 @@
+// Cost and accuracy of each playback interpolator: CPU cycles per output
+// frame on every available kernel, and how far below a transposed test tone
+// the interpolation and aliasing error sits.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "PCMKernel.hpp"
+
+const int RATE = 48000;
+const int BUFFER = 128;
+const char* INTERPOLATORS[] = {"none", "linear", "hermite", "lagrange", "sinc"};
+const char* KERNELS[] = {"scalar", "sse2", "avx2"};
+
+uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count(); // nanoseconds, not cycles
+#endif
+}
+
+std::vector<int16_t> tone(double frequency, int frames)
+{
+  std::vector<int16_t> out(frames);
+  for (int i = 0; i < frames; i++)
+  {
+    out[i] = clampToPcm16(0.5 * std::sin(2 * M_PI * frequency * i / RATE));
+  }
+  return out;
+}
+
+// Play `source` at `rate` and return the left channel
+std::vector<float> play(const std::vector<int16_t>& source, float rate, int interpolation, int frames)
+{
+  SampleReader reader;
+  reader.head = source.data();
+  reader.headFrames = source.size();
+
+  std::vector<float> env(BUFFER, 1.f), left(frames), right(frames);
+  ParamRamp leftGain, rightGain;
+  leftGain.reset(1);
+  rightGain.reset(0);
+  PlayHead head;
+  head.start(rate);
+
+  for (int done = 0; done < frames; done += BUFFER)
+  {
+    renderPCM(reader, source.size(), head, interpolation, env.data(), leftGain, rightGain,
+              left.data() + done, right.data() + done, std::min(BUFFER, frames - done));
+  }
+
+  return left;
+}
+
+// Signal-to-residual ratio after removing the best-fitting sine at the
+// expected output frequency; the residual is interpolation error plus aliases
+double rejection(const std::vector<float>& out, double frequency)
+{
+  double omega = 2 * M_PI * frequency / RATE;
+  double ss = 0, sc = 0, cc = 0, ys = 0, yc = 0;
+
+  // Skip the edges, where taps clamp to the first and last frame
+  size_t from = 64, to = out.size() - 64;
+  for (size_t n = from; n < to; n++)
+  {
+    double s = std::sin(omega * n), c = std::cos(omega * n);
+    ss += s * s;
+    sc += s * c;
+    cc += c * c;
+    ys += out[n] * s;
+    yc += out[n] * c;
+  }
+
+  double det = ss * cc - sc * sc;
+  double a = (ys * cc - yc * sc) / det, b = (yc * ss - ys * sc) / det;
+  double signal = 0, error = 0;
+
+  for (size_t n = from; n < to; n++)
+  {
+    double fit = a * std::sin(omega * n) + b * std::cos(omega * n);
+    signal += fit * fit;
+    error += (out[n] - fit) * (out[n] - fit);
+  }
+
+  return 10 * std::log10(signal / error);
+}
+
+int main()
+{
+  struct Case { const char* name; double frequency; float semitones; };
+  const Case cases[] = {
+    {"5 kHz, down 7", 5000, -7},
+    {"15 kHz, down 7", 15000, -7},
+    {"2 kHz, down 24", 2000, -24},
+    {"6 kHz, up 7", 6000, 7},
+  };
+
+  std::cout << "error rejection (dB below the tone)" << std::endl << std::setw(10) << "";
+  for (const Case& test : cases)
+  {
+    std::cout << std::setw(17) << test.name;
+  }
+  std::cout << std::endl << std::fixed << std::setprecision(1);
+
+  for (int interpolation = 0; interpolation < INTERP_COUNT; interpolation++)
+  {
+    std::cout << std::setw(10) << INTERPOLATORS[interpolation];
+    for (const Case& test : cases)
+    {
+      float rate = std::exp2(test.semitones / 12.f);
+      std::vector<int16_t> source = tone(test.frequency, RATE);
+      std::vector<float> out = play(source, rate, interpolation, int((source.size() - 64) / rate) - 64);
+      std::cout << std::setw(17) << rejection(out, test.frequency * rate);
+    }
+    std::cout << std::endl;
+  }
+
+  PCMIsa detected = pcmIsa();
+  std::vector<int16_t> source = tone(440, RATE * 4);
+  int frames = RATE * 2;
+
+  std::cout << std::endl << "cycles per output frame, rate 1.06" << std::endl << std::setw(10) << "";
+  for (int isa = PCM_SCALAR; isa <= detected; isa++)
+  {
+    std::cout << std::setw(10) << KERNELS[isa];
+  }
+  std::cout << std::endl;
+
+  for (int interpolation = 0; interpolation < INTERP_COUNT; interpolation++)
+  {
+    std::cout << std::setw(10) << INTERPOLATORS[interpolation];
+    for (int isa = PCM_SCALAR; isa <= detected; isa++)
+    {
+      pcmIsa() = PCMIsa(isa);
+      play(source, 1.06f, interpolation, BUFFER); // warm up, and build the sinc table
+
+      // Best of a few runs, to keep other load on the machine out of the figure
+      uint64_t best = UINT64_MAX;
+      for (int run = 0; run < 5; run++)
+      {
+        uint64_t start = cycles();
+        play(source, 1.06f, interpolation, frames);
+        best = std::min(best, cycles() - start);
+      }
+      std::cout << std::setw(10) << double(best) / frames;
+    }
+    std::cout << std::endl;
+  }
+
+  pcmIsa() = detected;
+  return 0;
+}
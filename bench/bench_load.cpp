@@ -0,0 +1,109 @@
+// Compares the original per-frame SoundFile loader with SampleBuffer's bulk
+// decode over every WAV in timbre/. Run from the repository root.
+
+#include <glob.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "al/sound/al_SoundFile.hpp"
+
+#include "SampleBuffer.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<std::string> findSamples()
+{
+  std::vector<std::string> paths;
+  glob_t matches;
+
+  // Drum/ holds files directly; the other banks have one directory per timbre
+  glob("timbre/*/*.wav", 0, nullptr, &matches);
+  glob("timbre/*/*/*.wav", GLOB_APPEND, nullptr, &matches);
+  paths.assign(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+
+  globfree(&matches);
+  return paths;
+}
+
+// The loader as it was: one getFrame() and push_back per frame into floats
+size_t loadPerFrame(const std::string& path)
+{
+  std::vector<float> sampleData;
+  al::SoundFile file;
+  file.open(path.c_str());
+
+  for (long long int i = 0; i < file.frameCount; i++)
+  {
+    sampleData.push_back(file.getFrame(i)[0]);
+  }
+
+  return sampleData.size();
+}
+
+size_t loadBulk(const std::string& path)
+{
+  SampleBuffer buffer(path);
+  buffer.decode();
+  return buffer.frameCount;
+}
+
+// Bulk decode then widen to float, to compare like for like with the old path
+size_t loadBulkFloat(const std::string& path)
+{
+  SampleBuffer buffer(path);
+  buffer.decode();
+  std::vector<float> sampleData(buffer.frameCount);
+  pcm16ToFloat(buffer.frames, sampleData.data(), sampleData.size());
+  return sampleData.size();
+}
+
+template <class Loader>
+void run(const char* label, const std::vector<std::string>& paths, Loader load, int passes)
+{
+  double best = 1e9;
+  size_t frames = 0;
+
+  for (int pass = 0; pass < passes; pass++)
+  {
+    frames = 0;
+    auto start = Clock::now();
+
+    for (const std::string& path : paths)
+    {
+      frames += load(path);
+    }
+
+    best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+  }
+
+  std::cout << label << ": " << best << " ms for " << frames << " frames ("
+            << frames / best / 1000.0 << " Mframes/s)" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+  int passes = argc > 1 ? std::stoi(argv[1]) : 5;
+  std::vector<std::string> paths = findSamples();
+
+  if (paths.empty())
+  {
+    std::cout << "No samples found; run from the repository root" << std::endl;
+    return 1;
+  }
+
+  std::cout << paths.size() << " files, best of " << passes << " warm passes" << std::endl;
+
+  run("SoundFile getFrame/push_back", paths, loadPerFrame, passes);
+
+  SampleBuffer::useMmap() = false;
+  run("bulk decode (copy)", paths, loadBulk, passes);
+  run("bulk decode + int16->float", paths, loadBulkFloat, passes);
+
+  SampleBuffer::useMmap() = true;
+  run("bulk decode (mmap)", paths, loadBulk, passes);
+
+  return 0;
+}
@@ -0,0 +1,135 @@
+// Logger: cost of one write() from a busy thread against the std::cout line
+// it replaces, then four threads writing as fast as they can to check that
+// every record comes out once and in order per thread (or is counted as
+// dropped), and that PCM_LOG_RATE caps a burst. Exits non-zero if a check fails.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Logger.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+const int WRITES = 20000;
+const int THREADS = 4;
+const int PER_THREAD = 50000;
+const char* LOG_PATH = "/tmp/bench_log.txt";
+
+struct Percentiles
+{
+  double p50, p99, max;
+};
+
+Percentiles percentiles(std::vector<double>& ns)
+{
+  std::sort(ns.begin(), ns.end());
+  return {ns[ns.size() / 2], ns[ns.size() * 99 / 100], ns.back()};
+}
+
+int main()
+{
+  std::remove(LOG_PATH);
+  logger().open(LOG_PATH);
+  std::string name = "timbre/Indian/SITAR/60.wav";
+
+  // Per-call latency, paced so the drain thread keeps up
+  std::vector<double> logNs, streamNs;
+  FILE* sink = fopen("/dev/null", "w");
+  for (int i = 0; i < WRITES; i++)
+  {
+    auto start = Clock::now();
+    PCM_LOG(LOG_INFO, i, "\tSample:", name);
+    logNs.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+
+    start = Clock::now();
+    fprintf(sink, "%d\tSample:%s\n", i, name.c_str());
+    fflush(sink); // what std::endl does
+    streamNs.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+
+    if (i % 256 == 0)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(Logger::DRAIN_MS));
+    }
+  }
+  fclose(sink);
+  logger().flush();
+
+  Percentiles log = percentiles(logNs), stream = percentiles(streamNs);
+  std::cout << "write() ns:        p50 " << log.p50 << ", p99 " << log.p99 << ", max " << log.max << std::endl;
+  std::cout << "fprintf+fflush ns: p50 " << stream.p50 << ", p99 " << stream.p99 << ", max " << stream.max
+            << " (to /dev/null; a terminal is slower)" << std::endl;
+
+  // Flood from several threads at once
+  std::vector<std::thread> writers;
+  for (int t = 0; t < THREADS; t++)
+  {
+    writers.emplace_back([t] {
+      for (int i = 0; i < PER_THREAD; i++)
+      {
+        PCM_LOG(LOG_INFO, "flood ", t, " ", i);
+      }
+    });
+  }
+  for (std::thread& writer : writers)
+  {
+    writer.join();
+  }
+
+  logger().flush();
+
+  // A burst through one rate-limited call site
+  for (int i = 0; i < 1000; i++)
+  {
+    PCM_LOG_RATE(LOG_INFO, 20, "burst ", i);
+  }
+  logger().flush();
+
+  std::ifstream file(LOG_PATH);
+  std::string line;
+  std::vector<int> last(THREADS, -1);
+  long received = 0, dropped = 0, bursts = 0;
+  bool ordered = true, flooding = false;
+
+  while (std::getline(file, line))
+  {
+    std::istringstream fields(line);
+    std::string time, level, word;
+    fields >> time >> level >> word;
+    if (word == "flood")
+    {
+      int t, i;
+      fields >> t >> i;
+      flooding = true;
+      ordered &= i > last[t];
+      last[t] = i;
+      received++;
+    }
+    else if (word == "burst")
+    {
+      bursts++;
+    }
+    else if (flooding && line.find("log messages dropped") != std::string::npos)
+    {
+      long count;
+      std::istringstream(line) >> level >> count;
+      dropped += count;
+    }
+  }
+
+  long sent = long(THREADS) * PER_THREAD;
+  bool complete = received + dropped == sent;
+  std::cout << THREADS << " threads x " << PER_THREAD << ": " << received << " printed, " << dropped
+            << " dropped when the ring was full, " << (complete ? "none lost" : "SOME LOST") << ", "
+            << (ordered ? "in order per thread" : "OUT OF ORDER") << std::endl;
+  std::cout << "1000 writes through a 20/s call site: " << bursts << " printed" << std::endl;
+
+  std::remove(LOG_PATH);
+  return complete && ordered && bursts == 20 ? 0 : 1;
+}
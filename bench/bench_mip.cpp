@@ -0,0 +1,172 @@
+// Upward transposition with and without octave levels: how far aliases and
+// interpolation error sit below a test tone, and what the levels cost in
+// memory and build time. Each pair of cases has one tone that should survive
+// the transposition and one pushed past Nyquist, which should vanish rather
+// than fold back. Exits non-zero if the levels reach 1x the base.
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "PCMKernel.hpp"
+#include "SampleBuffer.hpp"
+
+const int RATE = 48000;
+const int BUFFER = 128;
+const char* INTERPOLATORS[] = {"none", "linear", "hermite", "lagrange", "sinc"};
+
+std::shared_ptr<std::vector<int16_t>> tone(double frequency, int frames)
+{
+  auto out = std::make_shared<std::vector<int16_t>>(frames);
+  for (int i = 0; i < frames; i++)
+  {
+    (*out)[i] = clampToPcm16(0.5 * std::sin(2 * M_PI * frequency * i / RATE));
+  }
+  return out;
+}
+
+// Play `buffer` at `rate` the way a voice does, from level 0 or the level
+// mipLevelFor() picks, and return the left channel
+std::vector<float> play(const SampleBuffer& buffer, float rate, bool useMips, int interpolation)
+{
+  int level = useMips ? buffer.mipLevelFor(rate) : 0;
+  SampleReader reader = buffer.read(level);
+  int length = buffer.playableFrames(reader);
+  int frames = int((buffer.frameCount - 256) / rate);
+
+  std::vector<float> env(BUFFER, 1.f), left(frames), right(frames);
+  ParamRamp leftGain, rightGain;
+  leftGain.reset(1);
+  rightGain.reset(0);
+  PlayHead head;
+  head.start(rate / float(1 << level));
+
+  for (int done = 0; done < frames; done += BUFFER)
+  {
+    renderPCM(reader, length, head, interpolation, env.data(), leftGain, rightGain,
+              left.data() + done, right.data() + done, std::min(BUFFER, frames - done));
+  }
+
+  return left;
+}
+
+// Error power below the source tone, in dB. If the transposed tone still fits
+// under Nyquist the best-fitting sine at its frequency is removed first;
+// otherwise everything that comes out is alias.
+double rejection(const std::vector<float>& out, double frequency)
+{
+  const double sourcePower = 0.125; // 0.5 amplitude sine
+  size_t from = 256, to = out.size() - 256; // edges clamp and ring
+  double error = 0;
+
+  if (frequency < 0.45 * RATE)
+  {
+    double omega = 2 * M_PI * frequency / RATE;
+    double ss = 0, sc = 0, cc = 0, ys = 0, yc = 0;
+    for (size_t n = from; n < to; n++)
+    {
+      double s = std::sin(omega * n), c = std::cos(omega * n);
+      ss += s * s;
+      sc += s * c;
+      cc += c * c;
+      ys += out[n] * s;
+      yc += out[n] * c;
+    }
+
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc) / det, b = (yc * ss - ys * sc) / det;
+    for (size_t n = from; n < to; n++)
+    {
+      double fit = a * std::sin(omega * n) + b * std::cos(omega * n);
+      error += (out[n] - fit) * (out[n] - fit);
+    }
+  }
+  else
+  {
+    for (size_t n = from; n < to; n++)
+    {
+      error += out[n] * out[n];
+    }
+  }
+
+  return 10 * std::log10(sourcePower / (error / (to - from)));
+}
+
+int main()
+{
+  struct Case { const char* name; double frequency; float semitones; };
+  const Case cases[] = {
+    {"6 kHz, up 7", 6000, 7},
+    {"18 kHz, up 7", 18000, 7},
+    {"3 kHz, up 19", 3000, 19},
+    {"9 kHz, up 19", 9000, 19},
+    {"2 kHz, up 31", 2000, 31},
+    {"5 kHz, up 31", 5000, 31},
+  };
+
+  std::cout << "error and alias rejection (dB below the source tone), base level / octave levels"
+            << std::endl << std::setw(10) << "";
+  for (const Case& test : cases)
+  {
+    std::cout << std::setw(16) << test.name;
+  }
+  std::cout << std::endl << std::fixed << std::setprecision(1);
+
+  std::vector<std::unique_ptr<SampleBuffer>> buffers;
+  for (const Case& test : cases)
+  {
+    auto pcm = tone(test.frequency, RATE * 2);
+    buffers.emplace_back(new SampleBuffer("tone"));
+    buffers.back()->adopt(pcm->data(), pcm->size(), RATE, 0, pcm);
+    buffers.back()->buildMips();
+  }
+
+  for (int interpolation = INTERP_LINEAR; interpolation < INTERP_COUNT; interpolation++)
+  {
+    std::cout << std::setw(10) << INTERPOLATORS[interpolation];
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+      float rate = std::exp2(cases[c].semitones / 12.f);
+      double expected = cases[c].frequency * rate;
+      for (bool useMips : {false, true})
+      {
+        // A level filtered past the tone plays back exact zeros
+        double db = rejection(play(*buffers[c], rate, useMips, interpolation), expected);
+        std::cout << (useMips ? " /" : "") << std::setw(useMips ? 6 : 8);
+        if (std::isinf(db))
+        {
+          std::cout << "silent";
+        }
+        else
+        {
+          std::cout << db;
+        }
+      }
+    }
+    std::cout << std::endl;
+  }
+
+  // Memory and build cost over a spread of sample lengths
+  bool pass = true;
+  std::cout << std::endl << "octave levels (" << SampleBuffer::mipLevels() << " max)" << std::endl;
+  for (double seconds : {0.05, 0.5, 5.0, 30.0})
+  {
+    auto pcm = tone(440, int(seconds * RATE));
+    SampleBuffer buffer("tone");
+    buffer.adopt(pcm->data(), pcm->size(), RATE, 0, pcm);
+
+    auto start = std::chrono::steady_clock::now();
+    buffer.buildMips();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    double overhead = double(buffer.mipBytes()) / buffer.bytes();
+    pass &= overhead < 1;
+    std::cout << std::setw(6) << std::setprecision(2) << seconds << " s: " << std::setprecision(1) << buffer.mips.size() << " levels, +"
+              << overhead * 100 << "% memory, built in " << ms << " ms" << std::endl;
+  }
+
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,367 @@
+// Where notes start and stop: a fast taan (24 notes a second) and a drum
+// roll (47 hits a second), their starts falling anywhere inside a buffer,
+// played by PatternPlayer through PCMVoiceEngine on a constant sample at
+// 64, 128, 512 and 1024-frame buffers,
+//   sample-accurate: each slot starts at its note's offset in the block
+//     (startAt, as PCMBatchVoice passes io.frame()) and releases on its
+//     note-off frame (hold, from PatternPlayer::holdFrames);
+//   block-quantized: what the batched engine did before, starting every
+//     note and releasing it at the start of the block it falls in.
+// Every onset and release is found in the output and compared with the
+// note's own frame (when buffers are longer than the gaps, quantized notes
+// run together and only their count is printed). Sample-accurate output
+// must hit every frame and be identical at every buffer size. The taan is
+// then played again past ten minutes, where a float start time would be off
+// by frames; sample-accurate output must still hit every frame. Last, the
+// same notes go through PCMEnv's own render (PCMEnvVoice::onProcess), the
+// voices taken from a VoicePool as MyApp does and each block starting at
+// io.frame(offset) as allolib's PolySynth renders; its edges are measured
+// against those of one note at frame 0, since the envelope is Gamma's, and
+// must match them for every note at every buffer size. Exits non-zero
+// otherwise.
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "PCMEnvVoice.hpp"
+#include "Pattern.hpp"
+#include "VoiceEngine.hpp"
+#include "VoicePool.hpp"
+
+const int RATE = 48000;
+const float RELEASE = 0.002f;
+const double LATE = 612.0137; // seconds
+
+struct Edges
+{
+  std::vector<int64_t> onsets, releases;
+};
+
+struct Errors
+{
+  int64_t worst = 0;
+  double mean = 0;
+};
+
+// As PatternPlayer rounds seconds to frames
+int64_t frameOf(double seconds) { return int64_t(seconds * RATE + 0.5); }
+
+void addNotes(PatternBuffer& pattern, double first, double spacing, float duration, int count, float note)
+{
+  for (int i = 0; i < count; i++)
+  {
+    PatternEvent e;
+    e.start = first + i * spacing;
+    e.duration = duration;
+    e.note = note + i % 5;
+    e.amplitude = 1;
+    e.attack = 0;
+    e.release = RELEASE;
+    pattern.push(e);
+  }
+}
+
+// The left channel from frame `from` on
+std::vector<float> play(const PatternBuffer& pattern, const SampleBuffer& sample, int buffer, bool accurate,
+                        int64_t from = 0)
+{
+  PCMVoiceEngine& engine = pcmVoiceEngine();
+  PatternPlayer player;
+  player.play(pattern.begin(), pattern.end(), RATE);
+
+  std::map<int, int> slots; // note id -> engine slot
+  std::vector<float> left, blockLeft(buffer), blockRight(buffer);
+  int64_t rendered = 0;
+  while (!player.done() || engine.active() > 0)
+  {
+    player.advance(
+      buffer,
+      [&](const PatternEvent& e, int id, int offset) {
+        int slot = engine.start(sample, 1);
+        engine.control(slot, INTERP_NONE, e.amplitude, e.amplitude, e.attack, e.release);
+        if (accurate)
+        {
+          engine.startAt(slot, offset);
+          engine.hold(slot, player.holdFrames(e, offset));
+        }
+        slots[id] = slot;
+      },
+      [&](int id, int) {
+        if (!accurate && slots.count(id))
+        {
+          engine.release(slots[id]);
+        }
+      });
+
+    std::fill(blockLeft.begin(), blockLeft.end(), 0.f);
+    std::fill(blockRight.begin(), blockRight.end(), 0.f);
+    engine.render(blockLeft.data(), blockRight.data(), buffer);
+    int64_t skip = std::min(std::max(from - rendered, int64_t(0)), int64_t(buffer));
+    left.insert(left.end(), blockLeft.begin() + skip, blockLeft.end());
+    rendered += buffer;
+
+    for (auto it = slots.begin(); it != slots.end();)
+    {
+      if (engine.ended(it->second))
+      {
+        engine.stop(it->second);
+        it = slots.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+  return left;
+}
+
+// PCMEnv as the apps play it, with the parameters PatternEvent carries
+struct OnsetVoice : public PCMEnvVoice
+{
+  Patch* patch = nullptr;
+  float note = 60;
+
+  void init() override
+  {
+    PCMEnvVoice::init();
+    createInternalTriggerParameter("amplitude", 1, 0, 8);
+    createInternalTriggerParameter("attackTime", 0, 0, 3);
+    createInternalTriggerParameter("releaseTime", RELEASE, 0, 10);
+    createInternalTriggerParameter("pan", 0, -1, 1);
+    createInternalTriggerParameter("interpolate", INTERP_NONE, INTERP_NONE, INTERP_COUNT - 1);
+  }
+
+  void set(Patch* notePatch, const PatternEvent& e)
+  {
+    patch = notePatch;
+    note = e.note;
+    setInternalParameterValue("amplitude", e.amplitude);
+    setInternalParameterValue("attackTime", e.attack);
+    setInternalParameterValue("releaseTime", e.release);
+    setInternalParameterValue("pan", e.pan);
+    setInternalParameterValue("interpolate", INTERP_NONE);
+  }
+
+  void onTriggerOn() override { startNote(patch, note, 0); }
+};
+
+// The left channel, from PCMEnvVoice::onProcess
+std::vector<float> playVoices(const PatternBuffer& pattern, Patch& patch, int buffer)
+{
+  VoicePool<OnsetVoice> voices;
+  voices.allocate(2 * voiceManager().maxVoices);
+  PatternPlayer player;
+  player.play(pattern.begin(), pattern.end(), RATE);
+
+  al::AudioIOData io;
+  io.framesPerSecond(RATE);
+  io.channelsOut(2);
+  io.framesPerBuffer(buffer);
+
+  std::vector<float> left;
+  while (!player.done() || voices.active() > 0)
+  {
+    voiceManager().beginCallback();
+    player.advance(
+      buffer,
+      [&](const PatternEvent& e, int, int offset) {
+        OnsetVoice* voice = voices.take();
+        if (voice)
+        {
+          voice->set(&patch, e);
+          voice->holdFrames = player.holdFrames(e, offset);
+          voices.start(voice, offset);
+        }
+      },
+      [](int, int) {});
+
+    io.zeroOut();
+    io.frame(0);
+    voices.render(io);
+    left.insert(left.end(), io.outBuffer(0), io.outBuffer(0) + buffer);
+    voiceManager().endCallback(double(buffer) / RATE);
+  }
+  return left;
+}
+
+// The envelope starts from 0, rises and holds at full level until the
+// release: an onset is the silent frame before a note sounds, a release the
+// last frame at full level
+Edges findEdges(const std::vector<float>& out)
+{
+  Edges edges;
+  for (size_t i = 1; i < out.size(); i++)
+  {
+    if (out[i - 1] == 0 && out[i] != 0)
+    {
+      edges.onsets.push_back(int64_t(i) - 1);
+      size_t j = i + 1;
+      while (j < out.size() && out[j] >= out[j - 1])
+      {
+        j++;
+      }
+      edges.releases.push_back(int64_t(j) - 1);
+      for (i = j; i < out.size() && out[i] != 0; i++)
+      {
+      }
+    }
+  }
+  return edges;
+}
+
+Errors compare(const std::vector<int64_t>& found, const std::vector<int64_t>& expected)
+{
+  Errors errors;
+  for (size_t i = 0; i < expected.size(); i++)
+  {
+    int64_t error = i < found.size() ? std::abs(found[i] - expected[i]) : int64_t(1) << 40;
+    errors.worst = std::max(errors.worst, error);
+    errors.mean += double(error) / expected.size();
+  }
+  return errors;
+}
+
+int main()
+{
+  PCMVoiceEngine& engine = pcmVoiceEngine();
+  engine.sampleRate = RATE;
+  gam::sampleRate(RATE); // for PCMEnvVoice's envelope
+  engine.silenceThreshold = 0;
+
+  // A constant, so the output is the envelope
+  int length = RATE;
+  auto pcm = std::make_shared<std::vector<int16_t>>(length, int16_t(16384));
+  SampleBuffer sample("dc");
+  sample.adopt(pcm->data(), length, RATE, 1, pcm);
+
+  PatternBuffer pattern;
+  addNotes(pattern, 0.0137f, 1 / 24.f, 0.03f, 96, 60);  // taan
+  addNotes(pattern, 4.1093f, 0.0213f, 0.012f, 188, 36); // roll
+  pattern.finish();
+
+  Edges expected;
+  for (const PatternEvent& e : pattern.events)
+  {
+    expected.onsets.push_back(frameOf(e.start));
+    expected.releases.push_back(frameOf(e.start + e.duration));
+  }
+
+  int failed = 0;
+  std::vector<float> reference;
+  std::cout << pattern.events.size() << " notes at " << RATE << " Hz; onset and release error in frames (ms)"
+            << std::endl;
+  for (bool accurate : {true, false})
+  {
+    for (int buffer : {64, 128, 512, 1024})
+    {
+      std::vector<float> out = play(pattern, sample, buffer, accurate);
+      Edges found = findEdges(out);
+      Errors onsets = compare(found.onsets, expected.onsets);
+      Errors releases = compare(found.releases, expected.releases);
+
+      // Trailing silence depends on where the last buffer ends
+      out.resize(size_t(frameOf(pattern.events.back().start + 1)));
+      bool same = true;
+      if (accurate)
+      {
+        reference = reference.empty() ? out : reference;
+        same = out == reference;
+        failed += found.onsets.size() != expected.onsets.size() || onsets.worst != 0 || releases.worst != 0 ||
+                  !same;
+      }
+
+      std::cout << (accurate ? "sample-accurate" : "block-quantized") << ", " << buffer << "-frame buffers: ";
+      if (found.onsets.size() == expected.onsets.size())
+      {
+        std::cout << "onsets worst " << onsets.worst << " (" << onsets.worst * 1000.0 / RATE << "), mean "
+                  << onsets.mean << "; releases worst " << releases.worst << " ("
+                  << releases.worst * 1000.0 / RATE << "), mean " << releases.mean;
+      }
+      else
+      {
+        std::cout << "notes run together, " << found.onsets.size() << " heard apart";
+      }
+      if (accurate)
+      {
+        std::cout << "; " << (same ? "output identical to 64 frames" : "OUTPUT DIFFERS");
+      }
+      std::cout << std::endl;
+    }
+  }
+
+  // Past ten minutes, sample-accurate only
+  PatternBuffer late;
+  addNotes(late, LATE, 1 / 24.0, 0.03f, 96, 60);
+  late.finish();
+  int64_t from = frameOf(LATE) - RATE / 10;
+  Edges lateExpected;
+  int64_t floatWorst = 0;
+  for (int i = 0; i < 96; i++)
+  {
+    double start = LATE + i / 24.0; // as written, not as stored
+    lateExpected.onsets.push_back(frameOf(start) - from);
+    lateExpected.releases.push_back(frameOf(start + 0.03f) - from);
+    floatWorst = std::max(floatWorst, std::abs(frameOf(float(start)) - frameOf(start)));
+  }
+  for (int buffer : {64, 1024})
+  {
+    Edges found = findEdges(play(late, sample, buffer, true, from));
+    Errors onsets = compare(found.onsets, lateExpected.onsets);
+    Errors releases = compare(found.releases, lateExpected.releases);
+    failed += found.onsets.size() != lateExpected.onsets.size() || onsets.worst != 0 || releases.worst != 0;
+    std::cout << "at " << LATE << " s, " << buffer << "-frame buffers: onsets worst " << onsets.worst
+              << ", releases worst " << releases.worst << " (a float start would be off by up to " << floatWorst
+              << ")" << std::endl;
+  }
+
+  // PCMEnv's render, against one note played from frame 0
+  voiceManager().silenceThreshold = 0;
+  SampleBuffer* dc = new SampleBuffer("dc");
+  dc->adopt(pcm->data(), length, RATE, 1, pcm);
+  dc->markReady();
+  Timbre patch({new Sample("dc", 60, 127, std::shared_ptr<SampleBuffer>(dc))});
+
+  PatternBuffer single;
+  addNotes(single, 0, 1, 0.03f, 1, 60);
+  single.finish();
+  Edges calibration = findEdges(playVoices(single, patch, 1024));
+  if (calibration.onsets.size() != 1)
+  {
+    std::cout << "PCMEnvVoice: no reference note" << std::endl;
+    return 1;
+  }
+  int64_t onsetLag = calibration.onsets[0], releaseLag = calibration.releases[0] - frameOf(0.03f);
+
+  Edges voiceExpected;
+  for (const PatternEvent& e : pattern.events)
+  {
+    voiceExpected.onsets.push_back(frameOf(e.start) + onsetLag);
+    voiceExpected.releases.push_back(frameOf(e.start + e.duration) + releaseLag);
+  }
+  std::cout << "PCMEnvVoice, edges " << onsetLag << " and " << releaseLag << " frames from a note at frame 0:"
+            << std::endl;
+
+  std::vector<float> voiceReference;
+  for (int buffer : {64, 128, 512, 1024})
+  {
+    std::vector<float> out = playVoices(pattern, patch, buffer);
+    Edges found = findEdges(out);
+    Errors onsets = compare(found.onsets, voiceExpected.onsets);
+    Errors releases = compare(found.releases, voiceExpected.releases);
+    out.resize(size_t(frameOf(pattern.events.back().start + 1)));
+    voiceReference = voiceReference.empty() ? out : voiceReference;
+    bool same = out == voiceReference;
+    failed += found.onsets.size() != voiceExpected.onsets.size() || onsets.worst != 0 || releases.worst != 0 ||
+              !same;
+    std::cout << "  " << buffer << "-frame buffers: " << found.onsets.size() << " notes, onsets worst "
+              << onsets.worst << ", releases worst " << releases.worst << "; "
+              << (same ? "output identical to 64 frames" : "OUTPUT DIFFERS") << std::endl;
+  }
+
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+// Compiled patterns: the oldMain.cpp song (Song.hpp) as a constant array.
+// Reports its size and PatternPlayer's cost per callback while playing it
+// through at 128-frame buffers. Checks that every note-on lands on its own
+// frame and every note gets exactly one note-off; exits non-zero if not.
+
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "Song.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+const int RATE = 48000;
+const int BUFFER = 128;
+
+// Evaluated by the compiler; these would not compile otherwise
+static_assert(SONG_EVENTS > 0, "the song has notes");
+static_assert(SONG.events[0].start <= SONG.events[SONG_EVENTS - 1].start, "sorted by start");
+
+int main()
+{
+  std::cout << "Song: " << SONG.count << " events, " << sizeof(PatternEvent) << " bytes each, "
+            << sizeof(SONG.events) << " bytes in all (read-only data, no setup at startup)" << std::endl;
+
+  bool sorted = true;
+  for (int i = 1; i < SONG.count; i++)
+  {
+    sorted &= SONG.events[i - 1].start <= SONG.events[i].start;
+  }
+
+  // Play it through
+  PatternPlayer player;
+  player.play(SONG.begin(), SONG.end(), RATE);
+  std::vector<int> ons(SONG.count, 0), offs(SONG.count, 0);
+  long misplaced = 0, callbacks = 0;
+  double worstNs = 0, totalNs = 0;
+
+  while (!player.done())
+  {
+    int64_t blockStart = int64_t(callbacks) * BUFFER;
+    auto begin = Clock::now();
+    player.advance(
+      BUFFER,
+      [&](const PatternEvent& e, int id, int offset) {
+        ons[id - PatternPlayer::FIRST_ID]++;
+        misplaced += blockStart + offset != int64_t(e.start * RATE + 0.5);
+      },
+      [&](int id, int) { offs[id - PatternPlayer::FIRST_ID]++; });
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+    worstNs = std::max(worstNs, ns);
+    totalNs += ns;
+    callbacks++;
+  }
+
+  bool paired = true;
+  for (int i = 0; i < SONG.count; i++)
+  {
+    paired &= ons[i] == 1 && offs[i] == 1;
+  }
+
+  std::cout << "Played " << callbacks << " callbacks (" << double(callbacks) * BUFFER / RATE << " s): "
+            << totalNs / callbacks << " ns mean, " << worstNs << " ns worst per callback" << std::endl;
+  std::cout << (sorted ? "sorted" : "NOT SORTED") << ", " << (paired ? "one on and off per note" : "UNPAIRED NOTES")
+            << ", " << misplaced << " onsets off their frame, " << player.dropped << " dropped" << std::endl;
+
+  return sorted && paired && misplaced == 0 && player.dropped == 0 ? 0 : 1;
+}
@@ -0,0 +1,229 @@
+// Text patterns: parses patterns/*.pattern and links the song, checking it
+// matches the compiled SONG (Song.hpp) note for note, and times a full parse
+// and link against the sub-millisecond target, then an edit of one file
+// (reparse just that file, relink). Last, PatternWatcher on a copy of the
+// directory: one note is edited on disk while PatternPlayer plays, and the
+// change must come in on a bar line with every note before it from the old
+// song and every note after from the new. Run from the repository root.
+// Exits non-zero if a check fails.
+
+#include <glob.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PatternText.hpp"
+#include "Song.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+const int RATE = 48000;
+const int BUFFER = 128;
+const int RUNS = 200;
+const char* COPY = "/tmp/bench_patterntext";
+
+// The late-song note the edit changes, in track 4 of song.pattern
+const char* BEFORE = "n 43 7 1";
+const char* AFTER = "n 44 7 1";
+
+struct File
+{
+  std::string path, text;
+};
+
+std::vector<File> readPatterns(const std::string& directory)
+{
+  glob_t matches;
+  glob((directory + "/*.pattern").c_str(), 0, nullptr, &matches);
+  std::vector<File> files;
+  for (size_t i = 0; i < matches.gl_pathc; i++)
+  {
+    std::ifstream file(matches.gl_pathv[i]);
+    std::stringstream text;
+    text << file.rdbuf();
+    files.push_back({matches.gl_pathv[i], text.str()});
+  }
+  globfree(&matches);
+  return files;
+}
+
+bool same(const PatternEvent& a, const PatternEvent& b)
+{
+  return a.start == b.start && a.duration == b.duration && a.note == b.note && a.amplitude == b.amplitude &&
+         a.release == b.release && a.timbre == b.timbre && a.interpolate == b.interpolate && a.track == b.track;
+}
+
+int differences(const PatternEvent* a, int countA, const PatternEvent* b, int countB)
+{
+  int differ = std::abs(countA - countB);
+  for (int i = 0; i < std::min(countA, countB); i++)
+  {
+    differ += !same(a[i], b[i]);
+  }
+  return differ;
+}
+
+double since(Clock::time_point start) { return std::chrono::duration<double, std::micro>(Clock::now() - start).count(); }
+
+int main()
+{
+  std::vector<File> files = readPatterns("patterns");
+  int lines = 0;
+  for (const File& file : files)
+  {
+    lines += int(std::count(file.text.begin(), file.text.end(), '\n'));
+  }
+
+  // Full parse and link, from text already in memory
+  double parseUs = 0, linkUs = 0;
+  PatternBuffer song;
+  bool ok = !files.empty();
+  for (int run = 0; run < RUNS && ok; run++)
+  {
+    PatternLibrary library;
+    defineSongNames(library);
+    std::string error;
+
+    auto start = Clock::now();
+    for (const File& file : files)
+    {
+      if (!library.load(file.path, file.text, error))
+      {
+        std::cout << error << std::endl;
+        ok = false;
+      }
+    }
+    parseUs += since(start);
+
+    start = Clock::now();
+    if (!library.link("song", song, error))
+    {
+      std::cout << error << std::endl;
+      ok = false;
+    }
+    linkUs += since(start);
+  }
+  if (!ok)
+  {
+    return 1;
+  }
+
+  int differ = differences(song.begin(), int(song.events.size()), SONG.begin(), SONG.count);
+  std::cout << files.size() << " files, " << lines << " lines: parsed in " << parseUs / RUNS << " us, "
+            << song.events.size() << " events linked in " << linkUs / RUNS << " us (" << (parseUs + linkUs) / RUNS
+            << " us in all); " << differ << " events differ from the compiled SONG" << std::endl;
+
+  // Edit one file: reparse it alone and relink
+  PatternLibrary library;
+  defineSongNames(library);
+  std::string error;
+  File edited;
+  for (const File& file : files)
+  {
+    library.load(file.path, file.text, error);
+    if (file.path == "patterns/song.pattern")
+    {
+      edited = file;
+      edited.text.replace(edited.text.rfind(BEFORE), strlen(BEFORE), AFTER);
+    }
+  }
+
+  double reloadUs = 0;
+  PatternBuffer changed;
+  for (int run = 0; run < RUNS; run++)
+  {
+    auto start = Clock::now();
+    library.load(edited.path, edited.text, error);
+    library.link("song", changed, error);
+    reloadUs += since(start);
+  }
+  int edits = differences(changed.begin(), int(changed.events.size()), song.begin(), int(song.events.size()));
+  std::cout << "Edit to " << edited.path << ": reparsed and relinked in " << reloadUs / RUNS << " us, " << edits
+            << " event changed" << std::endl;
+
+  // The watcher, on a copy it can edit
+  std::string copy = COPY;
+  std::system(("rm -rf " + copy + " && mkdir -p " + copy).c_str());
+  for (const File& file : files)
+  {
+    std::ofstream(copy + file.path.substr(file.path.find('/'))) << file.text;
+  }
+
+  PatternPlayer player;
+  PatternWatcher watcher;
+  defineSongNames(watcher.library);
+  watcher.pollMs = 20;
+  if (!watcher.start(copy, player, RATE))
+  {
+    return 1;
+  }
+  logger().flush();
+
+  struct Onset
+  {
+    int64_t frame;
+    float note;
+  };
+  std::vector<Onset> played;
+  int64_t frame = 0, editedAt = -1;
+
+  while (!player.done() && frame < int64_t(120) * RATE)
+  {
+    if (frame == int64_t(RATE) * 3)
+    {
+      std::ofstream(copy + "/song.pattern") << edited.text;
+      editedAt = frame;
+    }
+    player.advance(
+      BUFFER, [&](const PatternEvent& e, int, int offset) { played.push_back({frame + offset, e.note}); },
+      [](int, int) {});
+    frame += BUFFER;
+
+    // Play in real time until the edit is cued, then as fast as possible
+    if (editedAt >= 0 && watcher.reloads == 0)
+    {
+      std::this_thread::sleep_for(std::chrono::microseconds(1000000 * BUFFER / RATE));
+    }
+  }
+  watcher.stop();
+  logger().flush();
+
+  // Expected: the old song before the bar line the swap happened on, the new one after
+  int64_t line = player.swappedAt.load();
+  std::vector<Onset> expected;
+  for (const PatternEvent& e : song.events)
+  {
+    if (int64_t(e.start * RATE + 0.5) < line)
+    {
+      expected.push_back({int64_t(e.start * RATE + 0.5), e.note});
+    }
+  }
+  for (const PatternEvent& e : changed.events)
+  {
+    if (int64_t(e.start * RATE + 0.5) >= line)
+    {
+      expected.push_back({int64_t(e.start * RATE + 0.5), e.note});
+    }
+  }
+
+  int wrong = std::abs(int(played.size()) - int(expected.size()));
+  for (size_t i = 0; i < std::min(played.size(), expected.size()); i++)
+  {
+    wrong += played[i].frame != expected[i].frame || played[i].note != expected[i].note;
+  }
+  int64_t bar = int64_t(player.barSeconds * RATE);
+  bool onBar = line > editedAt && line % bar == 0;
+
+  std::cout << "Watcher: edited at " << double(editedAt) / RATE << " s, swapped at " << double(line) / RATE
+            << " s (bar " << line / bar << (onBar ? "" : ", NOT A BAR LINE AFTER THE EDIT") << "), " << played.size()
+            << " notes played, " << wrong << " not as expected" << std::endl;
+
+  std::system(("rm -rf " + copy).c_str());
+  return differ == 0 && edits == 1 && player.swaps == 1 && onBar && wrong == 0 ? 0 : 1;
+}
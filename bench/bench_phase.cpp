@@ -0,0 +1,127 @@
+// Read-position accuracy over long notes: the old float accumulator against
+// the 32.32 PlayHead, and a check that every kernel reads the right frames
+// more than ten minutes into a note. Exits non-zero if the kernel check fails.
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "PCMKernel.hpp"
+
+const int RATE = 48000;
+const int BUFFER = 128;
+const char* KERNELS[] = {"scalar", "sse2", "avx2"};
+
+// Position error after `frames` output frames, and the pitch error over the
+// last second, for the old `position += rate` float accumulator
+void floatDrift(float rate, long frames, double& error, double& cents)
+{
+  float position = 0, secondAgo = 0;
+  for (long i = 0; i < frames; i++)
+  {
+    if (i == frames - RATE)
+    {
+      secondAgo = position;
+    }
+    position += rate;
+  }
+
+  error = position - double(rate) * frames;
+  cents = 1200 * std::log2((position - secondAgo) / (double(rate) * RATE));
+}
+
+void fixedDrift(float rate, long frames, double& error, double& cents)
+{
+  PlayHead head;
+  head.start(rate);
+  double position = (head.increment * uint64_t(frames)) / PlayHead::ONE;
+  error = position - double(rate) * frames;
+  cents = 1200 * std::log2(head.increment / PlayHead::ONE / rate);
+}
+
+// Render one block with no interpolation from `minutes` into a note and check
+// each output frame against the frame the play head should be on
+bool checkKernel(const std::vector<int16_t>& source, float rate, double minutes)
+{
+  SampleReader reader;
+  reader.head = source.data();
+  reader.headFrames = source.size();
+
+  PlayHead head;
+  head.start(rate);
+  uint64_t frames = uint64_t(minutes * 60 * RATE);
+  head.phase = frames * head.increment;
+
+  std::vector<float> env(BUFFER, 1.f), left(BUFFER), right(BUFFER);
+  ParamRamp leftGain, rightGain;
+  leftGain.reset(1);
+  rightGain.reset(0);
+
+  PlayHead start = head;
+  renderPCM(reader, source.size(), head, INTERP_NONE, env.data(), leftGain, rightGain,
+            left.data(), right.data(), BUFFER);
+
+  for (int i = 0; i < BUFFER; i++)
+  {
+    int index = int((start.phase + uint64_t(i) * start.increment) >> 32);
+    if (left[i] != source[index] * PCM_SCALE)
+    {
+      return false;
+    }
+  }
+
+  return head.phase == start.phase + BUFFER * start.increment;
+}
+
+int main()
+{
+  const float rates[] = {std::exp2(-5 / 12.f), std::exp2(7 / 12.f)};
+  const double minutes[] = {1, 10, 20};
+
+  for (float rate : rates)
+  {
+    for (double length : minutes)
+    {
+      long frames = long(length * 60 * RATE);
+      double floatError, floatCents, fixedError, fixedCents;
+      floatDrift(rate, frames, floatError, floatCents);
+      fixedDrift(rate, frames, fixedError, fixedCents);
+
+      std::cout << "rate " << rate << ", " << length << " min: float " << floatError << " frames off, ";
+      if (std::isinf(floatCents))
+      {
+        std::cout << "stalled (position += rate no longer moves)";
+      }
+      else
+      {
+        std::cout << floatCents << " cents";
+      }
+      std::cout << "; 32.32 " << fixedError << " frames off, " << fixedCents << " cents" << std::endl;
+    }
+  }
+
+  // A source long enough for 12 minutes at the higher rate
+  std::vector<int16_t> source(size_t(12.5 * 60 * RATE * rates[1]));
+  for (size_t i = 0; i < source.size(); i++)
+  {
+    source[i] = int16_t(i * 7919);
+  }
+
+  bool pass = true;
+  PCMIsa detected = pcmIsa();
+  for (int isa = PCM_SCALAR; isa <= detected; isa++)
+  {
+    pcmIsa() = PCMIsa(isa);
+    bool ok = true;
+    for (float rate : rates)
+    {
+      ok &= checkKernel(source, rate, 11.5);
+    }
+    std::cout << KERNELS[isa] << " kernel at 11.5 min: " << (ok ? "exact" : "WRONG FRAMES") << std::endl;
+    pass &= ok;
+  }
+
+  pcmIsa() = detected;
+  return pass ? 0 : 1;
+}
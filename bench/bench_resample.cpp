@@ -0,0 +1,109 @@
+// Times load-time sample-rate conversion of every WAV in timbre/ and checks
+// the resampler's accuracy on a test tone. Run from the repository root.
+
+#include <glob.h>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Resampler.hpp"
+#include "SampleBuffer.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<std::string> findSamples()
+{
+  std::vector<std::string> paths;
+  glob_t matches;
+
+  // Drum/ holds files directly; the other banks have one directory per timbre
+  glob("timbre/*/*.wav", 0, nullptr, &matches);
+  glob("timbre/*/*/*.wav", GLOB_APPEND, nullptr, &matches);
+  paths.assign(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+  globfree(&matches);
+  return paths;
+}
+
+// Resample every buffer to `rate`; buffers already at that rate are skipped
+void resampleBank(std::vector<SampleBuffer*>& bank, int rate)
+{
+  size_t inFrames = 0, outFrames = 0;
+  int converted = 0;
+  auto start = Clock::now();
+
+  for (SampleBuffer* buffer : bank)
+  {
+    if (buffer->sample_rate == rate)
+    {
+      continue;
+    }
+
+    std::vector<int16_t> out;
+    Resampler(buffer->sample_rate, rate).process(buffer->frames, buffer->frameCount, out);
+    inFrames += buffer->frameCount;
+    outFrames += out.size();
+    converted++;
+  }
+
+  double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  std::cout << "to " << rate << " Hz: " << converted << " files, " << inFrames << " -> " << outFrames
+            << " frames in " << ms << " ms (" << inFrames / ms / 1000.0 << " Mframes/s in)" << std::endl;
+}
+
+// Signal-to-error ratio of a resampled sine against the ideal one
+void toneAccuracy(int inRate, int outRate, double frequency)
+{
+  int frames = inRate;
+  std::vector<int16_t> in(frames), out;
+
+  for (int i = 0; i < frames; i++)
+  {
+    in[i] = clampToPcm16(0.5 * std::sin(2 * M_PI * frequency * i / inRate));
+  }
+
+  Resampler(inRate, outRate).process(in.data(), in.size(), out);
+
+  // Skip the filter's edges, where the input is zero padded
+  double signal = 0, error = 0;
+  for (size_t n = outRate / 10; n + outRate / 10 < out.size(); n++)
+  {
+    double ideal = 0.5 * std::sin(2 * M_PI * frequency * n / outRate);
+    double actual = out[n] * PCM_SCALE;
+    signal += ideal * ideal;
+    error += (actual - ideal) * (actual - ideal);
+  }
+
+  std::cout << inRate << " -> " << outRate << " Hz, " << frequency << " Hz tone: "
+            << 10 * std::log10(signal / error) << " dB SNR" << std::endl;
+}
+
+int main()
+{
+  std::vector<std::string> paths = findSamples();
+  if (paths.empty())
+  {
+    std::cout << "No samples found; run from the repository root" << std::endl;
+    return 1;
+  }
+
+  SampleBuffer::streamLongerThan() = 0;
+  std::vector<SampleBuffer*> bank;
+  for (const std::string& path : paths)
+  {
+    bank.push_back(new SampleBuffer(path));
+    bank.back()->decode();
+  }
+
+  std::cout << paths.size() << " files" << std::endl;
+  resampleBank(bank, 48000);
+  resampleBank(bank, 44100);
+  resampleBank(bank, 96000);
+
+  toneAccuracy(44100, 48000, 1000);
+  toneAccuracy(44100, 48000, 15000);
+  toneAccuracy(48000, 44100, 1000);
+  return 0;
+}
@@ -0,0 +1,197 @@
+// RtCheck on the batched voice path. First a self-test: an allocation, a free
+// and a mutex lock made while armed must all be caught, and with locks
+// allowed the lock must be counted apart but the allocation still caught. Then every bundled
+// PCMEnv-data/*.synthSequence is played through what an audio callback does
+// in a PCM_BATCH_VOICES build (note-ons and offs on PCMVoiceEngine slots,
+// disk stream hand-off, VoiceManager timing, a rate-limited log line per
+// note, the render itself), with no pool and with two workers, armed the
+// whole time. Built with PCM_RT_CHECK; exits non-zero on any violation there.
+// Run from the repository root.
+
+#include <glob.h>
+
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "RtCheck.hpp"
+#include "SoundBank.hpp"
+#include "SoundBankLoader.hpp"
+#include "VoiceEngine.hpp"
+#include "VoiceManager.hpp"
+
+const int RATE = 48000;
+const int BUFFER = 128;
+
+std::vector<Patch*> SoundBank = defaultSoundBank();
+
+struct Event
+{
+  double start, off;
+  int timbre;
+  float amplitude, note, attack, release;
+};
+
+std::vector<Event> readSequence(const std::string& path)
+{
+  std::vector<Event> events;
+  std::ifstream file(path);
+  std::string line;
+
+  while (std::getline(file, line))
+  {
+    std::istringstream fields(line);
+    std::string at, name;
+    float frequency;
+    Event e;
+    if (fields >> at >> e.start >> e.off >> name >> e.timbre >> frequency >> e.amplitude >> e.note >> e.attack >>
+          e.release && at == "@")
+    {
+      e.off += e.start;
+      events.push_back(e);
+    }
+  }
+  return events;
+}
+
+// One sequence through a fresh engine; returns the callbacks rendered
+long play(const std::vector<Event>& events, int workers)
+{
+  std::unique_ptr<PCMVoiceEngine> engine(new PCMVoiceEngine());
+  engine->sampleRate = RATE;
+  if (workers > 0)
+  {
+    engine->threads(workers, BUFFER);
+  }
+
+  double end = 0;
+  for (const Event& e : events)
+  {
+    end = std::max(end, double(e.off + e.release));
+  }
+  long callbacks = long((end + 1) * RATE / BUFFER);
+
+  std::vector<float> out(BUFFER * 2);
+  std::vector<int> slots(events.size(), -1);
+  std::vector<int> owner(PCMVoiceEngine::MAX_VOICES, -1);
+
+  for (long callback = 0; callback < callbacks; callback++)
+  {
+    double from = double(callback) * BUFFER / RATE, to = from + double(BUFFER) / RATE;
+    RtCheckScope realtime;
+    voiceManager().beginCallback();
+    std::fill(out.begin(), out.end(), 0.f);
+
+    for (int slot = 0; slot < PCMVoiceEngine::MAX_VOICES; slot++)
+    {
+      if (owner[slot] >= 0 && engine->ended(slot))
+      {
+        engine->stop(slot);
+        slots[owner[slot]] = -1;
+        owner[slot] = -1;
+      }
+    }
+
+    for (int n = 0; n < int(events.size()); n++)
+    {
+      const Event& e = events[n];
+      if (e.start >= from && e.start < to)
+      {
+        KeyZone zone = SoundBank[e.timbre]->zone(e.note);
+        if (zone.sample && zone.sample->buffer->frameCount > 0)
+        {
+          PCM_LOG_RATE(LOG_DEBUG, 20, "Sample: ", zone.sample->pitch_root);
+          int slot = engine->start(*zone.sample->buffer, zone.rate);
+          if (slot >= 0)
+          {
+            engine->control(slot, INTERP_LINEAR, e.amplitude / 2, e.amplitude / 2, e.attack, e.release);
+            slots[n] = slot;
+            owner[slot] = n;
+          }
+        }
+      }
+      if (e.off >= from && e.off < to && slots[n] >= 0)
+      {
+        engine->release(slots[n]);
+      }
+    }
+
+    engine->render(out.data(), out.data() + BUFFER, BUFFER);
+    voiceManager().endCallback(double(BUFFER) / RATE);
+  }
+
+  for (int slot = 0; slot < PCMVoiceEngine::MAX_VOICES; slot++)
+  {
+    if (owner[slot] >= 0)
+    {
+      engine->stop(slot);
+    }
+  }
+  return callbacks;
+}
+
+int main()
+{
+  if (!RtCheck::enabled())
+  {
+    std::cout << "Build with PCM_RT_CHECK on glibc" << std::endl;
+    return 2;
+  }
+
+  // Self-test: each of these must be caught
+  {
+    std::mutex mutex;
+    RtCheckScope realtime;
+    int* volatile value = new int(1); // volatile, or the pair may be optimized away
+    delete value;
+    std::lock_guard<std::mutex> lock(mutex);
+  }
+  long caught = RtCheck::violations();
+  RtCheck::report("self-test");
+
+  // With locks allowed, only the allocation and free count
+  {
+    std::mutex mutex;
+    RtCheckAllowLocks allowLocks;
+    RtCheckScope realtime;
+    int* volatile value = new int(1);
+    delete value;
+    std::lock_guard<std::mutex> lock(mutex);
+  }
+  long caughtAllowing = RtCheck::violations(), allowed = RtCheck::allowedLocks();
+  RtCheck::report("self-test, locks allowed");
+  logger().flush();
+  std::cout << "Self-test: " << caught << " of 3 violations caught; with locks allowed " << caughtAllowing
+            << " of 2, " << allowed << " of 1 lock counted apart" << std::endl;
+
+  SampleBuffer::targetRate() = RATE;
+  SoundBankLoader loader;
+  loader.start(SoundBank);
+  loader.wait();
+  logger().flush();
+
+  glob_t matches;
+  glob("PCMEnv-data/*.synthSequence", 0, nullptr, &matches);
+  std::vector<std::string> paths(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+  globfree(&matches);
+
+  long total = 0;
+  for (int workers : {0, 2})
+  {
+    for (const std::string& path : paths)
+    {
+      long callbacks = play(readSequence(path), workers);
+      long found = RtCheck::report(path);
+      logger().flush();
+      total += found;
+      std::cout << path << ", " << workers << " workers: " << callbacks << " callbacks, " << found
+                << " violations" << std::endl;
+    }
+  }
+
+  bool selfTest = caught == 3 && caughtAllowing == 2 && allowed == 1;
+  return selfTest && total == 0 && !paths.empty() ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+// Packed sequences (.pcmseq, SequenceBinary.hpp): every bundled
+// PCMEnv-data/*.synthSequence recording, and a ten-minute performance made
+// of them played back to back (start times rewritten as the recorder would
+// print them), is packed, unpacked and loaded. The unpacked text must match
+// the original byte for byte and the packed file must load the same notes
+// as the text; prints sizes and load times for both. A truncated file must
+// fail to load, and so must one whose header claims more entries and notes
+// than it has bytes for, without allocating for them. Run from the
+// repository root; exits non-zero on a mismatch.
+
+#include <glob.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "SequenceBinary.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+std::atomic<size_t> largestAllocation{0};
+
+// Kept out of line: inlined into their callers, GCC pairs the malloc() and
+// free() inside with the operator they replace and reports a mismatch
+// (-Wmismatched-new-delete)
+#if defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+BENCH_NOINLINE void* operator new(size_t size)
+{
+  size_t largest = largestAllocation;
+  while (size > largest && !largestAllocation.compare_exchange_weak(largest, size))
+  {
+  }
+  void* pointer = std::malloc(size);
+  if (!pointer)
+  {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+BENCH_NOINLINE void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { operator delete(pointer); }
+
+const int RUNS = 20;
+const double PERFORMANCE_SECONDS = 600;
+const char* PERFORMANCE = "/tmp/bench_sequencebinary.synthSequence";
+const char* PACKED = "/tmp/bench_sequencebinary.pcmseq";
+const char* UNPACKED = "/tmp/bench_sequencebinary.unpacked.synthSequence";
+
+std::string readFile(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  std::stringstream text;
+  text << file.rdbuf();
+  return text.str();
+}
+
+bool same(const PatternEvent& a, const PatternEvent& b)
+{
+  return a.start == b.start && a.duration == b.duration && a.note == b.note && a.amplitude == b.amplitude &&
+         a.attack == b.attack && a.release == b.release && a.pan == b.pan && a.timbre == b.timbre &&
+         a.interpolate == b.interpolate;
+}
+
+template <typename Load>
+double best(Load load)
+{
+  double fastest = 1e30;
+  for (int run = 0; run < RUNS; run++)
+  {
+    auto start = Clock::now();
+    load();
+    fastest = std::min(fastest, std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+  }
+  return fastest;
+}
+
+// Packs, unpacks and loads one file; returns how many checks failed
+int roundTrip(const std::string& path)
+{
+  std::string original = readFile(path);
+  bool converted = convertSequence(path, PACKED) && convertSequence(PACKED, UNPACKED);
+  std::string packed = readFile(PACKED);
+  bool exact = converted && readFile(UNPACKED) == original;
+
+  std::vector<PatternEvent> fromText, fromPacked;
+  double endText = 0, endPacked = 0;
+  double textUs = best([&] {
+    fromText.clear();
+    endText = loadSequence(path, fromText);
+  });
+  double packedUs = best([&] {
+    fromPacked.clear();
+    endPacked = loadSequence(PACKED, fromPacked);
+  });
+  int differ = std::abs(int(fromText.size()) - int(fromPacked.size())) + (endText != endPacked);
+  for (size_t i = 0; i < std::min(fromText.size(), fromPacked.size()); i++)
+  {
+    differ += !same(fromText[i], fromPacked[i]);
+  }
+
+  std::cout << path.substr(path.rfind('/') + 1) << ": " << fromText.size() << " notes, " << original.size()
+            << " bytes of text, " << packed.size() << " packed (" << double(original.size()) / packed.size()
+            << "x); loads in " << textUs << " us as text, " << packedUs << " us packed; "
+            << (exact ? "unpacks byte for byte" : "UNPACKED TEXT DIFFERS") << ", " << differ
+            << " notes differ" << std::endl;
+  return !exact + differ;
+}
+
+int main()
+{
+  logger().level = LOG_WARN;
+
+  glob_t matches;
+  glob("PCMEnv-data/*.synthSequence", 0, nullptr, &matches);
+  std::vector<std::string> paths(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+  globfree(&matches);
+  if (paths.empty())
+  {
+    return 1;
+  }
+
+  int failed = 0;
+  for (const std::string& path : paths)
+  {
+    failed += roundTrip(path);
+  }
+
+  // Ten minutes of the recordings one after another, each note line as the
+  // recorder writes it with its start moved on
+  std::ofstream performance(PERFORMANCE);
+  double offset = 0;
+  while (offset < PERFORMANCE_SECONDS)
+  {
+    for (const std::string& path : paths)
+    {
+      std::istringstream lines(readFile(path));
+      std::string line;
+      double end = offset;
+      while (std::getline(lines, line) && offset < PERFORMANCE_SECONDS)
+      {
+        std::istringstream fields(line);
+        std::string at;
+        double start, duration;
+        if (fields >> at >> start >> duration && at == "@")
+        {
+          std::string rest;
+          std::getline(fields, rest);
+          performance << "@ " << start + offset << " " << duration << rest << "\n";
+          end = std::max(end, start + offset + duration);
+        }
+      }
+      offset = end + 1;
+    }
+  }
+  performance.close();
+  failed += roundTrip(PERFORMANCE);
+
+  // Damage is reported, not loaded
+  std::string packed = readFile(PACKED);
+  std::ofstream(PACKED, std::ios::binary).write(packed.data(), packed.size() / 2);
+  std::vector<PatternEvent> events;
+  bool rejected = loadSequence(PACKED, events) < 0 && events.empty();
+  std::cout << "Truncated file " << (rejected ? "rejected" : "LOADED") << std::endl;
+
+  // A megabyte of zeros behind a header claiming a million entries and notes
+  SequenceWriter forged;
+  forged.bytes.assign(SEQUENCE_MAGIC, sizeof(SEQUENCE_MAGIC));
+  forged.varint(SEQUENCE_VERSION);
+  for (uint64_t count : {1 << 20, 1 << 20, 1 << 20, 0, 0}) // lines, notes, entries, scales
+  {
+    forged.varint(count);
+  }
+  forged.bytes.resize(forged.bytes.size() + (1 << 20));
+  std::ofstream(PACKED, std::ios::binary).write(forged.bytes.data(), forged.bytes.size());
+  largestAllocation = 0;
+  bool forgedRejected = loadSequence(PACKED, events) < 0 && events.empty();
+  forgedRejected = forgedRejected && largestAllocation < forged.bytes.size();
+  std::cout << "Forged counts " << (forgedRejected ? "rejected" : "LOADED OR ALLOCATED FOR") << ", largest allocation "
+            << largestAllocation << " bytes" << std::endl;
+
+  std::remove(PERFORMANCE);
+  std::remove(PACKED);
+  std::remove(UNPACKED);
+  logger().flush();
+  return failed == 0 && rejected && forgedRejected ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+// Loading .synthSequence files: a synthetic recording of a million notes,
+// written the way SynthSequencer writes them (6 significant digits) with
+// some comments, other event kinds, exponents, long decimals and CRLF line
+// ends mixed in, then read
+//   with streams: getline and an istringstream per line, as before;
+//   mapped: readSynthSequence into a vector and loadSynthSequence into a
+//     SequenceTable, both sized once from the line count;
+// and the bundled PCMEnv-data files the same ways. Every reader must agree
+// note for note, and a reload into a table that already has the room must
+// not allocate. Run from the repository root; exits non-zero on a mismatch.
+
+#include <glob.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "SequenceFile.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+const int NOTES = 1000000;
+const int RUNS = 5;
+const char* SYNTHETIC = "/tmp/bench_sequenceload.synthSequence";
+
+std::atomic<long> allocations{0};
+
+void* operator new(size_t size)
+{
+  allocations++;
+  void* pointer = std::malloc(size);
+  if (!pointer)
+  {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
+
+// The reader this replaces
+double readWithStreams(const std::string& path, std::vector<PatternEvent>& events)
+{
+  std::ifstream file(path);
+  if (!file)
+  {
+    return -1;
+  }
+  std::string line;
+  double end = 0;
+  while (std::getline(file, line))
+  {
+    std::istringstream fields(line);
+    std::string at, name;
+    double start, duration;
+    float frequency, note;
+    int timbre, interpolate = 0;
+    PatternEvent e;
+    if (fields >> at >> start >> duration >> name >> timbre >> frequency >> e.amplitude >> note >> e.attack >>
+          e.release && at == "@" && name == "PCMEnv" && timbre >= 0 && timbre <= 255)
+    {
+      fields >> e.pan >> interpolate;
+      e.start = start;
+      e.duration = float(duration);
+      e.note = note;
+      e.timbre = uint8_t(timbre);
+      e.interpolate = uint8_t(interpolate);
+      events.push_back(e);
+      end = std::max(end, start + duration);
+    }
+  }
+  return end;
+}
+
+void writeSynthetic()
+{
+  std::mt19937 random(7);
+  std::uniform_real_distribution<double> unit(0, 1);
+  std::ofstream file(SYNTHETIC);
+  file << "# synthetic recording\n";
+  double time = 0;
+  for (int i = 0; i < NOTES; i++)
+  {
+    time += unit(random) * 0.25;
+    int midi = 36 + int(unit(random) * 48);
+    file << "@ " << time << " " << unit(random) * 2 << " PCMEnv " << int(unit(random) * 21) << " "
+         << 440 * std::pow(2.0, (midi - 69) / 12.0) << " " << unit(random) << " " << midi << " ";
+    switch (i % 1000)
+    {
+    case 1: file << "1e-05 0.5 -0.25 2\r\n"; break;                 // exponent, CRLF
+    case 2: file << "0.123456789 0.5\n"; break;                     // long decimal, no pan or interpolate
+    case 3: file << "2 2 0.5\n- 12\n= 120\n"; break;                // other event kinds
+    case 4: file << "2 2 abc 1\n"; break;                           // malformed pan
+    default: file << unit(random) * 0.1 << " " << unit(random) << " " << unit(random) * 2 - 1 << " " << i % 5 << "\n";
+    }
+  }
+}
+
+bool same(const PatternEvent& a, const PatternEvent& b)
+{
+  return a.start == b.start && a.duration == b.duration && a.note == b.note && a.amplitude == b.amplitude &&
+         a.attack == b.attack && a.release == b.release && a.pan == b.pan && a.timbre == b.timbre &&
+         a.interpolate == b.interpolate;
+}
+
+template <typename Read>
+double best(Read read)
+{
+  double fastest = 1e30;
+  for (int run = 0; run < RUNS; run++)
+  {
+    auto start = Clock::now();
+    read();
+    fastest = std::min(fastest, std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+  }
+  return fastest;
+}
+
+// Times the three readers on one file and counts notes they disagree on
+long compare(const std::string& path, bool print)
+{
+  std::vector<PatternEvent> streamed, mapped;
+  SequenceTable table;
+  double endStreamed = 0, endMapped = 0, endTable = 0;
+
+  double streamUs = best([&] {
+    streamed.clear();
+    endStreamed = readWithStreams(path, streamed);
+  });
+  double mappedUs = best([&] {
+    mapped.clear();
+    endMapped = readSynthSequence(path, mapped);
+  });
+  table.clear();
+  double tableUs = best([&] {
+    table.clear();
+    endTable = loadSynthSequence(path, table);
+  });
+
+  // A reload that fits in what the table already has
+  long before = allocations;
+  table.clear();
+  loadSynthSequence(path, table);
+  long reloadAllocations = allocations - before;
+
+  long differ = std::abs(long(streamed.size()) - long(mapped.size())) +
+                std::abs(long(streamed.size()) - long(table.size())) + (endStreamed != endMapped) +
+                (endStreamed != endTable) + reloadAllocations;
+  for (size_t i = 0; i < std::min(streamed.size(), std::min(mapped.size(), table.size())); i++)
+  {
+    differ += !same(streamed[i], mapped[i]) + !same(streamed[i], table.event(i));
+  }
+
+  if (print)
+  {
+    std::cout << path.substr(path.rfind('/') + 1) << ": " << streamed.size() << " notes; streams " << streamUs
+              << " us, mapped " << mappedUs << " us, table " << tableUs << " us (" << streamUs / tableUs
+              << "x); reload allocated " << reloadAllocations << " times; " << differ << " differences"
+              << std::endl;
+  }
+  return differ;
+}
+
+int main()
+{
+  glob_t matches;
+  glob("PCMEnv-data/*.synthSequence", 0, nullptr, &matches);
+  std::vector<std::string> paths(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+  globfree(&matches);
+  if (paths.empty())
+  {
+    return 1;
+  }
+
+  long differ = 0;
+  for (const std::string& path : paths)
+  {
+    differ += compare(path, true);
+  }
+
+  writeSynthetic();
+  differ += compare(SYNTHETIC, true);
+
+  std::ifstream size(SYNTHETIC, std::ios::ate);
+  SequenceTable table;
+  double us = best([&] {
+    table.clear();
+    loadSynthSequence(SYNTHETIC, table);
+  });
+  std::cout << "Synthetic: " << double(size.tellg()) / 1e6 << " MB, " << table.size() << " notes into a table in "
+            << us / 1000 << " ms (" << us * 1000 / table.size() << " ns a note, " << double(size.tellg()) / us
+            << " MB/s)" << std::endl;
+
+  std::remove(SYNTHETIC);
+  return differ == 0 ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+// Silent-tail gate on the bundled PCMEnv-data/*.synthSequence files: each is
+// played through PCMVoiceEngine (the same envelope and gate as PCMEnv) with
+// the gate off, at -90 dBFS and at -60 dBFS, reporting mean and peak active
+// voices, voice-blocks rendered, render time and how far the gated mix strays
+// from the ungated one. Run from the repository root. Exits non-zero if the
+// -90 dBFS mix differs by more than the gate could account for.
+
+#include <glob.h>
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "SoundBank.hpp"
+#include "SoundBankLoader.hpp"
+#include "VoiceEngine.hpp"
+
+const int RATE = 48000;
+const int BUFFER = 128;
+
+std::vector<Patch*> SoundBank = defaultSoundBank();
+
+// One "@ start duration PCMEnv timbre frequency amplitude midiNote attack release pan interpolate" line
+struct Event
+{
+  double start, duration;
+  int timbre;
+  float amplitude, note, attack, release, pan;
+  int interpolate;
+};
+
+std::vector<Event> readSequence(const std::string& path)
+{
+  std::vector<Event> events;
+  std::ifstream file(path);
+  std::string line;
+
+  while (std::getline(file, line))
+  {
+    std::istringstream fields(line);
+    std::string at, name;
+    float frequency;
+    Event e;
+    if (fields >> at >> e.start >> e.duration >> name >> e.timbre >> frequency >> e.amplitude >> e.note >>
+          e.attack >> e.release >> e.pan >> e.interpolate && at == "@")
+    {
+      events.push_back(e);
+    }
+  }
+  return events;
+}
+
+struct Result
+{
+  double meanVoices = 0;
+  int peakVoices = 0;
+  long voiceBlocks = 0;
+  double us = 0;
+  long silenced = 0;
+  std::vector<float> mix;
+};
+
+Result play(const std::vector<Event>& events, float threshold)
+{
+  std::unique_ptr<PCMVoiceEngine> engine(new PCMVoiceEngine());
+  engine->sampleRate = RATE;
+  engine->silenceThreshold = threshold;
+
+  double end = 0;
+  for (const Event& e : events)
+  {
+    end = std::max(end, e.start + e.duration + e.release + 5);
+  }
+  int callbacks = int(end * RATE / BUFFER);
+
+  Result result;
+  result.mix.assign(size_t(callbacks) * BUFFER * 2, 0.f);
+  std::vector<int> slots(events.size(), -1);
+  std::vector<int> owner(PCMVoiceEngine::MAX_VOICES, -1);
+
+  for (int callback = 0; callback < callbacks; callback++)
+  {
+    double from = double(callback) * BUFFER / RATE, to = from + double(BUFFER) / RATE;
+
+    // Free what ended last block, as PCMBatchVoice::onProcess does
+    for (int slot = 0; slot < PCMVoiceEngine::MAX_VOICES; slot++)
+    {
+      if (owner[slot] >= 0 && engine->ended(slot))
+      {
+        engine->stop(slot);
+        slots[owner[slot]] = -1;
+        owner[slot] = -1;
+      }
+    }
+
+    for (int n = 0; n < int(events.size()); n++)
+    {
+      const Event& e = events[n];
+      if (e.start >= from && e.start < to)
+      {
+        KeyZone zone = SoundBank[e.timbre]->zone(e.note);
+        if (zone.sample && zone.sample->buffer->frameCount > 0)
+        {
+          int slot = engine->start(*zone.sample->buffer, zone.rate);
+          if (slot >= 0)
+          {
+            float angle = (e.pan + 1) * float(M_PI) / 4, gain = e.amplitude / 2;
+            engine->control(slot, e.interpolate, gain * std::cos(angle), gain * std::sin(angle), e.attack, e.release);
+            slots[n] = slot;
+            owner[slot] = n;
+          }
+        }
+      }
+      double off = e.start + e.duration;
+      if (off >= from && off < to && slots[n] >= 0)
+      {
+        engine->release(slots[n]);
+      }
+    }
+
+    result.meanVoices += engine->active();
+    result.peakVoices = std::max(result.peakVoices, engine->active());
+    result.voiceBlocks += engine->active();
+
+    float* left = &result.mix[size_t(callback) * BUFFER * 2];
+    auto start = std::chrono::steady_clock::now();
+    engine->render(left, left + BUFFER, BUFFER);
+    result.us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  result.meanVoices /= callbacks;
+  result.silenced = engine->silenced.load();
+  return result;
+}
+
+double dbfs(double level) { return level > 0 ? 20 * std::log10(level) : -INFINITY; }
+
+int main()
+{
+  SampleBuffer::targetRate() = RATE;
+  SampleBuffer::streamLongerThan() = 0; // rendering faster than real time would outrun the disk stream
+  SoundBankLoader loader;
+  loader.start(SoundBank);
+  loader.wait();
+  logger().flush();
+
+  glob_t matches;
+  glob("PCMEnv-data/*.synthSequence", 0, nullptr, &matches);
+  std::vector<std::string> paths(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+  globfree(&matches);
+
+  const float THRESHOLDS[] = {0, 3.1623e-5f, 1e-3f};
+  const char* LABELS[] = {"off", "-90 dB", "-60 dB"};
+
+  std::cout << std::setw(26) << "" << std::setw(8) << "gate" << std::setw(10) << "mean" << std::setw(7) << "peak"
+            << std::setw(12) << "blocks" << std::setw(10) << "render ms" << std::setw(10) << "freed" << std::setw(14)
+            << "max diff dB" << std::endl;
+
+  bool ok = true;
+  long totals[3] = {};
+  for (const std::string& path : paths)
+  {
+    std::vector<Event> events = readSequence(path);
+    Result reference;
+
+    for (int t = 0; t < 3; t++)
+    {
+      Result result = play(events, THRESHOLDS[t]);
+      totals[t] += result.voiceBlocks;
+
+      double diff = 0;
+      if (t == 0)
+      {
+        reference = result;
+      }
+      else
+      {
+        for (size_t i = 0; i < result.mix.size(); i++)
+        {
+          diff = std::max(diff, double(std::fabs(result.mix[i] - reference.mix[i])));
+        }
+      }
+
+      // Each freed voice was below the threshold in RMS; allow for peaks and overlap
+      if (t == 1 && diff > 8 * THRESHOLDS[t] * std::max(result.peakVoices, 1))
+      {
+        ok = false;
+      }
+
+      std::string name = path.substr(path.find('/') + 1);
+      std::cout << std::setw(26) << (t == 0 ? name.substr(0, 25) : "") << std::setw(8) << LABELS[t] << std::fixed
+                << std::setprecision(2) << std::setw(10) << result.meanVoices << std::setw(7) << result.peakVoices
+                << std::setw(12) << result.voiceBlocks << std::setw(10) << result.us / 1000 << std::setw(10)
+                << result.silenced << std::setw(14) << std::setprecision(1) << (t == 0 ? 0 : dbfs(diff)) << std::endl;
+    }
+  }
+
+  std::cout << "Voice-blocks rendered: " << totals[0] << " ungated, " << totals[1] << " at -90 dBFS ("
+            << std::setprecision(1) << 100.0 * (totals[0] - totals[1]) / std::max(totals[0], 1L) << "% fewer), "
+            << totals[2] << " at -60 dBFS" << std::endl;
+  return ok ? 0 : 1;
+}
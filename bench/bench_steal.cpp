@@ -0,0 +1,305 @@
+// Voice limiting under a pile-up of long releases: a note every 8 callbacks
+// with a 10 s release, rendered through the PCM kernel for 30 s. Compares no
+// limit, the 64-voice cap under each stealing policy, and a CPU budget tight
+// enough to trip, reporting peak polyphony, render time, the VoiceManager
+// counters and the largest per-frame gain step while a stolen voice fades
+// out (a hard cut would be up to 1). The cap is then run again on
+// PCMVoiceEngine slots registered as PCMBatchVoice does, checking stolen
+// slots fall silent within the fade.
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "PCMKernel.hpp"
+#include "VoiceEngine.hpp"
+#include "VoiceManager.hpp"
+
+const int RATE = 48000;
+const int BUFFER = 128;
+const int CALLBACKS = 30 * RATE / BUFFER;
+const int POOL = 512;
+
+// PCMEnv's envelope, fade and limiter hooks around the real render kernel
+struct SimVoice : StealableVoice
+{
+  VoiceManager* manager = nullptr;
+  bool active = false, releasing = false, stolen = false;
+  float env = 0, attackStep = 0, releaseStep = 0, fade = 1, fadeStep = 0, level = 0;
+  PlayHead head;
+  ParamRamp leftGain, rightGain;
+  float envelope[BUFFER];
+  float lastGain = 0, maxFadeStep = 0;
+
+  float loudness() const override { return level; }
+  void steal() override { stolen = true; }
+
+  void start(float rate)
+  {
+    active = true;
+    releasing = stolen = false;
+    env = 0;
+    attackStep = 1 / (0.001f * RATE);
+    fade = 1;
+    fadeStep = 1 / (manager->fadeSeconds * RATE);
+    head.start(rate);
+    leftGain.reset(0.2f);
+    rightGain.reset(0.2f);
+    lastGain = 0;
+  }
+
+  void release()
+  {
+    releasing = true;
+    releaseStep = env / (10.f * RATE);
+  }
+
+  void process(const SampleReader& reader, int length, float* left, float* right)
+  {
+    for (int i = 0; i < BUFFER; i++)
+    {
+      env = releasing ? std::max(env - releaseStep, 0.f) : std::min(env + attackStep, 1.f);
+      envelope[i] = env;
+      if (stolen)
+      {
+        envelope[i] *= fade;
+        fade = std::max(fade - fadeStep, 0.f);
+        maxFadeStep = std::max(maxFadeStep, std::fabs(envelope[i] - lastGain));
+      }
+      lastGain = envelope[i];
+    }
+    level = envelope[BUFFER - 1];
+
+    int rendered = renderPCM(reader, length, head, INTERP_LINEAR, envelope, leftGain, rightGain, left, right, BUFFER);
+    if (rendered < BUFFER || (releasing && env == 0) || (stolen && fade == 0))
+    {
+      active = false;
+      manager->finished(this);
+    }
+  }
+};
+
+// PCMBatchVoice's limiter hooks over an engine slot
+struct SlotVoice : StealableVoice
+{
+  PCMVoiceEngine* engine = nullptr;
+  VoiceManager* manager = nullptr;
+  int slot = -1;
+  bool stolen = false;
+  long stolenAt = 0; // callback
+
+  float loudness() const override { return engine->loudness(slot); }
+
+  void steal() override
+  {
+    stolen = true;
+    engine->fadeOut(slot, manager->fadeSeconds);
+  }
+};
+
+struct Scenario
+{
+  const char* name;
+  int maxVoices;
+  double budget;
+  StealPolicy policy;
+};
+
+int main()
+{
+  // A 40 s tone, long enough for any voice
+  std::vector<int16_t> tone(40 * RATE);
+  for (size_t i = 0; i < tone.size(); i++)
+  {
+    tone[i] = clampToPcm16(0.5 * std::sin(2 * M_PI * 220 * i / RATE));
+  }
+  SampleReader reader;
+  reader.head = tone.data();
+  reader.headFrames = tone.size();
+
+  const Scenario scenarios[] = {
+    {"no limit", POOL, 100, STEAL_OLDEST},
+    {"cap 64, oldest", 64, 100, STEAL_OLDEST},
+    {"cap 64, quietest", 64, 100, STEAL_QUIETEST},
+    {"cap 64, same-note", 64, 100, STEAL_SAME_NOTE},
+    {"budget 2%, oldest", POOL, 0.02, STEAL_OLDEST},
+  };
+
+  std::cout << std::setw(20) << "" << std::setw(8) << "peak" << std::setw(12) << "us/call" << std::setw(8) << "cap"
+            << std::setw(8) << "retrig" << std::setw(8) << "cpu" << std::setw(10) << "overrun" << std::setw(8)
+            << "limit" << std::setw(10) << "fade step" << std::endl;
+
+  for (const Scenario& scenario : scenarios)
+  {
+    std::unique_ptr<VoiceManager> limiter(new VoiceManager());
+    VoiceManager& manager = *limiter;
+    manager.maxVoices = scenario.maxVoices;
+    manager.budget = scenario.budget;
+    manager.policy = scenario.policy;
+
+    std::vector<SimVoice> voices(POOL);
+    for (SimVoice& voice : voices)
+    {
+      voice.manager = &manager;
+    }
+    std::vector<int> noteVoice(8, -1);
+    std::vector<float> mix(BUFFER * 2);
+    int peak = 0;
+    float maxStep = 0;
+    double totalUs = 0;
+
+    for (int callback = 0; callback < CALLBACKS; callback++)
+    {
+      manager.beginCallback();
+      auto start = std::chrono::steady_clock::now();
+
+      // Note on every 8 callbacks, cycling over 8 notes; off 2 callbacks later
+      int note = callback / 8 % 8;
+      if (callback % 8 == 0)
+      {
+        for (int v = 0; v < POOL; v++)
+        {
+          if (!voices[v].active)
+          {
+            voices[v].start(std::exp2(note / 12.f));
+            noteVoice[note] = v;
+            manager.started(&voices[v], note);
+            break;
+          }
+        }
+      }
+      else if (callback % 8 == 2 && noteVoice[note] >= 0)
+      {
+        voices[noteVoice[note]].release();
+      }
+
+      std::fill(mix.begin(), mix.end(), 0.f);
+      int sounding = 0;
+      for (SimVoice& voice : voices)
+      {
+        if (voice.active)
+        {
+          sounding += !voice.stolen;
+          voice.process(reader, tone.size(), mix.data(), mix.data() + BUFFER);
+        }
+      }
+      peak = std::max(peak, sounding);
+
+      totalUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+      manager.endCallback(double(BUFFER) / RATE);
+    }
+
+    for (SimVoice& voice : voices)
+    {
+      maxStep = std::max(maxStep, voice.maxFadeStep);
+    }
+
+    std::cout << std::setw(20) << scenario.name << std::setw(8) << peak << std::setw(12) << std::fixed
+              << std::setprecision(1) << totalUs / CALLBACKS << std::setw(8) << manager.capSteals.load()
+              << std::setw(8) << manager.retriggers.load() << std::setw(8) << manager.budgetSteals.load()
+              << std::setw(10) << manager.overruns.load() << std::setw(8) << manager.limit.load() << std::setw(10)
+              << std::setprecision(4) << maxStep << std::endl;
+  }
+
+  // The same notes on engine slots, cap 64, oldest first
+  auto pcm = std::make_shared<std::vector<int16_t>>(tone);
+  SampleBuffer buffer("tone");
+  buffer.adopt(pcm->data(), int(pcm->size()), RATE, 0, pcm);
+
+  std::unique_ptr<PCMVoiceEngine> batch(new PCMVoiceEngine());
+  PCMVoiceEngine& engine = *batch;
+  engine.sampleRate = RATE;
+  engine.silenceThreshold = 0;
+  std::unique_ptr<VoiceManager> limiter(new VoiceManager());
+  VoiceManager& manager = *limiter;
+  manager.maxVoices = 64;
+
+  std::vector<SlotVoice> voices(PCMVoiceEngine::MAX_VOICES);
+  std::vector<int> noteVoice(8, -1);
+  std::vector<float> mix(BUFFER * 2);
+  int peak = 0, dropped = 0;
+  long slowestFade = 0;
+  double totalUs = 0;
+
+  for (int callback = 0; callback < CALLBACKS; callback++)
+  {
+    manager.beginCallback();
+    auto start = std::chrono::steady_clock::now();
+
+    // Ended slots are handed back, as PCMBatchVoice::onProcess does
+    for (SlotVoice& voice : voices)
+    {
+      if (voice.slot >= 0 && engine.ended(voice.slot))
+      {
+        if (voice.stolen)
+        {
+          slowestFade = std::max(slowestFade, (callback - voice.stolenAt) * long(BUFFER));
+        }
+        engine.stop(voice.slot);
+        manager.finished(&voice);
+        voice.slot = -1;
+      }
+    }
+
+    int note = callback / 8 % 8;
+    if (callback % 8 == 0)
+    {
+      int slot = engine.start(buffer, std::exp2(note / 12.f));
+      dropped += slot < 0;
+      for (SlotVoice& voice : voices)
+      {
+        if (slot >= 0 && voice.slot < 0)
+        {
+          voice.engine = &engine;
+          voice.manager = &manager;
+          voice.slot = slot;
+          voice.stolen = false;
+          noteVoice[note] = int(&voice - voices.data());
+          engine.control(slot, INTERP_LINEAR, 0.2f, 0.2f, 0.001f, 10);
+          manager.started(&voice, note);
+          break;
+        }
+      }
+    }
+    else if (callback % 8 == 2 && noteVoice[note] >= 0 && voices[noteVoice[note]].slot >= 0)
+    {
+      engine.release(voices[noteVoice[note]].slot);
+    }
+
+    for (SlotVoice& voice : voices)
+    {
+      if (voice.stolen && voice.stolenAt < 0)
+      {
+        voice.stolenAt = callback;
+      }
+    }
+
+    std::fill(mix.begin(), mix.end(), 0.f);
+    engine.render(mix.data(), mix.data() + BUFFER, BUFFER);
+    int sounding = 0;
+    for (SlotVoice& voice : voices)
+    {
+      sounding += voice.slot >= 0 && !voice.stolen;
+      voice.stolenAt = voice.stolen ? voice.stolenAt : -1;
+    }
+    peak = std::max(peak, sounding);
+
+    totalUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    manager.endCallback(double(BUFFER) / RATE);
+  }
+
+  std::cout << std::setw(20) << "cap 64, engine" << std::setw(8) << peak << std::setw(12) << std::fixed
+            << std::setprecision(1) << totalUs / CALLBACKS << std::setw(8) << manager.capSteals.load()
+            << std::setw(8) << manager.retriggers.load() << std::setw(8) << manager.budgetSteals.load()
+            << std::setw(10) << manager.overruns.load() << std::setw(8) << manager.limit.load() << std::setw(10)
+            << "-" << std::endl;
+  std::cout << "engine: stolen slots silent within " << slowestFade << " frames (fade "
+            << int(manager.fadeSeconds * RATE) << "), " << dropped << " notes found every slot busy" << std::endl;
+
+  bool capped = peak <= manager.maxVoices && manager.capSteals > 0 && dropped == 0;
+  bool faded = slowestFade <= long(manager.fadeSeconds * RATE) + BUFFER;
+  return capped && faded ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+// PCMVoiceEngine rendered on 0-3 pool workers besides the calling thread:
+// time per 128-frame callback, deadline misses and worker wake-up latency,
+// and a check that every worker count mixes bit-identical output. Exits
+// non-zero if any run differs from the single-threaded pooled one.
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "VoiceEngine.hpp"
+
+const int BUFFER = 128;
+const int RATE = 48000;
+const int BLOCKS = 1000;
+const int VOICES = 256;
+const int SAMPLES = 16;
+
+// Start the same 256 notes on `engine` and render BLOCKS buffers into `out`
+double renderAll(PCMVoiceEngine& engine, const std::vector<std::unique_ptr<SampleBuffer>>& samples,
+                 std::vector<float>& out)
+{
+  engine.sampleRate = RATE;
+  for (int v = 0; v < VOICES; v++)
+  {
+    int slot = engine.start(*samples[v * 7 % SAMPLES], std::exp2((v * 5 % 13 - 12) / 12.f));
+    engine.control(slot, v % INTERP_SINC, 0.01f * (v % 5 + 1), 0.01f * (5 - v % 5), 0.005f, 0.5f);
+  }
+
+  out.assign(size_t(BLOCKS) * BUFFER * 2, 0.f);
+  auto start = std::chrono::steady_clock::now();
+
+  for (int block = 0; block < BLOCKS; block++)
+  {
+    float* left = &out[size_t(block) * BUFFER * 2];
+    engine.render(left, left + BUFFER, BUFFER);
+  }
+
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BLOCKS;
+}
+
+int main()
+{
+  std::vector<std::unique_ptr<SampleBuffer>> samples;
+  int length = BUFFER * BLOCKS + 1024;
+  for (int s = 0; s < SAMPLES; s++)
+  {
+    auto pcm = std::make_shared<std::vector<int16_t>>(length);
+    for (int i = 0; i < length; i++)
+    {
+      (*pcm)[i] = clampToPcm16(0.5 * std::sin(2 * M_PI * (110 + 20 * s) * i / RATE));
+    }
+    samples.emplace_back(new SampleBuffer("tone"));
+    samples.back()->adopt(pcm->data(), length, RATE, s, pcm);
+  }
+
+  double budget = 1e9 * BUFFER / RATE;
+  std::cout << VOICES << " voices, " << BUFFER << "-frame buffers (" << budget / 1000 << " us each), "
+            << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+
+  std::vector<float> reference, out;
+  {
+    std::unique_ptr<PCMVoiceEngine> engine(new PCMVoiceEngine());
+    double ns = renderAll(*engine, samples, out);
+    std::cout << "no pool: " << ns / 1000 << " us per callback" << std::endl;
+  }
+
+  bool identical = true;
+  for (int workers = 0; workers <= 3; workers++)
+  {
+    // Twice each, so scheduling gets a chance to differ
+    for (int run = 0; run < 2; run++)
+    {
+      std::unique_ptr<PCMVoiceEngine> engine(new PCMVoiceEngine());
+      engine->threads(workers, BUFFER);
+      double ns = renderAll(*engine, samples, out);
+
+      bool same = true;
+      if (reference.empty())
+      {
+        reference = out;
+      }
+      else
+      {
+        same = memcmp(reference.data(), out.data(), out.size() * sizeof(float)) == 0;
+        identical &= same;
+      }
+
+      std::cout << workers << " workers: " << ns / 1000 << " us per callback, "
+                << (same ? "bit-identical" : "DIFFERS") << std::endl;
+      engine->printStats();
+      logger().flush();
+    }
+  }
+
+  return identical ? 0 : 1;
+}
@@ -0,0 +1,229 @@
+// Per-voice render cost at 128-frame buffers: the old PCMEnv loop, which did
+// a string-keyed parameter lookup and a pan-law evaluation for every frame,
+// against the block-rate kernel in PCMKernel.hpp on each instruction set.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "PCMKernel.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+const int BUFFER = 128;
+const int VOICES = 32;
+const int BLOCKS = 2000;
+const int RATE = 48000;
+
+// Stands in for SynthVoice's internal parameters, looked up by name
+struct Parameters
+{
+  std::map<std::string, float> values{
+    {"amplitude", 0.8f}, {"pan", 0.3f}, {"interpolate", 1}, {"attackTime", 0.01f}, {"releaseTime", 0.5f}};
+
+  float get(const std::string& name) const { return values.find(name)->second; }
+};
+
+// Equal-power pan law, evaluated the way the old loop did: once per frame
+void panGains(float pan, float& left, float& right)
+{
+  float angle = (pan + 1) * float(M_PI) / 4;
+  left = std::cos(angle);
+  right = std::sin(angle);
+}
+
+// The old PCMEnv::linear_interpolate
+float linear_interpolate(const SampleReader& data, float position, int length)
+{
+  int floored_position = floor(position);
+  float current_item = data.frame(floored_position);
+  int next_position = floored_position + 1;
+
+  if (next_position < length)
+  {
+    float next_item = data.frame(next_position);
+    float fraction = position - floored_position;
+
+    return current_item + fraction * (next_item - current_item);
+  }
+
+  return current_item;
+}
+
+struct Voice
+{
+  Parameters parameters;
+  float position = 0; // the old loop's read position
+  float rate = 1;
+  PlayHead head;      // the kernel's
+  ParamRamp leftGain, rightGain;
+};
+
+void legacyBlock(Voice& voice, const SampleReader& reader, int length, float* left, float* right)
+{
+  bool interpolate = voice.parameters.get("interpolate");
+
+  for (int i = 0; i < BUFFER; i++)
+  {
+    float l, r;
+    panGains(voice.parameters.get("pan"), l, r);
+
+    float s1 = 0;
+    if (voice.position < length)
+    {
+      s1 = interpolate ? linear_interpolate(reader, voice.position, length) : reader.frame(voice.position);
+      s1 = s1 / 2 * 1.f * voice.parameters.get("amplitude"); // attenuation, envelope, amplitude
+    }
+
+    voice.position += voice.rate;
+    left[i] += s1 * l;
+    right[i] += s1 * r;
+  }
+}
+
+void kernelBlock(Voice& voice, const SampleReader& reader, int length, const float* env, float* left, float* right)
+{
+  int interpolation = voice.parameters.get("interpolate");
+  float gain = voice.parameters.get("amplitude") / 2;
+  float l, r;
+  panGains(voice.parameters.get("pan"), l, r);
+
+  voice.leftGain.rampTo(gain * l, BUFFER);
+  voice.rightGain.rampTo(gain * r, BUFFER);
+  renderPCM(reader, length, voice.head, interpolation, env, voice.leftGain, voice.rightGain,
+            left, right, BUFFER);
+  voice.leftGain.settle();
+  voice.rightGain.settle();
+}
+
+template <class Render>
+double timeVoices(std::vector<Voice>& voices, std::vector<float>& mix, Render render)
+{
+  auto start = Clock::now();
+
+  for (int block = 0; block < BLOCKS; block++)
+  {
+    std::fill(mix.begin(), mix.end(), 0.f);
+    for (Voice& voice : voices)
+    {
+      render(voice, mix.data(), mix.data() + BUFFER);
+    }
+  }
+
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (double(BLOCKS) * voices.size());
+}
+
+// Time every available kernel against the scalar reference on the same voices
+void compareKernels(const SampleReader& reader, int length, const std::vector<float>& env)
+{
+  const char* names[] = {"scalar", "sse2", "avx2"};
+  PCMIsa detected = pcmIsa();
+  std::vector<float> reference;
+  double budget = 1e9 * BUFFER / RATE;
+
+  for (int isa = PCM_SCALAR; isa <= detected; isa++)
+  {
+    pcmIsa() = PCMIsa(isa);
+
+    // Ramping gains, a spread of rates and every interpolator
+    std::vector<Voice> voices(VOICES);
+    for (int v = 0; v < VOICES; v++)
+    {
+      voices[v].head.start(std::exp2((v - 12) / 12.f));
+      voices[v].parameters.values["pan"] = v / float(VOICES) * 2 - 1;
+      voices[v].parameters.values["interpolate"] = v % INTERP_COUNT;
+    }
+
+    std::vector<float> mix(BUFFER * 2);
+    double ns = timeVoices(voices, mix, [&](Voice& voice, float* left, float* right) {
+      voice.parameters.values["amplitude"] = 0.5f + 0.5f * std::sin(voice.head.frame() * 1e-3f);
+      kernelBlock(voice, reader, length, env.data(), left, right);
+    });
+
+    float difference = 0;
+    if (isa == PCM_SCALAR)
+    {
+      reference = mix;
+    }
+    for (int i = 0; i < BUFFER * 2; i++)
+    {
+      difference = std::max(difference, std::fabs(reference[i] - mix[i]));
+    }
+
+    std::cout << names[isa] << " kernel: " << ns << " ns per voice block, " << int(budget / ns)
+              << " voices per core, max difference from scalar " << difference << std::endl;
+  }
+
+  pcmIsa() = detected;
+}
+
+int main()
+{
+  // A long tone, so no voice runs out during the run
+  int length = BUFFER * BLOCKS * 2 + 16;
+  std::vector<int16_t> tone(length);
+  for (int i = 0; i < length; i++)
+  {
+    tone[i] = clampToPcm16(0.5 * std::sin(2 * M_PI * 220 * i / RATE));
+  }
+
+  SampleReader reader;
+  reader.head = tone.data();
+  reader.headFrames = length;
+
+  std::vector<float> env(BUFFER, 1.f), legacyMix(BUFFER * 2), kernelMix(BUFFER * 2);
+  std::vector<Voice> legacy(VOICES), kernel(VOICES);
+
+  for (int v = 0; v < VOICES; v++)
+  {
+    legacy[v].rate = std::exp2(v / 12.f);
+    kernel[v].head.start(legacy[v].rate);
+    float l, r;
+    panGains(0.3f, l, r);
+    kernel[v].leftGain.reset(0.4f * l);
+    kernel[v].rightGain.reset(0.4f * r);
+  }
+
+  double legacyNs = timeVoices(legacy, legacyMix, [&](Voice& voice, float* left, float* right) {
+    legacyBlock(voice, reader, length, left, right);
+  });
+  double kernelNs = timeVoices(kernel, kernelMix, [&](Voice& voice, float* left, float* right) {
+    kernelBlock(voice, reader, length, env.data(), left, right);
+  });
+
+  // With constant parameters both paths must produce the same first block.
+  // Later blocks drift apart: the old loop accumulated its read position.
+  for (int v = 0; v < VOICES; v++)
+  {
+    legacy[v].position = 0;
+    kernel[v].head.phase = 0;
+  }
+  std::fill(legacyMix.begin(), legacyMix.end(), 0.f);
+  std::fill(kernelMix.begin(), kernelMix.end(), 0.f);
+  for (int v = 0; v < VOICES; v++)
+  {
+    legacyBlock(legacy[v], reader, length, legacyMix.data(), legacyMix.data() + BUFFER);
+    kernelBlock(kernel[v], reader, length, env.data(), kernelMix.data(), kernelMix.data() + BUFFER);
+  }
+
+  float difference = 0;
+  for (int i = 0; i < BUFFER * 2; i++)
+  {
+    difference = std::max(difference, std::fabs(legacyMix[i] - kernelMix[i]));
+  }
+
+  double budget = 1e9 * BUFFER / RATE;
+  std::cout << VOICES << " voices, " << BUFFER << "-frame buffers at " << RATE << " Hz" << std::endl;
+  std::cout << "per-frame lookups: " << legacyNs << " ns per voice block (" << 100 * legacyNs / budget
+            << "% of one core per voice)" << std::endl;
+  std::cout << "block-rate kernel: " << kernelNs << " ns per voice block (" << 100 * kernelNs / budget
+            << "% of one core per voice)" << std::endl;
+  std::cout << "speedup " << legacyNs / kernelNs << "x, max output difference " << difference << std::endl;
+
+  compareKernels(reader, length, env);
+  return 0;
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include "PcmConvert.hpp"
+
+// The vector kernels use GCC/Clang vector operators on __m128 and __m256, so
+// the interpolators' weight formulas are written once for scalar and SIMD
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PCM_HAVE_VECTOR_KERNELS 1
+#define PCM_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// Read-position interpolators for sample playback, selected per voice by the
+// `interpolate` parameter. Each one reads TAPS frames starting BEFORE frames
+// ahead of the integer position and weights them by the fractional part.
+// Weights take float, __m128 or __m256 lanes; vectors are passed by reference
+// so the templates stay ABI-neutral outside the AVX2 kernel.
+enum Interpolation
+{
+  INTERP_NONE,     // truncate to the frame below
+  INTERP_LINEAR,
+  INTERP_HERMITE,  // 4-point, 3rd-order (Catmull-Rom)
+  INTERP_LAGRANGE, // 6-point, 5th-order
+  INTERP_SINC,     // 32-point Kaiser-windowed sinc from a phase table
+  INTERP_COUNT
+};
+
+struct InterpNone
+{
+  static const int BEFORE = 0;
+  static const int TAPS = 1;
+
+  template <class V>
+  static void weights(const V&, V* w)
+  {
+    w[0] = V{} + 1.f;
+  }
+};
+
+struct InterpLinear
+{
+  static const int BEFORE = 0;
+  static const int TAPS = 2;
+
+  template <class V>
+  static void weights(const V& f, V* w)
+  {
+    w[0] = 1.f - f;
+    w[1] = f;
+  }
+};
+
+struct InterpHermite
+{
+  static const int BEFORE = 1;
+  static const int TAPS = 4;
+
+  template <class V>
+  static void weights(const V& f, V* w)
+  {
+    V f2 = f * f;
+    w[0] = f * (f * (1.f - 0.5f * f) - 0.5f);
+    w[1] = f2 * (1.5f * f - 2.5f) + 1.f;
+    w[2] = f * (f * (2.f - 1.5f * f) + 0.5f);
+    w[3] = f2 * (0.5f * f - 0.5f);
+  }
+};
+
+struct InterpLagrange
+{
+  static const int BEFORE = 2;
+  static const int TAPS = 6;
+
+  // w[k] = prod over j != k of (f - x_j) / (x_k - x_j), nodes x = -2 ... 3
+  template <class V>
+  static void weights(const V& f, V* w)
+  {
+    V d[TAPS];
+    for (int k = 0; k < TAPS; k++)
+    {
+      d[k] = f - float(k - BEFORE);
+    }
+
+    V prefix[TAPS];
+    prefix[0] = V{} + 1.f;
+    for (int k = 1; k < TAPS; k++)
+    {
+      prefix[k] = prefix[k - 1] * d[k - 1];
+    }
+
+    const float scale[TAPS] = {-1 / 120.f, 1 / 24.f, -1 / 12.f, 1 / 12.f, -1 / 24.f, 1 / 120.f};
+    V suffix = V{} + 1.f;
+    for (int k = TAPS - 1; k >= 0; k--)
+    {
+      w[k] = prefix[k] * suffix * scale[k];
+      suffix = suffix * d[k];
+    }
+  }
+};
+
+// Windowed sinc from a table of PHASES fractional offsets, linearly blended
+// between neighbouring phases. Cutoff sits just below the source Nyquist; it
+// band-limits resampling at or below the root, not transposition upwards.
+struct InterpSinc
+{
+  static const int BEFORE = 15;
+  static const int TAPS = 32; // keep in step with the shift in the SSE2 weights
+  static const int PHASES = 256;
+
+  // Rows 0 ... PHASES, each TAPS coefficients; built on first use
+  static const float* table()
+  {
+    static std::vector<float> coefficients = build();
+    return coefficients.data();
+  }
+
+  static void weights(const float& f, float* w)
+  {
+    const float* rows = table();
+    float phase = f * PHASES;
+    int row = int(phase);
+    float blend = phase - float(row);
+    const float* a = rows + row * TAPS;
+
+    for (int k = 0; k < TAPS; k++)
+    {
+      w[k] = a[k] + blend * (a[k + TAPS] - a[k]);
+    }
+  }
+
+#ifdef PCM_HAVE_VECTOR_KERNELS
+  static void weights(const __m128& f, __m128* w)
+  {
+    const float* rows = table();
+    __m128 phase = f * float(PHASES);
+    __m128i row = _mm_cvttps_epi32(phase);
+    __m128 blend = phase - _mm_cvtepi32_ps(row);
+
+    // SSE2 has no 32-bit multiply; TAPS is a power of two
+    alignas(16) int32_t at[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(at), _mm_slli_epi32(row, 5));
+
+    for (int k = 0; k < TAPS; k++)
+    {
+      __m128 a = _mm_setr_ps(rows[at[0] + k], rows[at[1] + k], rows[at[2] + k], rows[at[3] + k]);
+      __m128 b = _mm_setr_ps(rows[at[0] + k + TAPS], rows[at[1] + k + TAPS], rows[at[2] + k + TAPS], rows[at[3] + k + TAPS]);
+      w[k] = a + blend * (b - a);
+    }
+  }
+
+  PCM_TARGET_AVX2 static void weights(const __m256& f, __m256* w)
+  {
+    const float* rows = table();
+    __m256 phase = f * float(PHASES);
+    __m256i row = _mm256_cvttps_epi32(phase);
+    __m256 blend = phase - _mm256_cvtepi32_ps(row);
+    __m256i at = _mm256_mullo_epi32(row, _mm256_set1_epi32(TAPS));
+
+    for (int k = 0; k < TAPS; k++)
+    {
+      __m256 a = _mm256_i32gather_ps(rows + k, at, 4);
+      __m256 b = _mm256_i32gather_ps(rows + k + TAPS, at, 4);
+      w[k] = a + blend * (b - a);
+    }
+  }
+#endif
+
+private:
+  static std::vector<float> build()
+  {
+    const double cutoff = 0.9; // of the source Nyquist
+    const double beta = 8;
+    std::vector<float> coefficients((PHASES + 1) * TAPS);
+
+    for (int row = 0; row <= PHASES; row++)
+    {
+      double fraction = double(row) / PHASES;
+      double values[TAPS], sum = 0;
+
+      for (int k = 0; k < TAPS; k++)
+      {
+        double t = (k - BEFORE) - fraction; // tap distance from the read position
+        double x = t * cutoff;
+        double sinc = std::fabs(x) < 1e-9 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+        double edge = t / (TAPS / 2);
+        double window = std::fabs(edge) >= 1 ? 0 : bessel0(beta * std::sqrt(1 - edge * edge)) / bessel0(beta);
+        values[k] = sinc * window;
+        sum += values[k];
+      }
+
+      // Unity gain at DC for every phase
+      for (int k = 0; k < TAPS; k++)
+      {
+        coefficients[row * TAPS + k] = float(values[k] / sum);
+      }
+    }
+
+    return coefficients;
+  }
+
+  static double bessel0(double x)
+  {
+    double sum = 1, term = 1;
+    for (int k = 1; k < 50; k++)
+    {
+      term *= (x / (2 * k)) * (x / (2 * k));
+      sum += term;
+      if (term < 1e-12 * sum)
+      {
+        break;
+      }
+    }
+    return sum;
+  }
+};
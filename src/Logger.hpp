@@ -0,0 +1,311 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+enum LogLevel : uint8_t
+{
+  LOG_DEBUG,
+  LOG_INFO,
+  LOG_WARN,
+  LOG_ERROR,
+};
+
+// Per call site rate limiting state; PCM_LOG_RATE keeps one in a static
+struct LogLimit
+{
+  std::atomic<int64_t> windowStart{0};
+  std::atomic<int> count{0};
+  std::atomic<int> suppressed{0};
+};
+
+// Logging that is safe from the audio thread: write() formats into a
+// fixed-size record on the stack and pushes it onto a preallocated lock-free
+// ring (any number of writers and readers, one CAS each), never allocating,
+// locking or touching the terminal. A background thread drains the ring to
+// stdout or a file every few milliseconds. When the ring is full records are
+// dropped and counted rather than waited for.
+class Logger
+{
+public:
+  static const int CAPACITY = 1024; // records; a power of two
+  static const int TEXT = 240;      // bytes of message per record, longer ones are cut
+  enum { DRAIN_MS = 10 }; // taken by reference (chrono), so it must not need a definition
+
+  std::atomic<int> level{LOG_INFO}; // records below this are skipped before formatting
+  std::atomic<long> dropped{0};     // lost to a full ring
+
+  Logger() : cells(new Cell[CAPACITY]), started(std::chrono::steady_clock::now())
+  {
+    for (int i = 0; i < CAPACITY; i++)
+    {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    running = true;
+    drainer = std::thread([this] {
+      while (running.load(std::memory_order_acquire))
+      {
+        flush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(DRAIN_MS));
+      }
+    });
+  }
+
+  ~Logger()
+  {
+    running = false;
+    drainer.join();
+    flush();
+    if (out != stdout)
+    {
+      fclose(out);
+    }
+  }
+
+  // Append to `path` instead of stdout; call before audio starts
+  bool open(const std::string& path)
+  {
+    FILE* file = fopen(path.c_str(), "a");
+    if (!file)
+    {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(drainLock);
+    out = file;
+    return true;
+  }
+
+  // Print everything written so far from the calling thread; not for the audio thread
+  void flush()
+  {
+    std::lock_guard<std::mutex> lock(drainLock);
+    Record record;
+    bool wrote = false;
+
+    while (pop(record))
+    {
+      static const char* NAMES[] = {"debug", "info ", "warn ", "error"};
+      fprintf(out, "%9.3f %s %s\n", record.nanoseconds * 1e-9, NAMES[record.level], record.text);
+      wrote = true;
+    }
+
+    long lost = dropped.exchange(0, std::memory_order_relaxed);
+    if (lost > 0)
+    {
+      fprintf(out, "          warn  %ld log messages dropped, the ring was full\n", lost);
+      wrote = true;
+    }
+
+    if (wrote)
+    {
+      fflush(out);
+    }
+  }
+
+  // Format `parts` (strings, numbers) into one record and queue it
+  template <typename... Parts>
+  void write(LogLevel severity, const Parts&... parts)
+  {
+    if (severity < level.load(std::memory_order_relaxed))
+    {
+      return;
+    }
+
+    Record record;
+    record.level = severity;
+    record.nanoseconds = elapsed();
+    Line line{record.text, record.text + TEXT - 1};
+    int expand[] = {0, (append(line, parts), 0)...};
+    (void)expand;
+    *line.at = '\0';
+    push(record);
+  }
+
+  // As write(), but at most `perSecond` records a second from this call site;
+  // the next one through says how many were skipped
+  template <typename... Parts>
+  void writeLimited(LogLevel severity, LogLimit& limit, int perSecond, const Parts&... parts)
+  {
+    if (severity < level.load(std::memory_order_relaxed))
+    {
+      return;
+    }
+
+    int64_t now = elapsed(), start = limit.windowStart.load(std::memory_order_relaxed);
+    if (now - start >= 1000000000 && limit.windowStart.compare_exchange_strong(start, now, std::memory_order_relaxed))
+    {
+      limit.count.store(0, std::memory_order_relaxed);
+    }
+    if (limit.count.fetch_add(1, std::memory_order_relaxed) >= perSecond)
+    {
+      limit.suppressed.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    int skipped = limit.suppressed.exchange(0, std::memory_order_relaxed);
+    if (skipped > 0)
+    {
+      write(severity, parts..., " (", skipped, " similar skipped)");
+    }
+    else
+    {
+      write(severity, parts...);
+    }
+  }
+
+private:
+  struct Record
+  {
+    int64_t nanoseconds; // since the logger started
+    LogLevel level;
+    char text[TEXT];
+  };
+
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    Record record;
+  };
+
+  struct Line
+  {
+    char* at;
+    char* end;
+  };
+
+  std::unique_ptr<Cell[]> cells;
+  std::atomic<size_t> tail{0}; // next to push
+  char padding[64];            // keep writers and the reader off each other's line
+  std::atomic<size_t> head{0}; // next to pop
+  std::chrono::steady_clock::time_point started;
+  std::atomic<bool> running{false};
+  std::thread drainer;
+  std::mutex drainLock; // between flush() callers only; writers never take it
+  FILE* out = stdout;
+
+  int64_t elapsed() const
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+  }
+
+  // Bounded MPMC queue (Vyukov): a cell's sequence says whose turn it is
+  void push(const Record& record)
+  {
+    size_t position = tail.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      Cell& cell = cells[position & (CAPACITY - 1)];
+      intptr_t turn = intptr_t(cell.sequence.load(std::memory_order_acquire)) - intptr_t(position);
+      if (turn == 0)
+      {
+        if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+        {
+          cell.record = record;
+          cell.sequence.store(position + 1, std::memory_order_release);
+          return;
+        }
+      }
+      else if (turn < 0)
+      {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      else
+      {
+        position = tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool pop(Record& record)
+  {
+    size_t position = head.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      Cell& cell = cells[position & (CAPACITY - 1)];
+      intptr_t turn = intptr_t(cell.sequence.load(std::memory_order_acquire)) - intptr_t(position + 1);
+      if (turn == 0)
+      {
+        if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+        {
+          record = cell.record;
+          cell.sequence.store(position + CAPACITY, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (turn < 0)
+      {
+        return false;
+      }
+      else
+      {
+        position = head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  static void append(Line& line, const char* text)
+  {
+    while (*text && line.at < line.end)
+    {
+      *line.at++ = *text++;
+    }
+  }
+
+  static void append(Line& line, const std::string& text) { append(line, text.c_str()); }
+
+  static void append(Line& line, char c)
+  {
+    if (line.at < line.end)
+    {
+      *line.at++ = c;
+    }
+  }
+
+  template <typename T>
+  static typename std::enable_if<std::is_integral<T>::value>::type append(Line& line, T value)
+  {
+    char digits[24];
+    if (std::is_signed<T>::value)
+    {
+      snprintf(digits, sizeof(digits), "%lld", (long long)value);
+    }
+    else
+    {
+      snprintf(digits, sizeof(digits), "%llu", (unsigned long long)value);
+    }
+    append(line, digits);
+  }
+
+  static void append(Line& line, double value)
+  {
+    char digits[32];
+    snprintf(digits, sizeof(digits), "%g", value);
+    append(line, digits);
+  }
+};
+
+inline Logger& logger()
+{
+  static Logger log;
+  return log;
+}
+
+// PCM_LOG(LOG_INFO, "Loaded ", path, " with ", frames, " samples")
+#define PCM_LOG(level, ...) logger().write(level, __VA_ARGS__)
+
+// Same, limited to `perSecond` records a second from this line (e.g. per note)
+#define PCM_LOG_RATE(level, perSecond, ...)                              \
+  do                                                                     \
+  {                                                                      \
+    static LogLimit pcmLogLimit;                                         \
+    logger().writeLimited(level, pcmLogLimit, perSecond, __VA_ARGS__);   \
+  } while (0)
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>    // open
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close
+#endif
+
+// Read-only view of a whole file, mmapped where the platform allows it
+struct MappedFile
+{
+  const uint8_t* bytes = nullptr;
+  size_t size = 0;
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  explicit MappedFile(const std::string& filename)
+  {
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+      void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped != MAP_FAILED)
+      {
+        bytes = static_cast<const uint8_t*>(mapped);
+        size = st.st_size;
+      }
+    }
+
+    ::close(fd);
+#else
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (!fp)
+    {
+      return;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    if (length > 0)
+    {
+      fallback.resize(length);
+      if (fread(fallback.data(), 1, length, fp) == size_t(length))
+      {
+        bytes = fallback.data();
+        size = fallback.size();
+      }
+    }
+
+    fclose(fp);
+#endif
+  }
+
+  ~MappedFile()
+  {
+#ifndef _WIN32
+    if (bytes)
+    {
+      munmap(const_cast<uint8_t*>(bytes), size);
+    }
+#endif
+  }
+
+  bool valid() const { return bytes != nullptr; }
+
+#ifdef _WIN32
+private:
+  std::vector<uint8_t> fallback;
+#endif
+};
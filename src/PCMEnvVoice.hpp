@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+
+#include "Gamma/Effects.h"
+#include "Gamma/Envelope.h"
+#include "al/scene/al_PolySynth.hpp"
+
+#include "Interpolator.hpp"
+#include "Patch.hpp"
+#include "PCMKernel.hpp"
+#include "SampleStream.hpp"
+#include "VoiceManager.hpp"
+
+// The sample voice main.cpp and oldMain.cpp both play: block-rate envelope
+// and gains over renderPCM, note-offs on their exact frame, the silence gate
+// and voice stealing. Each app's PCMEnv derives from it, declares its own
+// parameters in init() and picks the patch in onTriggerOn, then calls
+// startNote().
+class PCMEnvVoice : public al::SynthVoice, public StealableVoice
+{
+public:
+  gam::Pan<> mPan;
+  gam::Env<3> mAmpEnv;
+
+  float attenuation = 0;
+  PlayHead playHead; // 32.32 fixed-point read position and per-frame step
+  Sample* sampleRef = nullptr;
+  SampleReader reader;
+  int sampleLength = 0;
+
+  // Block-rate state for onProcess
+  static const int BLOCK = 256; // frames per kernel call; longer buffers are split
+  float envelope[BLOCK];
+  ParamRamp leftGain, rightGain;
+  bool gainsPrimed = false;
+  float lastPan = 2; // outside [-1, 1], so the first block evaluates the pan law
+  float panLeft = 0, panRight = 0;
+
+  // Voice limiting (see VoiceManager)
+  bool stolen = false;
+  float fade = 1, fadeStep = 0;
+  float level = 0; // envelope times amplitude at the end of the last block
+  int mipLevel = 0; // octave level being read; play head frames are 2^mipLevel base frames
+  int startKey = -1; // registered with voiceManager() by the first onProcess
+
+  // Frames from the note's first frame to its note-off, when whoever starts
+  // it knows both (PatternPlayer); set before triggerOn. At -1 the note waits
+  // for triggerOff, which takes effect at the start of the next block.
+  int holdFrames = -1;
+  int releaseIn = -1; // frames left until this note's scheduled release
+
+  // The envelope's shape; the derived init() adds the parameters
+  void init() override
+  {
+    mAmpEnv.curve(0); // make segments lines
+    mAmpEnv.levels(0, 1, 1, 0);
+    mAmpEnv.sustainPoint(2);
+
+    // Build the sinc table here rather than on the audio thread
+    InterpSinc::table();
+  }
+
+  void onProcess(al::AudioIOData& io) override
+  {
+    // Registering (and stealing) happens here on the audio thread, which owns
+    // voiceManager(); onTriggerOn runs on whichever thread triggered the note
+    if (!sampleRef) {
+      finish();
+      return;
+    }
+    if (startKey >= 0) {
+      voiceManager().started(this, startKey);
+      startKey = -1;
+    }
+
+    // Snapshot parameters once per block; the render loop only touches floats
+    int interpolation = getInternalParameterValue("interpolate");
+    float amplitude = getInternalParameterValue("amplitude");
+    float pan = getInternalParameterValue("pan");
+    mAmpEnv.lengths()[0] = getInternalParameterValue("attackTime");
+    mAmpEnv.lengths()[2] = getInternalParameterValue("releaseTime");
+
+    // Let the disk stream refill everything behind the play head
+    if (reader.stream) {
+      reader.stream->consume(playHead.frame());
+    }
+
+    // Evaluate the pan law only when pan moves
+    if (pan != lastPan) {
+      mPan.pos(pan);
+      mPan(1.f, panLeft, panRight);
+      lastPan = pan;
+    }
+
+    int first = io.frame() + 1;
+    int frames = io.framesPerBuffer() - first;
+    float gain = amplitude / attenuation;
+
+    // Ramp towards this block's gains; a new note starts on them directly
+    if (gainsPrimed) {
+      leftGain.rampTo(gain * panLeft, frames);
+      rightGain.rampTo(gain * panRight, frames);
+    } else {
+      leftGain.reset(gain * panLeft);
+      rightGain.reset(gain * panRight);
+      gainsPrimed = true;
+    }
+
+    float* left = io.outBuffer(0) + first;
+    float* right = io.outBuffer(1) + first;
+
+    if (stolen && fadeStep == 0) {
+      fadeStep = 1 / std::max(voiceManager().fadeSeconds * io.framesPerSecond(), 1.0);
+    }
+
+    for (int done = 0; done < frames;)
+    {
+      int count = std::min(frames - done, int(BLOCK));
+
+      // A scheduled note-off lands on its exact frame
+      int held = releaseIn >= 0 && releaseIn < count ? releaseIn : count;
+      for (int i = 0; i < held; i++) {
+        envelope[i] = mAmpEnv();
+      }
+      if (held < count) {
+        mAmpEnv.release();
+        releaseIn = -1;
+        for (int i = held; i < count; i++) {
+          envelope[i] = mAmpEnv();
+        }
+      } else if (releaseIn >= 0) {
+        releaseIn -= count;
+      }
+
+      // A stolen voice fades out over a few milliseconds rather than clicking off
+      if (stolen) {
+        for (int i = 0; i < count; i++) {
+          envelope[i] *= fade;
+          fade = std::max(fade - fadeStep, 0.f);
+        }
+      }
+      level = envelope[count - 1] * amplitude;
+
+      int rendered = renderPCM(reader, sampleLength, playHead, interpolation, envelope,
+                               leftGain, rightGain, left + done, right + done, count);
+      done += count;
+
+      if (rendered < count || mAmpEnv.done() || (stolen && fade == 0)) {
+        finish();
+        break;
+      }
+
+      // Past the attack the envelope only falls, so once nothing left in the
+      // sample can be heard at its current level the voice is done
+      float last = envelope[count - 1];
+      if (last <= envelope[0] &&
+          voiceManager().silent(sampleRef->buffer->tailLevel(playHead.frame() << mipLevel),
+                                last * gain * std::max(panLeft, panRight))) {
+        finish();
+        break;
+      }
+    }
+
+    leftGain.settle();
+    rightGain.settle();
+    io.frame(io.framesPerBuffer());
+  }
+
+  void onTriggerOff() override {
+    releaseIn = -1;
+    mAmpEnv.release();
+  }
+
+  float loudness() const override { return level; }
+
+  void steal() override { stolen = true; }
+
+  // Free the voice and give back its disk stream, if it had one. Audio thread only.
+  void finish() {
+    sampleStreamer().release(reader.stream);
+    reader.stream = nullptr;
+    voiceManager().finished(this);
+    free();
+  }
+protected:
+  // The shared part of onTriggerOn: play `patch`'s zone for `note`, taking
+  // the note-off set in holdFrames. False if the sample isn't loaded yet (or
+  // the file is bad); the voice then stays silent and frees itself in its
+  // first onProcess instead of reading nothing.
+  bool startNote(Patch* patch, float note, int timbre)
+  {
+    this->releaseIn = this->holdFrames;
+    this->holdFrames = -1;
+
+    KeyZone zone = patch->zone(note);
+    this->sampleRef = zone.sample;
+    if (!this->sampleRef || !this->sampleRef->ready() || this->sampleRef->buffer->frameCount == 0)
+    {
+      this->sampleRef = nullptr;
+      return false;
+    }
+
+    // Notes well above the root read a pre-filtered octave level instead
+    this->mipLevel = this->sampleRef->buffer->mipLevelFor(zone.rate);
+    this->playHead.start(zone.rate / float(1 << this->mipLevel));
+
+    // Prepare playback of sample
+    sampleStreamer().release(this->reader.stream);
+    this->reader = this->sampleRef->buffer->read(this->mipLevel);
+    this->sampleLength = this->sampleRef->buffer->playableFrames(this->reader);
+    this->attenuation = 2;
+    this->gainsPrimed = false;
+    this->stolen = false;
+    this->fade = 1;
+    this->fadeStep = 0;
+    this->level = 0;
+
+    // Reset envelope
+    mAmpEnv.reset();
+
+    // May fade out other voices to stay under the cap, once it starts playing
+    this->startKey = timbre * 128 + int(note);
+    return true;
+  }
+};
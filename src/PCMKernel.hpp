@@ -0,0 +1,387 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+
+#include "Interpolator.hpp"
+#include "SampleStream.hpp"
+
+// Per-voice inner loop shared by the PCMEnv voices. Parameters are resolved
+// to plain floats once per audio block by the voice; the kernel only reads
+// frames, interpolates and mixes.
+
+// Linear ramp from the value at the start of a block to a target at its end,
+// so block-rate parameter changes don't step (zipper) at block boundaries
+struct ParamRamp
+{
+  float value = 0; // at the next frame to render
+  float step = 0;  // per frame
+  float goal = 0;
+
+  // Jump straight to `target`, e.g. on a new note
+  void reset(float target)
+  {
+    value = goal = target;
+    step = 0;
+  }
+
+  void rampTo(float target, int frames)
+  {
+    goal = target;
+    step = frames > 0 ? (target - value) / frames : 0;
+    if (frames <= 0)
+    {
+      value = target;
+    }
+  }
+
+  void advance(int frames) { value += step * frames; }
+
+  // End of block: land exactly on the target so rounding can't accumulate
+  void settle()
+  {
+    value = goal;
+    step = 0;
+  }
+};
+
+// Playback position in 32.32 fixed point: whole frames in the high word,
+// the fraction in the low one. Advancing by an integer increment is exact,
+// so pitch doesn't drift however long a note plays.
+struct PlayHead
+{
+  static constexpr double ONE = 4294967296.0; // 1 << 32
+
+  uint64_t phase = 0;
+  uint64_t increment = 0;
+
+  // Back to the first frame, stepping `rate` frames per output frame
+  void start(float rate)
+  {
+    phase = 0;
+    increment = uint64_t(double(rate) * ONE + 0.5);
+  }
+
+  int frame() const { return int(phase >> 32); }
+};
+
+// Interpolation fraction from the low word; the top 24 bits are all a float keeps
+inline float phaseFraction(uint32_t fraction)
+{
+  return float(fraction >> 8) * (1.f / 16777216.f);
+}
+
+// Frames [begin, end) of a block whose source data is contiguous in memory.
+// Frame i reads the sample at `phase + i * increment` and is scaled by env[i]
+// and the gains at i.
+struct PCMSpan
+{
+  const int16_t* frames; // sample data; frames[0] is sample index `first`
+  int first;
+  uint64_t phase;
+  uint64_t increment;
+  const float* env;
+  float left, leftStep;
+  float right, rightStep;
+  float* outLeft;
+  float* outRight;
+  int begin, end;
+};
+
+// Reference implementation; the vector kernels must match it to rounding
+template <class Interp>
+inline void renderSpanScalar(const PCMSpan& span, int begin)
+{
+  for (int i = begin; i < span.end; i++)
+  {
+    uint64_t phase = span.phase + uint64_t(i) * span.increment;
+    int index = int(phase >> 32);
+    const int16_t* at = span.frames + (index - Interp::BEFORE - span.first);
+
+    float w[Interp::TAPS];
+    Interp::weights(phaseFraction(uint32_t(phase)), w);
+
+    float sum = 0;
+    for (int k = 0; k < Interp::TAPS; k++)
+    {
+      sum += w[k] * float(at[k]);
+    }
+
+    float s1 = sum * PCM_SCALE * span.env[i];
+    span.outLeft[i] += s1 * (span.left + float(i) * span.leftStep);
+    span.outRight[i] += s1 * (span.right + float(i) * span.rightStep);
+  }
+}
+
+#ifdef PCM_HAVE_VECTOR_KERNELS
+// Four frames at a time; SSE2 has no gather, so taps are fetched by index
+template <class Interp>
+inline void renderSpanSSE2(const PCMSpan& span)
+{
+  const __m128 lane = _mm_setr_ps(0, 1, 2, 3);
+  const int16_t* frames = span.frames - Interp::BEFORE - span.first;
+  int i = span.begin;
+
+  // Lanes hold the phase of frames i ... i + 3 as index and fraction words
+  alignas(16) int32_t startIndex[4];
+  alignas(16) uint32_t startFraction[4];
+  for (int k = 0; k < 4; k++)
+  {
+    uint64_t phase = span.phase + uint64_t(i + k) * span.increment;
+    startIndex[k] = int32_t(phase >> 32);
+    startFraction[k] = uint32_t(phase);
+  }
+
+  __m128i index = _mm_load_si128(reinterpret_cast<const __m128i*>(startIndex));
+  __m128i fraction = _mm_load_si128(reinterpret_cast<const __m128i*>(startFraction));
+  const uint64_t step = span.increment * 4;
+  const __m128i stepIndex = _mm_set1_epi32(int32_t(step >> 32));
+  const __m128i stepFraction = _mm_set1_epi32(int32_t(uint32_t(step)));
+  const __m128i sign = _mm_set1_epi32(int32_t(0x80000000u));
+
+  for (; i + 4 <= span.end; i += 4)
+  {
+    alignas(16) int32_t at[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(at), index);
+
+    __m128 w[Interp::TAPS];
+    Interp::weights(_mm_cvtepi32_ps(_mm_srli_epi32(fraction, 8)) * (1.f / 16777216.f), w);
+
+    __m128 sum = _mm_setzero_ps();
+    for (int k = 0; k < Interp::TAPS; k++)
+    {
+      __m128i taps = _mm_setr_epi32(frames[at[0] + k], frames[at[1] + k], frames[at[2] + k], frames[at[3] + k]);
+      sum = sum + w[k] * _mm_cvtepi32_ps(taps);
+    }
+
+    __m128 offset = float(i) + lane;
+    __m128 s1 = sum * PCM_SCALE * _mm_loadu_ps(span.env + i);
+    __m128 left = span.left + offset * span.leftStep;
+    __m128 right = span.right + offset * span.rightStep;
+    _mm_storeu_ps(span.outLeft + i, _mm_loadu_ps(span.outLeft + i) + s1 * left);
+    _mm_storeu_ps(span.outRight + i, _mm_loadu_ps(span.outRight + i) + s1 * right);
+
+    // Advance four frames; an unsigned wrap of the fraction carries into the index
+    __m128i next = _mm_add_epi32(fraction, stepFraction);
+    __m128i carry = _mm_cmpgt_epi32(_mm_xor_si128(fraction, sign), _mm_xor_si128(next, sign));
+    index = _mm_sub_epi32(_mm_add_epi32(index, stepIndex), carry);
+    fraction = next;
+  }
+
+  renderSpanScalar<Interp>(span, i);
+}
+
+// Eight frames at a time. Each 32-bit gather at an int16 tap index fetches
+// that tap and the next one together, so TAPS frames take TAPS / 2 gathers.
+template <class Interp>
+PCM_TARGET_AVX2 inline void renderSpanAVX2(const PCMSpan& span)
+{
+  const __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256i first = _mm256_set1_epi32(span.first + Interp::BEFORE);
+  const int* frames = reinterpret_cast<const int*>(span.frames);
+  int i = span.begin;
+
+  // Lanes hold the phase of frames i ... i + 7 as index and fraction words
+  alignas(32) int32_t startIndex[8];
+  alignas(32) uint32_t startFraction[8];
+  for (int k = 0; k < 8; k++)
+  {
+    uint64_t phase = span.phase + uint64_t(i + k) * span.increment;
+    startIndex[k] = int32_t(phase >> 32);
+    startFraction[k] = uint32_t(phase);
+  }
+
+  __m256i index = _mm256_load_si256(reinterpret_cast<const __m256i*>(startIndex));
+  __m256i fraction = _mm256_load_si256(reinterpret_cast<const __m256i*>(startFraction));
+  const uint64_t step = span.increment * 8;
+  const __m256i stepIndex = _mm256_set1_epi32(int32_t(step >> 32));
+  const __m256i stepFraction = _mm256_set1_epi32(int32_t(uint32_t(step)));
+  const __m256i sign = _mm256_set1_epi32(int32_t(0x80000000u));
+
+  for (; i + 8 <= span.end; i += 8)
+  {
+    __m256i tap = _mm256_sub_epi32(index, first);
+
+    __m256 w[Interp::TAPS];
+    Interp::weights(_mm256_cvtepi32_ps(_mm256_srli_epi32(fraction, 8)) * (1.f / 16777216.f), w);
+
+    __m256 sum = _mm256_setzero_ps();
+    for (int k = 0; k < Interp::TAPS; k += 2)
+    {
+      __m256i pair = _mm256_i32gather_epi32(frames, _mm256_add_epi32(tap, _mm256_set1_epi32(k)), 2);
+      sum = sum + w[k] * _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(pair, 16), 16));
+      if (k + 1 < Interp::TAPS)
+      {
+        sum = sum + w[k + 1] * _mm256_cvtepi32_ps(_mm256_srai_epi32(pair, 16));
+      }
+    }
+
+    __m256 offset = float(i) + lane;
+    __m256 s1 = sum * PCM_SCALE * _mm256_loadu_ps(span.env + i);
+    __m256 left = span.left + offset * span.leftStep;
+    __m256 right = span.right + offset * span.rightStep;
+    _mm256_storeu_ps(span.outLeft + i, _mm256_loadu_ps(span.outLeft + i) + s1 * left);
+    _mm256_storeu_ps(span.outRight + i, _mm256_loadu_ps(span.outRight + i) + s1 * right);
+
+    // Advance eight frames; an unsigned wrap of the fraction carries into the index
+    __m256i next = _mm256_add_epi32(fraction, stepFraction);
+    __m256i carry = _mm256_cmpgt_epi32(_mm256_xor_si256(fraction, sign), _mm256_xor_si256(next, sign));
+    index = _mm256_sub_epi32(_mm256_add_epi32(index, stepIndex), carry);
+    fraction = next;
+  }
+
+  renderSpanScalar<Interp>(span, i);
+}
+#endif
+
+enum PCMIsa { PCM_SCALAR, PCM_SSE2, PCM_AVX2 };
+
+inline PCMIsa detectPCMIsa()
+{
+#ifdef PCM_HAVE_VECTOR_KERNELS
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? PCM_AVX2 : PCM_SSE2;
+#else
+  return PCM_SCALAR;
+#endif
+}
+
+// Kernel used by renderPCM, picked once from the CPU; benchmarks may override it
+inline PCMIsa& pcmIsa()
+{
+  static PCMIsa isa = detectPCMIsa();
+  return isa;
+}
+
+template <class Interp>
+inline void renderSpan(const PCMSpan& span)
+{
+  switch (pcmIsa())
+  {
+#ifdef PCM_HAVE_VECTOR_KERNELS
+    case PCM_AVX2: renderSpanAVX2<Interp>(span); return;
+    case PCM_SSE2: renderSpanSSE2<Interp>(span); return;
+#endif
+    default: renderSpanScalar<Interp>(span, span.begin); return;
+  }
+}
+
+// Frames [begin, end) read through the reader, with taps past either end of
+// the sample clamped to the edge frame. Used where the taps aren't contiguous
+// in memory: the sample's edges, and the seam between head and stream.
+template <class Interp>
+inline void renderReader(const SampleReader& reader, int length, const PCMSpan& span)
+{
+  for (int i = span.begin; i < span.end; i++)
+  {
+    uint64_t phase = span.phase + uint64_t(i) * span.increment;
+    int index = int(phase >> 32);
+
+    float w[Interp::TAPS];
+    Interp::weights(phaseFraction(uint32_t(phase)), w);
+
+    float sum = 0;
+    for (int k = 0; k < Interp::TAPS; k++)
+    {
+      int at = index - Interp::BEFORE + k;
+      at = at < 0 ? 0 : (at >= length ? length - 1 : at);
+      sum += w[k] * float(reader.at(at));
+    }
+
+    float s1 = sum * PCM_SCALE * span.env[i];
+    span.outLeft[i] += s1 * (span.left + float(i) * span.leftStep);
+    span.outRight[i] += s1 * (span.right + float(i) * span.rightStep);
+  }
+}
+
+// First frame of the block, counting from 0, whose index reaches `index`;
+// INT_MAX if the play head never gets there
+inline int64_t firstFrameAt(const PCMSpan& span, int64_t index)
+{
+  int64_t target = index * (int64_t(1) << 32);
+  if (target <= int64_t(span.phase))
+  {
+    return 0;
+  }
+  if (span.increment == 0)
+  {
+    return INT_MAX;
+  }
+  return (uint64_t(target) - span.phase + span.increment - 1) / span.increment;
+}
+
+template <class Interp>
+inline void renderFrames(const SampleReader& reader, int length, PCMSpan& span)
+{
+  // AVX2 reads taps in pairs, so an odd tap count needs one more frame
+  const int reach = (Interp::TAPS + 1) & ~1;
+  int end = span.end;
+
+  // Leading frames whose first tap is before the sample start, then the run
+  // whose taps all fall inside it
+  int inner = int(std::min<int64_t>(std::max<int64_t>(firstFrameAt(span, Interp::BEFORE), span.begin), end));
+  int last = int(std::min<int64_t>(firstFrameAt(span, int64_t(length) + Interp::BEFORE - reach + 1), end));
+
+  if (inner < last)
+  {
+    span.first = int((span.phase + uint64_t(inner) * span.increment) >> 32) - Interp::BEFORE;
+    int count = int((span.phase + uint64_t(last - 1) * span.increment) >> 32) - Interp::BEFORE + reach - span.first;
+    span.frames = reader.span(span.first, count);
+  }
+
+  if (inner < last && span.frames)
+  {
+    span.end = inner;
+    renderReader<Interp>(reader, length, span);
+    span.begin = inner;
+    span.end = last;
+    renderSpan<Interp>(span);
+    span.begin = last;
+    span.end = end;
+  }
+
+  renderReader<Interp>(reader, length, span);
+}
+
+// Render up to `frames` frames of one voice with the given Interpolation,
+// adding into `left` and `right`. `env` holds the voice's envelope for each
+// frame; `leftGain` and `rightGain` carry amplitude and pan together. Returns
+// the number of frames rendered, which is short of `frames` only when the
+// sample ran out.
+inline int renderPCM(const SampleReader& reader, int length, PlayHead& head, int interpolation,
+                     const float* env, ParamRamp& leftGain, ParamRamp& rightGain,
+                     float* left, float* right, int frames)
+{
+  PCMSpan span;
+  span.frames = nullptr;
+  span.first = 0;
+  span.phase = head.phase;
+  span.increment = head.increment;
+  span.env = env;
+  span.left = leftGain.value;
+  span.leftStep = leftGain.step;
+  span.right = rightGain.value;
+  span.rightStep = rightGain.step;
+  span.outLeft = left;
+  span.outRight = right;
+  span.begin = 0;
+  span.end = int(std::min<int64_t>(firstFrameAt(span, length), frames));
+
+  int playable = span.end;
+
+  switch (interpolation)
+  {
+    case INTERP_NONE: renderFrames<InterpNone>(reader, length, span); break;
+    case INTERP_HERMITE: renderFrames<InterpHermite>(reader, length, span); break;
+    case INTERP_LAGRANGE: renderFrames<InterpLagrange>(reader, length, span); break;
+    case INTERP_SINC: renderFrames<InterpSinc>(reader, length, span); break;
+    default: renderFrames<InterpLinear>(reader, length, span); break;
+  }
+
+  head.phase += uint64_t(playable) * head.increment;
+  leftGain.advance(playable);
+  rightGain.advance(playable);
+  return playable;
+}
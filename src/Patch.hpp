@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Sample.hpp"
+
+// Precomputed result of a note-on lookup: which zone plays and how fast
+struct KeyZone
+{
+  Sample* sample = nullptr;
+  float rate = 1; // playback rate for the integer key, before any fractional tuning
+};
+
+// A playable sound: a set of sample zones and a rule for picking one. Each
+// patch builds a keymap at construction so note-on is a single table read.
+// A patch owns its zones; their buffers are shared through SampleCache.
+struct Patch
+{
+  std::vector<Sample*> samples;
+  std::vector<KeyZone> keymap;
+
+  Patch() {}
+  Patch(const Patch&) = delete;
+  Patch& operator=(const Patch&) = delete;
+
+  virtual ~Patch()
+  {
+    for (Sample* sample : samples)
+    {
+      delete sample;
+    }
+  }
+
+  // Zone and rate for a (possibly fractional) key
+  KeyZone zone(float key) const
+  {
+    if (keymap.empty())
+    {
+      return KeyZone();
+    }
+
+    int index = static_cast<int>(floor(key));
+    float fraction = key - index;
+    index = index < 0 ? 0 : (index >= int(keymap.size()) ? int(keymap.size()) - 1 : index);
+
+    KeyZone result = keymap[index];
+    if (fraction != 0 && keyIsPitch())
+    {
+      result.rate *= exp2f(fraction / 12.f);
+    }
+    return result;
+  }
+
+  Sample* getSample(int index) { return zone(index).sample; }
+
+  // Whether keys are MIDI notes (timbres) or sample indices (drum kits)
+  virtual bool keyIsPitch() const { return true; }
+
+protected:
+  static float pitchRate(float note, int pitch_root)
+  {
+    return exp2f((note - pitch_root) / 12.f);
+  }
+};
+
+struct DrumKit : Patch
+{
+  std::map<std::string, int> sampleIndex;
+
+  // Kit over existing zones, named by their keys in `names`
+  DrumKit(std::vector<Sample*> zones, std::vector<std::string> names)
+  {
+    samples = zones;
+    for (size_t i = 0; i < names.size(); i++)
+    {
+      if (!names[i].empty())
+      {
+        sampleIndex[names[i]] = int(i);
+      }
+    }
+
+    buildKeymap();
+  }
+
+  DrumKit(std::string directory, std::vector<std::string> filenames, std::map<std::string, int> rootPitches)
+  {
+    for (size_t i = 0; i < filenames.size(); i++)
+    {
+      int pitchAdjust = 0;
+
+      if (rootPitches.count(filenames[i]))
+      {
+        pitchAdjust = rootPitches[filenames[i]];
+      }
+
+      samples.push_back(
+        new Sample(
+          "timbre/" + directory + "/" + filenames[i] + ".wav",
+          0 - pitchAdjust,
+          0
+        )
+      );
+
+      sampleIndex[filenames[i]] = int(i);
+    }
+
+    buildKeymap();
+  }
+
+  // Resolve a sample name to its key; do this once when building patterns
+  int s(std::string sampleName) {
+    return sampleIndex[sampleName];
+  }
+
+  bool keyIsPitch() const override { return false; }
+
+private:
+  // One entry per sample, each played at its root-pitch correction
+  void buildKeymap()
+  {
+    keymap.resize(samples.size());
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+      keymap[i].sample = samples[i];
+      keymap[i].rate = pitchRate(0, samples[i]->pitch_root);
+    }
+  }
+};
+
+struct Timbre : Patch
+{
+  static const int KEYS = 128;
+
+  // Timbre over existing zones, ordered by pitch_highest
+  explicit Timbre(std::vector<Sample*> zones)
+  {
+    samples = zones;
+    buildKeymap();
+  }
+
+  Timbre(std::string name, std::vector<int> pitches, int correct=0)
+  {
+    for (size_t i = 0; i < pitches.size(); i++)
+    {
+      int pitch = pitches[i];
+      int nextPitch;
+
+      if (i + 1 < pitches.size())
+      {
+        nextPitch = pitches[i + 1];
+      }
+      else
+      {
+        nextPitch = 127;
+      }
+
+      samples.push_back(
+        new Sample(
+          "timbre/" + name + "/" + std::to_string(pitch) + ".wav",
+          pitch - correct,
+          nextPitch - 1 - correct
+        )
+      );
+    }
+
+    buildKeymap();
+  }
+
+private:
+  // For every MIDI note, the first zone whose range reaches it
+  void buildKeymap()
+  {
+    if (samples.empty())
+    {
+      return;
+    }
+
+    keymap.resize(KEYS);
+    for (int note = 0; note < KEYS; note++)
+    {
+      Sample* chosen = samples[0]; // Fallback to single sample
+
+      for (size_t i = 0; i < samples.size(); i++)
+      {
+        if (note <= samples[i]->pitch_highest)
+        {
+          chosen = samples[i];
+          break;
+        }
+      }
+
+      keymap[note].sample = chosen;
+      keymap[note].rate = pitchRate(note, chosen->pitch_root);
+    }
+  }
+};
@@ -0,0 +1,386 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "Interpolator.hpp"
+
+// One note: what seq->add<PCMEnv>(start, duration).set(...) took, or one
+// line of a .synthSequence file
+struct PatternEvent
+{
+  double start = 0;   // seconds from the start of the song; a float drifts off its frame within minutes
+  float duration = 0; // seconds until the note-off
+  float note = 0;     // MIDI note, or the sample index for a drum kit
+  float amplitude = 0;
+  float attack = 0.001f; // seconds; PCMEnv's default
+  float release = 0;     // seconds
+  float pan = 0;
+  uint8_t timbre = 0; // index into SoundBank
+  uint8_t interpolate = 0;
+  uint8_t track = 0;
+  uint8_t reserved = 0;
+};
+
+static_assert(std::is_trivially_copyable<PatternEvent>::value, "PatternEvent is copied as raw bytes");
+static_assert(sizeof(PatternEvent) == 40, "PatternEvent should stay small");
+
+// The n/d/c/r sequencing vocabulary and its settings (track, timbre, volume,
+// ...), which are plain members set between calls as the old globals were.
+// Lengths and gaps are in steps, STEPS_PER_SECOND to a second. Each note is
+// handed to Events::push(); Pattern below stores them in a fixed array at
+// compile time and PatternBuffer in a vector at runtime.
+template <class Events>
+class PatternWriter
+{
+public:
+  static constexpr float STEPS_PER_SECOND = 8;
+  static constexpr int NOTE_OFFSET = 12; // n() plays an octave above the written note
+  static constexpr float GAIN = 1.375f;  // applied to volume * strength
+  static const int TRACKS = 16;
+
+  // Settings
+  int track = 0;
+  int timbre = 0;
+  int transpose = 0;
+  float release = 0;
+  float volume = 1;
+  float strength = 1;
+  float tune = 0;
+  int interpolate = INTERP_NONE;
+  int drumTimbre = 21; // what d() plays
+
+  double cursors[TRACKS] = {}; // insert position of each track, in seconds
+
+  constexpr PatternWriter() {}
+
+  // A note `length` steps long; the track moves on by length + gap
+  constexpr void n(float note, float length = 1, float gap = 0)
+  {
+    add(cursors[track], length / STEPS_PER_SECOND, note + NOTE_OFFSET + transpose + tune, timbre, interpolate,
+        release);
+    cursors[track] += (length + gap) / STEPS_PER_SECOND;
+  }
+
+  // A drum hit left to ring for `length` steps; the track moves on by gap
+  constexpr void d(int sample, float gap = 0, float length = 64)
+  {
+    add(cursors[track], length / STEPS_PER_SECOND, sample, drumTimbre, INTERP_LINEAR, 0.001f);
+    cursors[track] += gap / STEPS_PER_SECOND;
+  }
+
+  // A chord tone: the track only moves on by gap
+  constexpr void c(float note, float length = 16, float gap = 0) { n(note, length, gap - length); }
+
+  // A rest
+  constexpr void r(float length) { cursors[track] += length / STEPS_PER_SECOND; }
+
+  constexpr void reset()
+  {
+    interpolate = INTERP_LINEAR;
+    volume = 1;
+    transpose = 0;
+    tune = 0;
+    release = 0.001f;
+  }
+
+private:
+  constexpr void add(double start, float duration, float note, int timbre, int interpolate, float release)
+  {
+    PatternEvent e;
+    e.start = start;
+    e.duration = duration;
+    e.note = note;
+    e.amplitude = volume * strength * GAIN;
+    e.release = release;
+    e.timbre = uint8_t(timbre);
+    e.interpolate = uint8_t(interpolate);
+    e.track = uint8_t(track);
+    static_cast<Events&>(*this).push(e);
+  }
+};
+
+template <class Events> constexpr float PatternWriter<Events>::STEPS_PER_SECOND;
+template <class Events> constexpr int PatternWriter<Events>::NOTE_OFFSET;
+template <class Events> constexpr float PatternWriter<Events>::GAIN;
+
+// Patterns evaluated at compile time into a flat array of up to N events
+// sorted by start, sized exactly by a PatternCount pass first:
+//
+//   template <class P> constexpr void pt_bass(P& p) { p.n(26, 1, 1); ... }
+//   constexpr int SONG_EVENTS = song<PatternCount>().count;
+//   constexpr Pattern<SONG_EVENTS> SONG = song<Pattern<SONG_EVENTS>>();
+//
+// Overflowing N in a constant expression is a compile error. Compilers cap
+// the work of one constant expression (clang's -fconstexpr-steps and GCC's
+// -fconstexpr-ops-limit); the build holds GCC to clang's default of
+// 1048576, and compiling the bundled song takes under 400000 of them.
+template <int N>
+class Pattern : public PatternWriter<Pattern<N>>
+{
+public:
+  PatternEvent events[N > 0 ? N : 1] = {};
+  int count = 0;
+
+  constexpr Pattern() {}
+
+  constexpr void push(const PatternEvent& e)
+  {
+    if (count >= N)
+    {
+      throw "Pattern capacity exceeded"; // only reachable in a constant expression as an error
+    }
+    events[count++] = e;
+  }
+
+  // Sort by start once everything is added; equal starts keep their order.
+  // A natural merge sort: each track is written in order, so the array is a
+  // few ascending runs and a handful of passes merge them, where an
+  // insertion sort's n^2 copies would run past the constant evaluation limit
+  constexpr void finish()
+  {
+    // Where each run starts, then the end of the last
+    int bounds[N + 1] = {};
+    int runs = 0;
+    for (int i = 1; i < count; i++)
+    {
+      if (events[i - 1].start > events[i].start)
+      {
+        bounds[++runs] = i;
+      }
+    }
+    bounds[++runs] = count;
+
+    PatternEvent scratch[N > 0 ? N : 1] = {};
+    PatternEvent* from = events;
+    PatternEvent* to = scratch;
+    bool inScratch = false;
+
+    // Merge neighbouring runs in pairs until one is left
+    while (runs > 1)
+    {
+      int merged = 0;
+      for (int r = 0; r < runs; r += 2)
+      {
+        int left = bounds[r], mid = bounds[r + 1];
+        int right = r + 2 <= runs ? bounds[r + 2] : mid;
+        int i = left, j = mid, k = left;
+        while (i < mid && j < right)
+        {
+          // Ties take from the left run, which keeps equal starts in order
+          to[k++] = from[j].start < from[i].start ? from[j++] : from[i++];
+        }
+        while (i < mid)
+        {
+          to[k++] = from[i++];
+        }
+        while (j < right)
+        {
+          to[k++] = from[j++];
+        }
+        bounds[merged++] = left;
+      }
+      bounds[merged] = count;
+      runs = merged;
+
+      PatternEvent* swap = to;
+      to = from;
+      from = swap;
+      inScratch = !inScratch;
+    }
+
+    for (int i = 0; inScratch && i < count; i++)
+    {
+      events[i] = scratch[i];
+    }
+  }
+
+  constexpr const PatternEvent* begin() const { return events; }
+  constexpr const PatternEvent* end() const { return events + count; }
+};
+
+// Counts the events a pattern pushes, so its Pattern<N> can be sized
+// exactly without first filling a larger array
+class PatternCount : public PatternWriter<PatternCount>
+{
+public:
+  int count = 0;
+
+  constexpr PatternCount() {}
+
+  constexpr void push(const PatternEvent&) { count++; }
+
+  constexpr void finish() {}
+};
+
+// Events gathered at runtime, from text patterns (PatternText.hpp) or whole
+// files (SequenceFile.hpp): append them all, then sort once with finish()
+class PatternBuffer : public PatternWriter<PatternBuffer>
+{
+public:
+  std::vector<PatternEvent> events;
+
+  void push(const PatternEvent& e) { events.push_back(e); }
+
+  // Sort by start; equal starts keep their order, as Pattern::finish does
+  void finish()
+  {
+    std::stable_sort(events.begin(), events.end(),
+                     [](const PatternEvent& a, const PatternEvent& b) { return a.start < b.start; });
+  }
+
+  const PatternEvent* begin() const { return events.data(); }
+  const PatternEvent* end() const { return events.data() + events.size(); }
+};
+
+// Plays a compiled pattern in step with the audio callback. advance() walks
+// the sorted array from where the last block stopped and hands each note-on
+// and note-off in the block to the caller with its frame offset; pending
+// note-offs sit in a fixed array, so nothing allocates. The id passed to
+// both is unique per note and starts at FIRST_ID, above the MIDI note
+// numbers the keyboard uses as ids, so the two never release each other's notes.
+//
+// Another thread can cue() a new array while it plays; the player switches
+// to it at the next bar line, picking it up at that time, and lets notes
+// already sounding finish.
+class PatternPlayer
+{
+public:
+  static const int MAX_PENDING = 256; // notes sounding at once before new ones are dropped
+  static const int FIRST_ID = 128;    // ids 0-127 are the keyboard's MIDI notes
+
+  double barSeconds = 2; // cued arrays start on multiples of this (16 steps)
+
+  long dropped = 0; // note-ons skipped because MAX_PENDING notes were still held
+  std::atomic<long> swaps{0};
+  std::atomic<int64_t> swappedAt{-1}; // frame of the last swap
+
+  // Before audio starts
+  void play(const PatternEvent* first, const PatternEvent* last, double rate)
+  {
+    events = first;
+    count = int(last - first);
+    framesPerSecond = rate;
+    next = 0;
+    idBase = FIRST_ID;
+    pendingCount = 0;
+    now = 0;
+  }
+
+  bool done() const { return next >= count && pendingCount == 0 && !cuePending(); }
+
+  // From any thread: play [first, last) from the next bar line. Fails while
+  // an earlier cue is still pending; once cuePending() turns false the
+  // player no longer reads the array it was playing before.
+  bool cue(const PatternEvent* first, const PatternEvent* last)
+  {
+    if (cuePending())
+    {
+      return false;
+    }
+    cueFirst = first;
+    cueLast = last;
+    cued.store(true, std::memory_order_release);
+    return true;
+  }
+
+  bool cuePending() const { return cued.load(std::memory_order_acquire); }
+
+  // From inside on(): frames from the note's first frame (its offset in the
+  // block) to its note-off, so the voice can release on that exact frame
+  int holdFrames(const PatternEvent& e, int offset) const
+  {
+    int64_t frames = frameOf(e.start + e.duration) - (now + offset);
+    return int(std::min(std::max(frames, int64_t(0)), int64_t(INT32_MAX)));
+  }
+
+  // on(event, id, offset) and off(id, offset) for everything in the next `frames`
+  template <typename On, typename Off>
+  void advance(int frames, On on, Off off)
+  {
+    int64_t blockEnd = now + frames;
+
+    for (int i = 0; i < pendingCount;)
+    {
+      if (pending[i].end < blockEnd)
+      {
+        off(pending[i].id, int(std::max(pending[i].end - now, int64_t(0))));
+        pending[i] = pending[--pendingCount];
+      }
+      else
+      {
+        i++;
+      }
+    }
+
+    if (cuePending())
+    {
+      int64_t bar = std::max(int64_t(barSeconds * framesPerSecond + 0.5), int64_t(1));
+      int64_t line = (now + bar - 1) / bar * bar;
+      if (line < blockEnd)
+      {
+        startUntil(line, on);
+        idBase += count;
+        events = cueFirst;
+        count = int(cueLast - cueFirst);
+        next = int(std::lower_bound(events, events + count, line, [this](const PatternEvent& e, int64_t frame) {
+                     return frameOf(e.start) < frame;
+                   }) -
+                   events);
+        cued.store(false, std::memory_order_release);
+        swappedAt.store(line, std::memory_order_relaxed);
+        swaps.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    startUntil(blockEnd, on);
+    now = blockEnd;
+  }
+
+private:
+  struct Pending
+  {
+    int64_t end; // frame of the note-off
+    int id;
+  };
+
+  const PatternEvent* events = nullptr;
+  int count = 0;
+  int next = 0;
+  int idBase = FIRST_ID; // grows by each array's length, so ids stay unique across cues
+  double framesPerSecond = 48000;
+  int64_t now = 0; // frame at the start of the next block
+  Pending pending[MAX_PENDING];
+  int pendingCount = 0;
+
+  std::atomic<bool> cued{false};
+  const PatternEvent* cueFirst = nullptr;
+  const PatternEvent* cueLast = nullptr;
+
+  int64_t frameOf(double seconds) const { return int64_t(seconds * framesPerSecond + 0.5); }
+
+  // Note-ons from the play position up to frame `limit`
+  template <typename On>
+  void startUntil(int64_t limit, On& on)
+  {
+    for (; next < count; next++)
+    {
+      const PatternEvent& e = events[next];
+      int64_t start = frameOf(e.start);
+      if (start >= limit)
+      {
+        break;
+      }
+      if (pendingCount == MAX_PENDING)
+      {
+        dropped++;
+        continue;
+      }
+      on(e, idBase + next, int(std::max(start - now, int64_t(0))));
+      pending[pendingCount++] = {frameOf(e.start + e.duration), idBase + next};
+    }
+  }
+};
@@ -0,0 +1,750 @@
+#pragma once
+
+#include <glob.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Logger.hpp"
+#include "Pattern.hpp"
+
+// The text form of Pattern's vocabulary. A file holds any number of
+//
+//   pattern NAME
+//     STATEMENT...
+//
+// blocks, with one statement per line or several separated by `;`, and `#`
+// starting a comment:
+//
+//   n NOTE [LENGTH [GAP]]    c NOTE [LENGTH [GAP]]    d DRUM [GAP [LENGTH]]
+//   r LENGTH    reset    play NAME    repeat COUNT ... end
+//   track | timbre | transpose | volume | strength | tune | release | interpolate VALUE
+//
+// Arguments are numbers, names given to define() (or none, linear, hermite,
+// lagrange, sinc) and + - * / expressions of them, written without spaces
+// unless in parentheses: `r 16*3`, `n 28 8 (9 + 16*3)`. `play` runs another
+// pattern with the current settings, as calling pt_bass() from C++ did.
+//
+// load() parses one file into a list of ops per pattern and replaces only
+// the patterns that file defines; link() runs the ops from an entry pattern
+// into a PatternBuffer. Neither is for the audio thread.
+class PatternLibrary
+{
+public:
+  static const int MAX_DEPTH = 32; // nested plays before link() gives up on a cycle
+
+  PatternLibrary()
+  {
+    static const char* INTERPOLATIONS[] = {"none", "linear", "hermite", "lagrange", "sinc"};
+    for (int i = 0; i < INTERP_COUNT; i++)
+    {
+      define(INTERPOLATIONS[i], i);
+    }
+  }
+
+  // A name arguments can use, e.g. a drum sample or TRIPLET
+  void define(const std::string& name, float value) { constants[name] = value; }
+
+  // Parse `text` as the contents of `file`; on an error nothing changes
+  bool load(const std::string& file, const std::string& text, std::string& error)
+  {
+    std::vector<Body> parsed;
+    if (!parse(file, text, parsed, error))
+    {
+      return false;
+    }
+
+    for (Body& body : parsed)
+    {
+      Definition& definition = definitions[body.pattern];
+      if (definition.defined && definition.file != file)
+      {
+        error = file + ": pattern " + names[body.pattern] + " is already defined in " + definition.file;
+        return false;
+      }
+    }
+
+    remove(file);
+    for (Body& body : parsed)
+    {
+      Definition& definition = definitions[body.pattern];
+      definition.ops.swap(body.ops);
+      definition.file = file;
+      definition.defined = true;
+    }
+    return true;
+  }
+
+  // Forget the patterns `file` defined
+  void remove(const std::string& file)
+  {
+    for (Definition& definition : definitions)
+    {
+      if (definition.defined && definition.file == file)
+      {
+        definition.defined = false;
+        definition.ops.clear();
+      }
+    }
+  }
+
+  bool defines(const std::string& pattern) const
+  {
+    auto found = ids.find(pattern);
+    return found != ids.end() && definitions[found->second].defined;
+  }
+
+  // Run `entry` into `out` (emptied first) and sort it
+  bool link(const std::string& entry, PatternBuffer& out, std::string& error)
+  {
+    out = PatternBuffer();
+    if (!defines(entry))
+    {
+      error = "no pattern named " + entry;
+      return false;
+    }
+
+    int pattern = ids[entry];
+    bool ok = run(pattern, 0, int(definitions[pattern].ops.size()), 0, out, error);
+    out.finish();
+    return ok;
+  }
+
+private:
+  enum Code : uint8_t
+  {
+    OP_NOTE,
+    OP_CHORD,
+    OP_DRUM,
+    OP_REST,
+    OP_RESET,
+    OP_TRACK,
+    OP_TIMBRE,
+    OP_TRANSPOSE,
+    OP_VOLUME,
+    OP_STRENGTH,
+    OP_TUNE,
+    OP_RELEASE,
+    OP_INTERPOLATE,
+    OP_PLAY,
+    OP_REPEAT,
+    OP_END,
+  };
+
+  struct Op
+  {
+    Code code;
+    int target; // pattern for OP_PLAY; for OP_REPEAT, the index of its OP_END
+    float args[3];
+  };
+
+  struct Keyword
+  {
+    const char* word;
+    Code code;
+    int minArgs, maxArgs;
+    float defaults[3];
+  };
+
+  struct Definition
+  {
+    std::vector<Op> ops;
+    std::string file;
+    bool defined = false;
+  };
+
+  struct Body
+  {
+    int pattern;
+    std::vector<Op> ops;
+  };
+
+  // A token in the text being parsed
+  struct Word
+  {
+    const char* begin;
+    const char* end;
+
+    bool is(const char* text) const
+    {
+      size_t length = strlen(text);
+      return size_t(end - begin) == length && strncmp(begin, text, length) == 0;
+    }
+
+    std::string str() const { return std::string(begin, end); }
+  };
+
+  std::map<std::string, float> constants;
+  std::map<std::string, int> ids;
+  std::vector<std::string> names;
+  std::vector<Definition> definitions; // by id
+
+  static const Keyword* keyword(const Word& word)
+  {
+    static const Keyword KEYWORDS[] = {
+      {"n", OP_NOTE, 1, 3, {0, 1, 0}},
+      {"c", OP_CHORD, 1, 3, {0, 16, 0}},
+      {"d", OP_DRUM, 1, 3, {0, 0, 64}},
+      {"r", OP_REST, 1, 1, {0}},
+      {"reset", OP_RESET, 0, 0, {0}},
+      {"track", OP_TRACK, 1, 1, {0}},
+      {"timbre", OP_TIMBRE, 1, 1, {0}},
+      {"transpose", OP_TRANSPOSE, 1, 1, {0}},
+      {"volume", OP_VOLUME, 1, 1, {0}},
+      {"strength", OP_STRENGTH, 1, 1, {0}},
+      {"tune", OP_TUNE, 1, 1, {0}},
+      {"release", OP_RELEASE, 1, 1, {0}},
+      {"interpolate", OP_INTERPOLATE, 1, 1, {0}},
+      {"play", OP_PLAY, 1, 1, {0}},
+      {"repeat", OP_REPEAT, 1, 1, {0}},
+      {"end", OP_END, 0, 0, {0}},
+    };
+    for (const Keyword& k : KEYWORDS)
+    {
+      if (word.is(k.word))
+      {
+        return &k;
+      }
+    }
+    return nullptr;
+  }
+
+  int intern(const std::string& name)
+  {
+    auto found = ids.find(name);
+    if (found != ids.end())
+    {
+      return found->second;
+    }
+    ids[name] = int(names.size());
+    names.push_back(name);
+    definitions.emplace_back();
+    return int(names.size()) - 1;
+  }
+
+  // The words of the statement at `at`, which is left at the next one;
+  // `first` is the line the statement starts on
+  static bool statement(const char*& at, int& line, int& first, std::vector<Word>& words, std::string& error)
+  {
+    words.clear();
+    for (;;)
+    {
+      while (*at == ' ' || *at == '\t' || *at == '\r')
+      {
+        at++;
+      }
+      if (*at == '#')
+      {
+        while (*at && *at != '\n')
+        {
+          at++;
+        }
+      }
+      if (*at == '\0')
+      {
+        return true;
+      }
+      if (*at == '\n' || *at == ';')
+      {
+        line += *at == '\n';
+        at++;
+        if (!words.empty())
+        {
+          return true;
+        }
+        continue;
+      }
+
+      if (words.empty())
+      {
+        first = line;
+      }
+      Word word{at, at};
+      if (*at == '(')
+      {
+        int depth = 0;
+        do
+        {
+          depth += (*at == '(') - (*at == ')');
+          if (*at == '\n' || *at == '\0')
+          {
+            error = "unclosed (";
+            return false;
+          }
+          at++;
+        } while (depth > 0);
+      }
+      else
+      {
+        while (*at && !strchr(" \t\r\n;#", *at))
+        {
+          at++;
+        }
+      }
+      word.end = at;
+      words.push_back(word);
+    }
+  }
+
+  // Expression grammar: sum = product {+|- product}, product = unary {*|/ unary},
+  // unary = [-] atom, atom = number | name | ( sum )
+  struct Expression
+  {
+    const char* at;
+    const char* end;
+    const std::map<std::string, float>& constants;
+    std::string error;
+
+    float sum()
+    {
+      float value = product();
+      while (at < end && (*at == '+' || *at == '-'))
+      {
+        char op = *at++;
+        float right = product();
+        value = op == '+' ? value + right : value - right;
+      }
+      return value;
+    }
+
+    float product()
+    {
+      float value = unary();
+      while (at < end && (*at == '*' || *at == '/'))
+      {
+        char op = *at++;
+        float right = unary();
+        value = op == '*' ? value * right : value / right;
+      }
+      return value;
+    }
+
+    float unary()
+    {
+      skip();
+      if (at < end && *at == '-')
+      {
+        at++;
+        return -unary();
+      }
+      return atom();
+    }
+
+    float atom()
+    {
+      skip();
+      float value = 0;
+      if (at < end && *at == '(')
+      {
+        at++;
+        value = sum();
+        skip();
+        if (at >= end || *at != ')')
+        {
+          fail("missing )");
+        }
+        at++;
+      }
+      else if (at < end && (isdigit(*at) || *at == '.'))
+      {
+        char* stop;
+        value = strtof(at, &stop);
+        at = std::min<const char*>(stop, end);
+      }
+      else if (at < end && (isalpha(*at) || *at == '_'))
+      {
+        const char* start = at;
+        while (at < end && (isalnum(*at) || *at == '_'))
+        {
+          at++;
+        }
+        auto found = constants.find(std::string(start, at));
+        if (found == constants.end())
+        {
+          fail("unknown name " + std::string(start, at));
+        }
+        else
+        {
+          value = found->second;
+        }
+      }
+      else
+      {
+        fail("expected a number");
+      }
+      skip();
+      return value;
+    }
+
+    void skip()
+    {
+      while (at < end && (*at == ' ' || *at == '\t'))
+      {
+        at++;
+      }
+    }
+
+    void fail(const std::string& message)
+    {
+      if (error.empty())
+      {
+        error = message;
+      }
+      at = end;
+    }
+  };
+
+  bool evaluate(const Word& word, float& value, std::string& error) const
+  {
+    Expression expression{word.begin, word.end, constants, ""};
+    value = expression.sum();
+    if (expression.error.empty() && expression.at != word.end)
+    {
+      expression.error = "unexpected " + std::string(expression.at, word.end);
+    }
+    error = expression.error;
+    return error.empty();
+  }
+
+  bool parse(const std::string& file, const std::string& text, std::vector<Body>& out, std::string& error)
+  {
+    const char* at = text.c_str();
+    int line = 1;
+    std::vector<Word> words;
+    std::vector<int> repeats; // open repeat ops in the current pattern
+    Body* body = nullptr;
+
+    int first = line;
+    auto fail = [&](const std::string& message) {
+      error = file + ":" + std::to_string(first) + ": " + message;
+      return false;
+    };
+
+    while (*at)
+    {
+      if (!statement(at, line, first, words, error))
+      {
+        return fail(error);
+      }
+      if (words.empty())
+      {
+        continue;
+      }
+      const Word& word = words[0];
+      int args = int(words.size()) - 1;
+
+      if (word.is("pattern"))
+      {
+        if (args != 1)
+        {
+          return fail("pattern takes a name");
+        }
+        if (!repeats.empty())
+        {
+          return fail("repeat without end");
+        }
+        out.push_back({intern(words[1].str()), {}});
+        body = &out.back();
+        for (size_t i = 0; i + 1 < out.size(); i++)
+        {
+          if (out[i].pattern == body->pattern)
+          {
+            return fail("pattern " + words[1].str() + " is defined twice");
+          }
+        }
+        continue;
+      }
+
+      const Keyword* k = keyword(word);
+      if (!k)
+      {
+        return fail("unknown statement " + word.str());
+      }
+      if (!body)
+      {
+        return fail("statement before the first pattern");
+      }
+      if (args < k->minArgs || args > k->maxArgs)
+      {
+        return fail(word.str() + " takes " + std::to_string(k->minArgs) +
+                    (k->maxArgs > k->minArgs ? " to " + std::to_string(k->maxArgs) : std::string()) + " arguments");
+      }
+
+      Op op{k->code, -1, {k->defaults[0], k->defaults[1], k->defaults[2]}};
+      if (k->code == OP_PLAY)
+      {
+        op.target = intern(words[1].str());
+      }
+      else
+      {
+        for (int i = 0; i < args; i++)
+        {
+          std::string problem;
+          if (!evaluate(words[i + 1], op.args[i], problem))
+          {
+            return fail(problem);
+          }
+        }
+      }
+
+      if (k->code == OP_REPEAT)
+      {
+        repeats.push_back(int(body->ops.size()));
+      }
+      else if (k->code == OP_END)
+      {
+        if (repeats.empty())
+        {
+          return fail("end without repeat");
+        }
+        body->ops[repeats.back()].target = int(body->ops.size());
+        repeats.pop_back();
+      }
+      body->ops.push_back(op);
+    }
+
+    if (!repeats.empty())
+    {
+      return fail("repeat without end");
+    }
+    return true;
+  }
+
+  // Ops [from, to) of `pattern`
+  bool run(int pattern, int from, int to, int depth, PatternBuffer& out, std::string& error)
+  {
+    const std::vector<Op>& ops = definitions[pattern].ops;
+    for (int i = from; i < to; i++)
+    {
+      const Op& op = ops[i];
+      const float* a = op.args;
+      switch (op.code)
+      {
+      case OP_NOTE: out.n(a[0], a[1], a[2]); break;
+      case OP_CHORD: out.c(a[0], a[1], a[2]); break;
+      case OP_DRUM: out.d(int(a[0]), a[1], a[2]); break;
+      case OP_REST: out.r(a[0]); break;
+      case OP_RESET: out.reset(); break;
+      case OP_TIMBRE: out.timbre = int(a[0]); break;
+      case OP_TRANSPOSE: out.transpose = int(a[0]); break;
+      case OP_VOLUME: out.volume = a[0]; break;
+      case OP_STRENGTH: out.strength = a[0]; break;
+      case OP_TUNE: out.tune = a[0]; break;
+      case OP_RELEASE: out.release = a[0]; break;
+      case OP_INTERPOLATE: out.interpolate = int(a[0]); break;
+      case OP_END: break;
+
+      case OP_TRACK:
+        if (a[0] < 0 || a[0] >= PatternBuffer::TRACKS)
+        {
+          error = names[pattern] + ": track " + std::to_string(int(a[0])) + " is out of range";
+          return false;
+        }
+        out.track = int(a[0]);
+        break;
+
+      case OP_PLAY:
+        if (!definitions[op.target].defined)
+        {
+          error = names[pattern] + ": no pattern named " + names[op.target];
+          return false;
+        }
+        if (depth >= MAX_DEPTH)
+        {
+          error = names[pattern] + ": plays nest too deep (a pattern plays itself?)";
+          return false;
+        }
+        if (!run(op.target, 0, int(definitions[op.target].ops.size()), depth + 1, out, error))
+        {
+          return false;
+        }
+        break;
+
+      case OP_REPEAT:
+        for (int n = 0; n < int(a[0]); n++)
+        {
+          if (!run(pattern, i + 1, op.target, depth, out, error))
+          {
+            return false;
+          }
+        }
+        i = op.target;
+        break;
+      }
+    }
+    return true;
+  }
+};
+
+// Keeps a PatternPlayer playing what DIR/*.pattern says. start() loads every
+// file and plays the linked entry pattern; then a thread rereads the files
+// every pollMs, reparses only the ones whose text changed, relinks and cues
+// the result for the player's next bar line. Files are small, so comparing
+// their text catches edits that one-second mtimes would miss. A file that
+// fails to parse or link is logged and the song keeps playing as it was.
+class PatternWatcher
+{
+public:
+  PatternLibrary library; // define() names before start()
+  std::string entry = "song";
+  int pollMs = 250;
+
+  std::atomic<long> reloads{0}; // edits cued to the player
+
+  ~PatternWatcher() { stop(); }
+
+  // Before audio starts
+  bool start(const std::string& directory, PatternPlayer& player, double rate)
+  {
+    this->directory = directory;
+    this->player = &player;
+
+    auto begin = std::chrono::steady_clock::now();
+    int files = scan();
+    auto parsed = std::chrono::steady_clock::now();
+    std::unique_ptr<PatternBuffer> song = relink();
+    auto linked = std::chrono::steady_clock::now();
+    if (!song)
+    {
+      return false;
+    }
+
+    PCM_LOG(LOG_INFO, "Patterns: ", files, " files in ", directory, " parsed in ", micros(begin, parsed), " us, ",
+            int(song->events.size()), " events linked in ", micros(parsed, linked), " us");
+
+    playing = std::move(song);
+    player.play(playing->begin(), playing->end(), rate);
+    running = true;
+    watcher = std::thread([this] {
+      while (running.load(std::memory_order_acquire))
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(pollMs));
+        poll();
+      }
+    });
+    return true;
+  }
+
+  void stop()
+  {
+    if (running.exchange(false))
+    {
+      watcher.join();
+    }
+  }
+
+private:
+  std::string directory;
+  PatternPlayer* player = nullptr;
+  std::map<std::string, std::string> texts; // what each file held when last read
+  std::unique_ptr<PatternBuffer> playing;   // what the player reads
+  std::unique_ptr<PatternBuffer> cued;      // handed to cue(), not yet taken
+  std::unique_ptr<PatternBuffer> waiting;   // linked while an earlier cue was pending
+  std::atomic<bool> running{false};
+  std::thread watcher;
+
+  static long micros(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+  {
+    return long(std::chrono::duration_cast<std::chrono::microseconds>(to - from).count());
+  }
+
+  void poll()
+  {
+    // The player has moved on to the cued song, so the old one can go
+    if (cued && !player->cuePending())
+    {
+      playing = std::move(cued);
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    if (scan() > 0)
+    {
+      auto parsed = std::chrono::steady_clock::now();
+      std::unique_ptr<PatternBuffer> song = relink();
+      if (song)
+      {
+        PCM_LOG(LOG_INFO, "Patterns reparsed in ", micros(begin, parsed), " us, ", int(song->events.size()),
+                " events relinked in ", micros(parsed, std::chrono::steady_clock::now()),
+                " us; playing from the next bar");
+        waiting = std::move(song);
+      }
+    }
+
+    if (waiting && !cued && player->cue(waiting->begin(), waiting->end()))
+    {
+      cued = std::move(waiting);
+      reloads++;
+    }
+  }
+
+  // Reload the files that changed, appeared or went away; returns how many
+  int scan()
+  {
+    glob_t matches;
+    glob((directory + "/*.pattern").c_str(), 0, nullptr, &matches);
+    std::vector<std::string> paths(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+    globfree(&matches);
+
+    int changed = 0;
+    for (const std::string& path : paths)
+    {
+      std::ifstream file(path);
+      std::stringstream text;
+      text << file.rdbuf();
+      auto known = texts.find(path);
+      if (!file || (known != texts.end() && known->second == text.str()))
+      {
+        continue;
+      }
+
+      texts[path] = text.str();
+      std::string error;
+      if (library.load(path, texts[path], error))
+      {
+        changed++;
+      }
+      else
+      {
+        PCM_LOG(LOG_ERROR, error);
+      }
+    }
+
+    for (auto known = texts.begin(); known != texts.end();)
+    {
+      if (std::find(paths.begin(), paths.end(), known->first) == paths.end())
+      {
+        library.remove(known->first);
+        known = texts.erase(known);
+        changed++;
+      }
+      else
+      {
+        ++known;
+      }
+    }
+    return changed;
+  }
+
+  std::unique_ptr<PatternBuffer> relink()
+  {
+    std::unique_ptr<PatternBuffer> song(new PatternBuffer());
+    std::string error;
+    if (!library.link(entry, *song, error))
+    {
+      PCM_LOG(LOG_ERROR, "Patterns: ", error);
+      return nullptr;
+    }
+    return song;
+  }
+};
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PCM_HAVE_SSE2 1
+#endif
+
+// Scale for converting stored 16-bit PCM frames to float in the render kernel
+const float PCM_SCALE = 1.f / 32768.f;
+
+// Bulk conversions used when a file is decoded into a mono int16 buffer.
+// Each walks the interleaved source once and writes the destination in order.
+
+inline int16_t clampToPcm16(float value)
+{
+  value = value * 32768.f;
+  value = value > 32767.f ? 32767.f : (value < -32768.f ? -32768.f : value);
+  return static_cast<int16_t>(lrintf(value));
+}
+
+// Interleaved 16-bit frames to mono: copy for mono, average for stereo, mean otherwise
+inline void downmixPcm16(const int16_t* in, int channels, int16_t* out, size_t frames)
+{
+  if (channels == 1)
+  {
+    memcpy(out, in, frames * sizeof(int16_t));
+    return;
+  }
+
+  size_t i = 0;
+
+  if (channels == 2)
+  {
+#ifdef PCM_HAVE_SSE2
+    // madd against ones sums each L/R pair into an int32 lane
+    const __m128i ones = _mm_set1_epi16(1);
+    for (; i + 8 <= frames; i += 8)
+    {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2 + 8));
+      __m128i sumA = _mm_srai_epi32(_mm_madd_epi16(a, ones), 1);
+      __m128i sumB = _mm_srai_epi32(_mm_madd_epi16(b, ones), 1);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(sumA, sumB));
+    }
+#endif
+    for (; i < frames; i++)
+    {
+      out[i] = static_cast<int16_t>((int32_t(in[i * 2]) + int32_t(in[i * 2 + 1])) >> 1);
+    }
+    return;
+  }
+
+  for (; i < frames; i++)
+  {
+    int32_t sum = 0;
+    for (int c = 0; c < channels; c++)
+    {
+      sum += in[i * channels + c];
+    }
+    out[i] = static_cast<int16_t>(sum / channels);
+  }
+}
+
+// Interleaved packed 24-bit little-endian frames to mono 16-bit
+inline void downmixPcm24(const uint8_t* in, int channels, int16_t* out, size_t frames)
+{
+  for (size_t i = 0; i < frames; i++)
+  {
+    int32_t sum = 0;
+    for (int c = 0; c < channels; c++)
+    {
+      const uint8_t* at = in + (i * channels + c) * 3;
+      sum += static_cast<int16_t>(at[1] | at[2] << 8); // top 16 bits
+    }
+    out[i] = static_cast<int16_t>(sum / channels);
+  }
+}
+
+// Interleaved 32-bit integer frames to mono 16-bit
+inline void downmixPcm32(const int32_t* in, int channels, int16_t* out, size_t frames)
+{
+  for (size_t i = 0; i < frames; i++)
+  {
+    int64_t sum = 0;
+    for (int c = 0; c < channels; c++)
+    {
+      int32_t value;
+      memcpy(&value, in + i * channels + c, sizeof(value));
+      sum += value >> 16;
+    }
+    out[i] = static_cast<int16_t>(sum / channels);
+  }
+}
+
+// Interleaved float frames in [-1, 1] to mono 16-bit, saturating
+inline void downmixFloat(const float* in, int channels, int16_t* out, size_t frames)
+{
+  size_t i = 0;
+
+#ifdef PCM_HAVE_SSE2
+  if (channels == 1)
+  {
+    const __m128 scale = _mm_set1_ps(32768.f);
+    for (; i + 8 <= frames; i += 8)
+    {
+      // cvtps rounds to nearest; packs saturates to the int16 range
+      __m128i lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i), scale));
+      __m128i hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(lo, hi));
+    }
+  }
+#endif
+
+  for (; i < frames; i++)
+  {
+    float sum = 0;
+    for (int c = 0; c < channels; c++)
+    {
+      float value;
+      memcpy(&value, in + i * channels + c, sizeof(value));
+      sum += value;
+    }
+    out[i] = clampToPcm16(sum / channels);
+  }
+}
+
+// 16-bit frames to float, for analysis and offline processing of a buffer
+inline void pcm16ToFloat(const int16_t* in, float* out, size_t count)
+{
+  const float scale = 1.f / 32768.f;
+  size_t i = 0;
+
+#ifdef PCM_HAVE_SSE2
+  const __m128 vscale = _mm_set1_ps(scale);
+  for (; i + 8 <= count; i += 8)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    // Interleave into the high halves, then arithmetic shift to sign-extend
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+    _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+  }
+#endif
+
+  for (; i < count; i++)
+  {
+    out[i] = in[i] * scale;
+  }
+}
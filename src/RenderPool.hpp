@@ -0,0 +1,257 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#ifdef __APPLE__
+#include <dispatch/dispatch.h>
+#define PCM_HAVE_RENDER_THREADS 1
+#elif !defined(_WIN32)
+#include <pthread.h>
+#include <semaphore.h>
+#define PCM_HAVE_RENDER_THREADS 1
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // _mm_pause
+#endif
+
+#include "RtCheck.hpp"
+
+// Counting semaphore whose post never blocks, so the audio thread can use it
+class WakeSignal
+{
+public:
+#if defined(__APPLE__)
+  WakeSignal() : semaphore(dispatch_semaphore_create(0)) {}
+  ~WakeSignal() { dispatch_release(semaphore); }
+  void post() { dispatch_semaphore_signal(semaphore); }
+  void wait() { dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER); }
+
+private:
+  dispatch_semaphore_t semaphore;
+#elif defined(PCM_HAVE_RENDER_THREADS)
+  WakeSignal() { sem_init(&semaphore, 0, 0); }
+  ~WakeSignal() { sem_destroy(&semaphore); }
+  void post() { sem_post(&semaphore); }
+  void wait()
+  {
+    while (sem_wait(&semaphore) != 0) {} // EINTR
+  }
+
+private:
+  sem_t semaphore;
+#else
+  void post() {}
+  void wait() {}
+#endif
+};
+
+// Fixed pool of pinned worker threads that run numbered tasks for the audio
+// thread. run() splits the task ids into one range per participant (the
+// caller is participant 0); each takes ids from the bottom of its own range
+// and, once that is empty, steals from the top of the others'. A range is a
+// single atomic word, so taking and stealing are one CAS each.
+//
+// `task` and `context` are fixed for the pool's life: a worker that wakes
+// late can only ever pick up ids of the current run, never a stale callback.
+class RenderPool
+{
+public:
+  typedef void (*Task)(void* context, int id);
+
+  static const int MAX_WORKERS = 15;
+
+  RenderPool(int workers, Task task, void* context)
+    : task(task), context(context), ranges(new Range[MAX_WORKERS + 1])
+  {
+#ifdef PCM_HAVE_RENDER_THREADS
+    workers = std::max(0, std::min(workers, int(MAX_WORKERS)));
+#else
+    workers = 0;
+#endif
+    workerCount = workers;
+    signals.reset(new WakeSignal[std::max(workers, 1)]);
+    running = true;
+    threads.reserve(workers);
+    for (int i = 0; i < workers; i++)
+    {
+      threads.emplace_back([this, i] { work(i + 1); });
+      pin(threads.back(), i + 1);
+    }
+  }
+
+  ~RenderPool()
+  {
+    running = false;
+    for (int i = 0; i < int(threads.size()); i++)
+    {
+      signals[i].post();
+    }
+    for (std::thread& thread : threads)
+    {
+      thread.join();
+    }
+  }
+
+  int workers() const { return workerCount; }
+
+  // Run task ids [0, count) to completion; called from the audio thread
+  void run(int count)
+  {
+    int participants = workers() + 1;
+    remaining.store(count, std::memory_order_relaxed);
+
+    for (int p = 0; p < participants; p++)
+    {
+      uint32_t top = uint64_t(count) * p / participants;
+      uint32_t bottom = uint64_t(count) * (p + 1) / participants;
+      ranges[p].word.store(pack(top, bottom), std::memory_order_release);
+    }
+
+    // Wake only as many workers as there are tasks beyond the caller's own
+    int wake = std::min(workers(), count - 1);
+    postedAt.store(now(), std::memory_order_relaxed);
+    for (int i = 0; i < wake; i++)
+    {
+      signals[i].post();
+    }
+
+    drain(0);
+
+    // Stolen tasks may still be running on a worker
+    while (remaining.load(std::memory_order_acquire) > 0)
+    {
+      pause();
+    }
+  }
+
+  // Nanoseconds from a post to the woken worker running, over all wake-ups
+  std::atomic<long> wakeups{0};
+  std::atomic<int64_t> wakeTotalNs{0};
+  std::atomic<int64_t> wakeMaxNs{0};
+
+private:
+  // Task ids [top, bottom) still to run; the owner takes from the bottom.
+  // Padded so no two ranges' words share a cache line.
+  struct Range
+  {
+    std::atomic<uint64_t> word{0};
+    char padding[56];
+  };
+
+  Task task;
+  void* context;
+  int workerCount = 0;
+  std::unique_ptr<Range[]> ranges;
+  std::unique_ptr<WakeSignal[]> signals;
+  std::vector<std::thread> threads;
+  std::atomic<bool> running{false};
+  std::atomic<int> remaining{0};
+  std::atomic<int64_t> postedAt{0};
+
+  static uint64_t pack(uint32_t top, uint32_t bottom) { return uint64_t(top) << 32 | bottom; }
+
+  static int64_t now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  static void pause()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+  }
+
+  // Keep worker i on core i so it doesn't migrate mid-callback; the audio
+  // thread stays wherever the audio driver put it
+  static void pin(std::thread& thread, int index)
+  {
+#if defined(__linux__)
+    unsigned cores = std::thread::hardware_concurrency();
+    if (cores > 1)
+    {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(index % cores, &set);
+      pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+    }
+#endif
+  }
+
+  // Take an id from the bottom of a range (owner) or its top (thief)
+  bool take(int range, bool own, int& id)
+  {
+    std::atomic<uint64_t>& word = ranges[range].word;
+    uint64_t seen = word.load(std::memory_order_acquire);
+
+    for (;;)
+    {
+      uint32_t top = seen >> 32, bottom = uint32_t(seen);
+      if (top >= bottom)
+      {
+        return false;
+      }
+
+      uint64_t next = own ? pack(top, bottom - 1) : pack(top + 1, bottom);
+      if (word.compare_exchange_weak(seen, next, std::memory_order_acq_rel, std::memory_order_acquire))
+      {
+        id = own ? bottom - 1 : top;
+        return true;
+      }
+    }
+  }
+
+  // Run participant p's own tasks, then steal until every range is empty
+  void drain(int p)
+  {
+    int participants = workers() + 1;
+    int id;
+
+    while (take(p, true, id))
+    {
+      task(context, id);
+      remaining.fetch_sub(1, std::memory_order_release);
+    }
+
+    for (int offset = 1; offset < participants; offset++)
+    {
+      int victim = (p + offset) % participants;
+      while (take(victim, false, id))
+      {
+        task(context, id);
+        remaining.fetch_sub(1, std::memory_order_release);
+      }
+    }
+  }
+
+  void work(int p)
+  {
+    for (;;)
+    {
+      signals[p - 1].wait();
+      if (!running)
+      {
+        return;
+      }
+
+      int64_t latency = now() - postedAt.load(std::memory_order_relaxed);
+      wakeups.fetch_add(1, std::memory_order_relaxed);
+      wakeTotalNs.fetch_add(latency, std::memory_order_relaxed);
+      int64_t max = wakeMaxNs.load(std::memory_order_relaxed);
+      while (latency > max && !wakeMaxNs.compare_exchange_weak(max, latency, std::memory_order_relaxed)) {}
+
+      RtCheckScope realtime; // workers render audio too
+      drain(p);
+    }
+  }
+};
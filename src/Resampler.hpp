@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "PcmConvert.hpp"
+
+// Offline polyphase resampler: Kaiser-windowed sinc, one filter phase per
+// output position of the rational ratio outRate/inRate. Meant for load or
+// pack time, so quality is favoured over speed.
+class Resampler
+{
+public:
+  static const int ZERO_CROSSINGS = 24; // per side, at the narrower of the two rates
+  static const int MAX_PHASES = 4096;   // beyond this, coefficients are computed per frame
+
+  Resampler(int inRate, int outRate, double beta = 9.0)
+    : beta(beta)
+  {
+    int divisor = gcd(inRate, outRate);
+    up = outRate / divisor;
+    down = inRate / divisor;
+
+    // Low-pass at the lower Nyquist, pulled in slightly for the transition band
+    cutoff = std::min(1.0, double(outRate) / inRate) * 0.94;
+    halfTaps = int(std::ceil(ZERO_CROSSINGS / cutoff));
+    taps = halfTaps * 2;
+    besselBeta = bessel0(beta);
+
+    if (up <= MAX_PHASES)
+    {
+      table.resize(size_t(up) * taps);
+      for (int phase = 0; phase < up; phase++)
+      {
+        fillPhase(double(phase) / up, &table[size_t(phase) * taps]);
+      }
+    }
+  }
+
+  // Frames produced from `inFrames` input frames
+  size_t outputLength(size_t inFrames) const
+  {
+    return size_t((uint64_t(inFrames) * up + down - 1) / down);
+  }
+
+  void process(const int16_t* in, size_t inFrames, std::vector<int16_t>& out) const
+  {
+    // Work in float with zero padding on both sides so every tap is in range
+    std::vector<float> padded(inFrames + taps * 2, 0.f);
+    pcm16ToFloat(in, padded.data() + taps, inFrames);
+
+    out.resize(outputLength(inFrames));
+    std::vector<float> scratch(table.empty() ? taps : 0);
+
+    for (size_t n = 0; n < out.size(); n++)
+    {
+      uint64_t position = uint64_t(n) * down;
+      size_t index = position / up;
+      int phase = position % up;
+
+      const float* coefficients;
+      if (table.empty())
+      {
+        fillPhase(double(phase) / up, scratch.data());
+        coefficients = scratch.data();
+      }
+      else
+      {
+        coefficients = &table[size_t(phase) * taps];
+      }
+
+      // Taps cover input frames index - halfTaps + 1 ... index + halfTaps
+      const float* x = padded.data() + taps + index - halfTaps + 1;
+      float sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+      int k = 0;
+
+      for (; k + 4 <= taps; k += 4)
+      {
+        sum0 += coefficients[k] * x[k];
+        sum1 += coefficients[k + 1] * x[k + 1];
+        sum2 += coefficients[k + 2] * x[k + 2];
+        sum3 += coefficients[k + 3] * x[k + 3];
+      }
+
+      for (; k < taps; k++)
+      {
+        sum0 += coefficients[k] * x[k];
+      }
+
+      out[n] = clampToPcm16((sum0 + sum1) + (sum2 + sum3));
+    }
+  }
+
+  int ratioUp() const { return up; }
+  int ratioDown() const { return down; }
+  int tapCount() const { return taps; }
+
+private:
+  int up = 1;
+  int down = 1;
+  int taps = 0;
+  int halfTaps = 0;
+  double cutoff = 1;
+  double beta = 9;
+  double besselBeta = 1;
+  std::vector<float> table;
+
+  static int gcd(int a, int b)
+  {
+    while (b)
+    {
+      int t = a % b;
+      a = b;
+      b = t;
+    }
+    return a;
+  }
+
+  // Zeroth-order modified Bessel function, for the Kaiser window
+  static double bessel0(double x)
+  {
+    double sum = 1, term = 1;
+    for (int k = 1; k < 50; k++)
+    {
+      term *= (x / (2 * k)) * (x / (2 * k));
+      sum += term;
+      if (term < 1e-12 * sum)
+      {
+        break;
+      }
+    }
+    return sum;
+  }
+
+  // Coefficients for an output that falls `fraction` of a frame past an input frame
+  void fillPhase(double fraction, float* coefficients) const
+  {
+    double sum = 0;
+    std::vector<double> values(taps);
+
+    for (int k = 0; k < taps; k++)
+    {
+      double t = (k - halfTaps + 1) - fraction; // distance from the output point in input frames
+      double x = t * cutoff;
+      double sinc = std::fabs(x) < 1e-9 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+      double w = t / halfTaps;
+      double window = std::fabs(w) >= 1 ? 0 : bessel0(beta * std::sqrt(1 - w * w)) / besselBeta;
+      values[k] = sinc * window * cutoff;
+      sum += values[k];
+    }
+
+    // Normalise each phase to unity DC gain
+    for (int k = 0; k < taps; k++)
+    {
+      coefficients[k] = float(values[k] / sum);
+    }
+  }
+};
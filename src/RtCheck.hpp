@@ -0,0 +1,253 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <string>
+
+#if defined(PCM_RT_CHECK) && defined(__GLIBC__)
+#include <dlfcn.h>    // dlsym
+#include <execinfo.h> // backtrace
+#include <pthread.h>
+#define PCM_HAVE_RT_CHECK 1
+#endif
+
+#include "Logger.hpp"
+
+// Debug guard for the audio thread. Between arm() and disarm() on a thread,
+// every malloc, calloc, realloc, free and pthread_mutex_lock that thread makes
+// is a violation: it is counted and, for the first MAX_REPORTS, its stack is
+// recorded for report(). Only builds with PCM_RT_CHECK (a CMake option) on
+// glibc replace those functions; elsewhere arming costs one thread-local
+// write and nothing is ever reported.
+//
+// allowLocks() is the one exception, for a lock the audio thread takes by
+// design in code outside this repository: allolib's SynthSequencer starts
+// each note with PolySynth::triggerOn, which locks the synth's list of voices
+// to insert. Locks taken while allowed are counted apart (allowedLocks()), not
+// as violations; allocations and frees still are.
+//
+// State is function-local statics with constant initialization, since malloc
+// can run before any constructor does, and they let more than one
+// translation unit include this header.
+struct RtCheck
+{
+  enum Kind
+  {
+    RT_MALLOC,
+    RT_FREE,
+    RT_LOCK,
+  };
+
+  static const int MAX_REPORTS = 32;
+  static const int MAX_FRAMES = 24;
+
+  struct Report
+  {
+    Kind kind;
+    int depth;
+    void* frames[MAX_FRAMES];
+  };
+
+  static bool enabled()
+  {
+#ifdef PCM_HAVE_RT_CHECK
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  static void arm()
+  {
+#ifdef PCM_HAVE_RT_CHECK
+    // backtrace() loads its unwinder on first use, which allocates
+    if (!warmed().exchange(true))
+    {
+      void* frame;
+      backtrace(&frame, 1);
+    }
+#endif
+    armed() = true;
+  }
+
+  static void disarm() { armed() = false; }
+
+  static void allowLocks(bool allow) { locksAllowed() = allow; }
+
+  static long violations() { return count().load(std::memory_order_relaxed); }
+  static long allowedLocks() { return allowed().load(std::memory_order_relaxed); }
+
+  // Called by the replacements below
+  static void violation(Kind kind)
+  {
+    if (!armed() || inside())
+    {
+      return;
+    }
+    if (kind == RT_LOCK && locksAllowed())
+    {
+      allowed().fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    inside() = true; // anything the recording itself does isn't a violation
+    long n = count().fetch_add(1, std::memory_order_relaxed);
+#ifdef PCM_HAVE_RT_CHECK
+    if (n < MAX_REPORTS)
+    {
+      reports()[n].kind = kind;
+      reports()[n].depth = backtrace(reports()[n].frames, MAX_FRAMES);
+    }
+#else
+    (void)kind;
+    (void)n;
+#endif
+    inside() = false;
+  }
+
+  // Log the recorded stacks and start over; returns how many violations
+  // there were. Call from outside the audio thread.
+  static long report(const std::string& context)
+  {
+    long total = violations();
+    allowed().store(0, std::memory_order_relaxed);
+    if (total == 0)
+    {
+      return 0;
+    }
+
+    static const char* NAMES[] = {"malloc", "free", "pthread_mutex_lock"};
+    PCM_LOG(LOG_ERROR, context, ": ", total, " real-time violations");
+
+#ifdef PCM_HAVE_RT_CHECK
+    for (long i = 0; i < total && i < MAX_REPORTS; i++)
+    {
+      PCM_LOG(LOG_ERROR, "  ", NAMES[reports()[i].kind], " on the audio thread:");
+      char** symbols = backtrace_symbols(reports()[i].frames, reports()[i].depth);
+      for (int f = 0; symbols && f < reports()[i].depth; f++)
+      {
+        PCM_LOG(LOG_ERROR, "    ", symbols[f]);
+      }
+      free(symbols);
+      logger().flush(); // stacks are long; keep the ring from filling
+    }
+#else
+    (void)NAMES;
+#endif
+
+    count().store(0, std::memory_order_relaxed);
+    return total;
+  }
+
+private:
+  static bool& armed()
+  {
+    static thread_local bool value = false;
+    return value;
+  }
+
+  static bool& inside()
+  {
+    static thread_local bool value = false;
+    return value;
+  }
+
+  static bool& locksAllowed()
+  {
+    static thread_local bool value = false;
+    return value;
+  }
+
+  static std::atomic<long>& allowed()
+  {
+    static std::atomic<long> value{0};
+    return value;
+  }
+
+  static std::atomic<long>& count()
+  {
+    static std::atomic<long> value{0};
+    return value;
+  }
+
+  static std::atomic<bool>& warmed()
+  {
+    static std::atomic<bool> value{false};
+    return value;
+  }
+
+  static Report* reports()
+  {
+    static Report value[MAX_REPORTS];
+    return value;
+  }
+};
+
+// Arms the checker for a scope, e.g. the body of onSound
+struct RtCheckScope
+{
+  RtCheckScope() { RtCheck::arm(); }
+  ~RtCheckScope() { RtCheck::disarm(); }
+};
+
+// Allows locks on this thread for a scope; see RtCheck::allowLocks
+struct RtCheckAllowLocks
+{
+  RtCheckAllowLocks() { RtCheck::allowLocks(true); }
+  ~RtCheckAllowLocks() { RtCheck::allowLocks(false); }
+};
+
+#ifdef PCM_HAVE_RT_CHECK
+// Replacements that note the call and forward to glibc's own entry points.
+// Defined once, in the one translation unit of the app.
+extern "C"
+{
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t count, size_t size);
+  void* __libc_realloc(void* pointer, size_t size);
+  void __libc_free(void* pointer);
+
+  void* malloc(size_t size)
+  {
+    RtCheck::violation(RtCheck::RT_MALLOC);
+    return __libc_malloc(size);
+  }
+
+  void* calloc(size_t count, size_t size)
+  {
+    RtCheck::violation(RtCheck::RT_MALLOC);
+    return __libc_calloc(count, size);
+  }
+
+  void* realloc(void* pointer, size_t size)
+  {
+    RtCheck::violation(RtCheck::RT_MALLOC);
+    return __libc_realloc(pointer, size);
+  }
+
+  void free(void* pointer)
+  {
+    if (pointer)
+    {
+      RtCheck::violation(RtCheck::RT_FREE);
+    }
+    __libc_free(pointer);
+  }
+
+  int pthread_mutex_lock(pthread_mutex_t* mutex)
+  {
+    // glibc's loader locks internally, so looking the real one up can't recurse
+    typedef int (*Lock)(pthread_mutex_t*);
+    static std::atomic<Lock> real{nullptr};
+    Lock lock = real.load(std::memory_order_acquire);
+    if (!lock)
+    {
+      lock = reinterpret_cast<Lock>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+      real.store(lock, std::memory_order_release);
+    }
+
+    RtCheck::violation(RtCheck::RT_LOCK);
+    return lock(mutex);
+  }
+}
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "SampleCache.hpp"
+
+// One zone of a patch: a key range mapped onto a shared sample buffer
+struct Sample
+{
+  int pitch_root = 60;
+  int pitch_highest = 127;
+  std::string name;
+  std::shared_ptr<SampleBuffer> buffer;
+
+  // Only records the zone; the audio is decoded later by SoundBankLoader
+  Sample(std::string filename, int pitch_root, int pitch_highest)
+  {
+    this->name = filename;
+    this->pitch_root = pitch_root;
+    this->pitch_highest = pitch_highest;
+    this->buffer = sampleCache().get(filename);
+  }
+
+  // Zone over an already decoded buffer, e.g. one read from a SampleBank
+  Sample(std::string filename, int pitch_root, int pitch_highest, std::shared_ptr<SampleBuffer> buffer)
+  {
+    this->name = filename;
+    this->pitch_root = pitch_root;
+    this->pitch_highest = pitch_highest;
+    this->buffer = buffer;
+  }
+
+  bool ready() const { return buffer->ready(); }
+};
@@ -0,0 +1,474 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Logger.hpp"
+#include "Patch.hpp"
+#include "SampleCache.hpp"
+
+// Packed sound bank: every sample of a SoundBank plus its zone layout in one
+// file, so startup is a single mmap and an index walk instead of a WAV parse
+// per sample. All integers are little-endian; audio is mono int16.
+//
+//   BankHeader
+//   BankBuffer[bufferCount]   one per distinct block of audio
+//   BankMip[mipCount]         buffers own contiguous runs of octave levels
+//   BankPatch[patchCount]     in SoundBank order
+//   BankZone[zoneCount]       patches own contiguous runs of zones
+//   string table              NUL-terminated names
+//   audio                     buffers, then octave levels, each on a BANK_ALIGN boundary
+//   tail levels               float32 per buffer (SampleBuffer::tailLevels), BANK_ALIGN-aligned
+
+const char BANK_MAGIC[8] = {'P', 'C', 'M', 'B', 'A', 'N', 'K', 0};
+const uint32_t BANK_VERSION = 3;
+const uint64_t BANK_ALIGN = 64;
+
+enum BankPatchKind : uint32_t
+{
+  BANK_TIMBRE = 0,
+  BANK_DRUMKIT = 1
+};
+
+struct BankHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t bufferCount;
+  uint32_t patchCount;
+  uint32_t zoneCount;
+  uint32_t mipCount;
+  uint32_t reserved;
+  uint64_t stringsOffset;
+  uint64_t stringsSize;
+  uint64_t fileSize;
+};
+
+struct BankBuffer
+{
+  uint64_t dataOffset;
+  uint64_t contentHash;
+  uint32_t frameCount;
+  uint32_t sampleRate;
+  uint32_t firstMip;
+  uint32_t mipCount;
+  uint64_t tailOffset;
+  uint32_t tailCount; // SampleBuffer::tailBlocks(frameCount)
+  uint32_t reserved;
+};
+
+struct BankMip
+{
+  uint64_t dataOffset;
+  uint32_t frameCount;
+  uint32_t reserved;
+};
+
+struct BankPatch
+{
+  uint32_t kind;
+  uint32_t firstZone;
+  uint32_t zoneCount;
+  uint32_t reserved;
+};
+
+struct BankZone
+{
+  uint32_t buffer;
+  uint32_t nameOffset; // source file path
+  uint32_t keyOffset;  // DrumKit sample key, empty for timbres
+  int32_t pitchRoot;   // already includes a Timbre's `correct` or a DrumKit root pitch
+  int32_t pitchHighest;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(BankHeader) == 56, "bank header layout");
+static_assert(sizeof(BankBuffer) == 48, "bank buffer layout");
+static_assert(sizeof(BankMip) == 16, "bank mip layout");
+static_assert(sizeof(BankPatch) == 16, "bank patch layout");
+static_assert(sizeof(BankZone) == 24, "bank zone layout");
+
+class SampleBank
+{
+public:
+  // Write a fully loaded bank. Buffers that share frames are stored once.
+  static bool write(const std::string& path, const std::vector<Patch*>& bank)
+  {
+    std::vector<BankBuffer> buffers;
+    std::vector<const SampleBuffer*> bufferSources;
+    std::vector<BankMip> mips;
+    std::vector<const int16_t*> mipSources;
+    std::vector<BankPatch> patches;
+    std::vector<BankZone> zones;
+    std::string strings(1, '\0'); // offset 0 is the empty string
+    std::map<const int16_t*, uint32_t> bufferIndex;
+
+    auto addString = [&strings](const std::string& text) {
+      uint32_t offset = strings.size();
+      strings += text;
+      strings += '\0';
+      return offset;
+    };
+
+    for (Patch* patch : bank)
+    {
+      DrumKit* kit = dynamic_cast<DrumKit*>(patch);
+      std::vector<std::string> keys(patch->samples.size());
+
+      if (kit)
+      {
+        for (auto& entry : kit->sampleIndex)
+        {
+          keys[entry.second] = entry.first;
+        }
+      }
+
+      BankPatch packed = {};
+      packed.kind = kit ? BANK_DRUMKIT : BANK_TIMBRE;
+      packed.firstZone = zones.size();
+      packed.zoneCount = patch->samples.size();
+      patches.push_back(packed);
+
+      for (size_t i = 0; i < patch->samples.size(); i++)
+      {
+        Sample* sample = patch->samples[i];
+        const SampleBuffer& buffer = *sample->buffer;
+
+        if (!buffer.ready() || buffer.frameCount == 0 || buffer.streamed())
+        {
+          PCM_LOG(LOG_ERROR, "Cannot pack ", sample->name, ": not fully loaded");
+          return false;
+        }
+
+        auto found = bufferIndex.find(buffer.frames);
+        if (found == bufferIndex.end())
+        {
+          BankBuffer packedBuffer = {};
+          packedBuffer.contentHash = buffer.contentHash;
+          packedBuffer.frameCount = buffer.frameCount;
+          packedBuffer.sampleRate = buffer.sample_rate;
+          packedBuffer.firstMip = mips.size();
+          packedBuffer.mipCount = buffer.mips.size();
+          packedBuffer.tailCount = buffer.tailCount;
+          for (const SampleBuffer::MipLevel& level : buffer.mips)
+          {
+            BankMip packedMip = {};
+            packedMip.frameCount = level.frameCount;
+            mips.push_back(packedMip);
+            mipSources.push_back(level.frames);
+          }
+          found = bufferIndex.emplace(buffer.frames, buffers.size()).first;
+          buffers.push_back(packedBuffer);
+          bufferSources.push_back(&buffer);
+        }
+
+        BankZone zone = {};
+        zone.buffer = found->second;
+        zone.nameOffset = addString(sample->name);
+        zone.keyOffset = kit ? addString(keys[i]) : 0;
+        zone.pitchRoot = sample->pitch_root;
+        zone.pitchHighest = sample->pitch_highest;
+        zones.push_back(zone);
+      }
+    }
+
+    // Lay out the file: tables, strings, then aligned audio
+    BankHeader header = {};
+    memcpy(header.magic, BANK_MAGIC, sizeof(header.magic));
+    header.version = BANK_VERSION;
+    header.bufferCount = buffers.size();
+    header.patchCount = patches.size();
+    header.zoneCount = zones.size();
+    header.mipCount = mips.size();
+    header.stringsOffset = sizeof(BankHeader) + buffers.size() * sizeof(BankBuffer) +
+                           mips.size() * sizeof(BankMip) + patches.size() * sizeof(BankPatch) + zones.size() * sizeof(BankZone);
+    header.stringsSize = strings.size();
+
+    uint64_t offset = header.stringsOffset + header.stringsSize;
+    for (BankBuffer& buffer : buffers)
+    {
+      offset = align(offset);
+      buffer.dataOffset = offset;
+      offset += uint64_t(buffer.frameCount) * sizeof(int16_t);
+    }
+    for (BankMip& mip : mips)
+    {
+      offset = align(offset);
+      mip.dataOffset = offset;
+      offset += uint64_t(mip.frameCount) * sizeof(int16_t);
+    }
+    for (BankBuffer& buffer : buffers)
+    {
+      offset = align(offset);
+      buffer.tailOffset = offset;
+      offset += uint64_t(buffer.tailCount) * sizeof(float);
+    }
+    header.fileSize = offset;
+
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp)
+    {
+      PCM_LOG(LOG_ERROR, "Cannot write ", path);
+      return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = ok && fwrite(buffers.data(), sizeof(BankBuffer), buffers.size(), fp) == buffers.size();
+    ok = ok && fwrite(mips.data(), sizeof(BankMip), mips.size(), fp) == mips.size();
+    ok = ok && fwrite(patches.data(), sizeof(BankPatch), patches.size(), fp) == patches.size();
+    ok = ok && fwrite(zones.data(), sizeof(BankZone), zones.size(), fp) == zones.size();
+    ok = ok && fwrite(strings.data(), 1, strings.size(), fp) == strings.size();
+
+    uint64_t written = header.stringsOffset + header.stringsSize;
+    const char padding[BANK_ALIGN] = {};
+
+    for (size_t i = 0; ok && i < buffers.size(); i++)
+    {
+      size_t gap = buffers[i].dataOffset - written;
+      size_t bytes = size_t(buffers[i].frameCount) * sizeof(int16_t);
+      ok = fwrite(padding, 1, gap, fp) == gap && fwrite(bufferSources[i]->frames, 1, bytes, fp) == bytes;
+      written = buffers[i].dataOffset + bytes;
+    }
+
+    for (size_t i = 0; ok && i < mips.size(); i++)
+    {
+      size_t gap = mips[i].dataOffset - written;
+      size_t bytes = size_t(mips[i].frameCount) * sizeof(int16_t);
+      ok = fwrite(padding, 1, gap, fp) == gap && fwrite(mipSources[i], 1, bytes, fp) == bytes;
+      written = mips[i].dataOffset + bytes;
+    }
+
+    for (size_t i = 0; ok && i < buffers.size(); i++)
+    {
+      size_t gap = buffers[i].tailOffset - written;
+      size_t bytes = size_t(buffers[i].tailCount) * sizeof(float);
+      ok = fwrite(padding, 1, gap, fp) == gap && fwrite(bufferSources[i]->tailLevels, 1, bytes, fp) == bytes;
+      written = buffers[i].tailOffset + bytes;
+    }
+
+    ok = fclose(fp) == 0 && ok;
+    PCM_LOG(ok ? LOG_INFO : LOG_ERROR, ok ? "Wrote " : "Failed writing ", path, ": ", patches.size(), " patches, ",
+            zones.size(), " zones, ", buffers.size(), " buffers, ", header.fileSize / (1024.0 * 1024.0), " MB");
+    return ok;
+  }
+
+  // Map a bank file and validate its index. Audio pages are touched lazily.
+  bool open(const std::string& path)
+  {
+    this->path = path;
+    file = std::make_shared<MappedFile>(path);
+    if (!file->valid())
+    {
+      return false;
+    }
+
+    if (file->size < sizeof(BankHeader))
+    {
+      return fail(path, "truncated header");
+    }
+
+    memcpy(&header, file->bytes, sizeof(header));
+    if (memcmp(header.magic, BANK_MAGIC, sizeof(BANK_MAGIC)) != 0)
+    {
+      return fail(path, "not a sample bank");
+    }
+    if (header.version != BANK_VERSION)
+    {
+      return fail(path, "version " + std::to_string(header.version) + ", expected " + std::to_string(BANK_VERSION));
+    }
+
+    uint64_t tables = sizeof(BankHeader) + uint64_t(header.bufferCount) * sizeof(BankBuffer) +
+                      uint64_t(header.mipCount) * sizeof(BankMip) + uint64_t(header.patchCount) * sizeof(BankPatch) + uint64_t(header.zoneCount) * sizeof(BankZone);
+    if (header.fileSize != file->size || tables != header.stringsOffset ||
+        header.stringsOffset + header.stringsSize > file->size || header.stringsSize == 0 ||
+        file->bytes[header.stringsOffset + header.stringsSize - 1] != '\0')
+    {
+      return fail(path, "corrupt index");
+    }
+
+    buffers = reinterpret_cast<const BankBuffer*>(file->bytes + sizeof(BankHeader));
+    mips = reinterpret_cast<const BankMip*>(buffers + header.bufferCount);
+    patches = reinterpret_cast<const BankPatch*>(mips + header.mipCount);
+    zones = reinterpret_cast<const BankZone*>(patches + header.patchCount);
+    strings = reinterpret_cast<const char*>(file->bytes + header.stringsOffset);
+
+    for (uint32_t i = 0; i < header.bufferCount; i++)
+    {
+      const BankBuffer& buffer = buffers[i];
+      if (buffer.dataOffset % BANK_ALIGN != 0 ||
+          buffer.dataOffset + uint64_t(buffer.frameCount) * sizeof(int16_t) > file->size ||
+          uint64_t(buffer.firstMip) + buffer.mipCount > header.mipCount ||
+          buffer.tailOffset % BANK_ALIGN != 0 ||
+          buffer.tailOffset + uint64_t(buffer.tailCount) * sizeof(float) > file->size ||
+          int(buffer.tailCount) != SampleBuffer::tailBlocks(buffer.frameCount))
+      {
+        return fail(path, "buffer out of range");
+      }
+    }
+
+    for (uint32_t i = 0; i < header.mipCount; i++)
+    {
+      const BankMip& mip = mips[i];
+      if (mip.dataOffset % BANK_ALIGN != 0 ||
+          mip.dataOffset + uint64_t(mip.frameCount) * sizeof(int16_t) > file->size)
+      {
+        return fail(path, "octave level out of range");
+      }
+    }
+
+    for (uint32_t i = 0; i < header.patchCount; i++)
+    {
+      if (uint64_t(patches[i].firstZone) + patches[i].zoneCount > header.zoneCount)
+      {
+        return fail(path, "patch out of range");
+      }
+    }
+
+    for (uint32_t i = 0; i < header.zoneCount; i++)
+    {
+      if (zones[i].buffer >= header.bufferCount || zones[i].nameOffset >= header.stringsSize ||
+          zones[i].keyOffset >= header.stringsSize)
+      {
+        return fail(path, "zone out of range");
+      }
+    }
+
+    return true;
+  }
+
+  // Does the bank describe exactly these patches (same files, roots and ranges)?
+  // Used to detect a bank packed from an older SoundBank definition.
+  bool matches(const std::vector<Patch*>& bank) const
+  {
+    if (!file || bank.size() != header.patchCount)
+    {
+      return false;
+    }
+
+    for (uint32_t p = 0; p < header.patchCount; p++)
+    {
+      const BankPatch& packed = patches[p];
+      const Patch* patch = bank[p];
+
+      if (packed.zoneCount != patch->samples.size() ||
+          (packed.kind == BANK_DRUMKIT) != (dynamic_cast<const DrumKit*>(patch) != nullptr))
+      {
+        return false;
+      }
+
+      for (uint32_t z = 0; z < packed.zoneCount; z++)
+      {
+        const BankZone& zone = zones[packed.firstZone + z];
+        const Sample* sample = patch->samples[z];
+
+        if (sample->name != strings + zone.nameOffset || sample->pitch_root != zone.pitchRoot ||
+            sample->pitch_highest != zone.pitchHighest)
+        {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  // Build patches whose zones are views into the mapped file
+  std::vector<Patch*> patchList() const
+  {
+    std::vector<std::shared_ptr<SampleBuffer>> views(header.bufferCount);
+    std::vector<Patch*> bank;
+
+    for (uint32_t p = 0; p < header.patchCount; p++)
+    {
+      const BankPatch& packed = patches[p];
+      std::vector<Sample*> samples;
+      std::vector<std::string> keys;
+
+      for (uint32_t z = 0; z < packed.zoneCount; z++)
+      {
+        const BankZone& zone = zones[packed.firstZone + z];
+        std::string name = strings + zone.nameOffset;
+        std::shared_ptr<SampleBuffer>& view = views[zone.buffer];
+
+        if (!view)
+        {
+          const BankBuffer& buffer = buffers[zone.buffer];
+          view = std::make_shared<SampleBuffer>(name);
+          view->adopt(reinterpret_cast<const int16_t*>(file->bytes + buffer.dataOffset),
+                      buffer.frameCount, buffer.sampleRate, buffer.contentHash, file);
+
+          // Packed levels are at the bank's rate; a resampled buffer filters and measures its own
+          if (view->needsResample())
+          {
+            view->resampleTo(SampleBuffer::targetRate());
+            view->buildMips();
+            view->measureTail();
+          }
+          else
+          {
+            view->adoptTail(reinterpret_cast<const float*>(file->bytes + buffer.tailOffset), buffer.tailCount, file);
+
+            std::vector<SampleBuffer::MipLevel> levels;
+            uint32_t count = std::min(buffer.mipCount, uint32_t(std::max(SampleBuffer::mipLevels(), 0)));
+            for (uint32_t m = buffer.firstMip; m < buffer.firstMip + count; m++)
+            {
+              levels.push_back({reinterpret_cast<const int16_t*>(file->bytes + mips[m].dataOffset),
+                                int(mips[m].frameCount)});
+            }
+            view->adoptMips(levels, file);
+
+            if (view->shouldStream())
+            {
+              view->streamFrom(std::make_shared<StreamSource>(path, buffer.dataOffset, 1, buffer.frameCount));
+            }
+          }
+
+          view->markReady();
+          sampleCache().insert(name, view);
+        }
+
+        samples.push_back(new Sample(name, zone.pitchRoot, zone.pitchHighest, view));
+        keys.push_back(strings + zone.keyOffset);
+      }
+
+      if (packed.kind == BANK_DRUMKIT)
+      {
+        bank.push_back(new DrumKit(samples, keys));
+      }
+      else
+      {
+        bank.push_back(new Timbre(samples));
+      }
+    }
+
+    return bank;
+  }
+
+  uint32_t patchCount() const { return header.patchCount; }
+  uint64_t size() const { return header.fileSize; }
+
+private:
+  std::string path;
+  std::shared_ptr<MappedFile> file;
+  BankHeader header = {};
+  const BankBuffer* buffers = nullptr;
+  const BankMip* mips = nullptr;
+  const BankPatch* patches = nullptr;
+  const BankZone* zones = nullptr;
+  const char* strings = nullptr;
+
+  static uint64_t align(uint64_t offset) { return (offset + BANK_ALIGN - 1) / BANK_ALIGN * BANK_ALIGN; }
+
+  bool fail(const std::string& path, const std::string& reason)
+  {
+    PCM_LOG(LOG_WARN, "Ignoring sample bank ", path, ": ", reason);
+    file.reset();
+    return false;
+  }
+};
@@ -0,0 +1,530 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint> // int16_t frames
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "al/sound/al_SoundFile.hpp"
+
+#include "MappedFile.hpp"
+#include "PcmConvert.hpp"
+#include "Resampler.hpp"
+#include "SampleStream.hpp"
+
+// Location and layout of the audio in a RIFF/WAVE file
+struct WavInfo
+{
+  int format = 0; // 1 = integer PCM, 3 = IEEE float
+  int channels = 0;
+  int sampleRate = 0;
+  int bitsPerSample = 0;
+  size_t dataOffset = 0;
+  size_t dataBytes = 0;
+};
+
+// Walk the RIFF chunks of an in-memory WAV file to find "fmt " and "data"
+inline bool parseWavHeader(const uint8_t* bytes, size_t size, WavInfo& info)
+{
+  auto u16 = [bytes](size_t at) { return uint32_t(bytes[at]) | uint32_t(bytes[at + 1]) << 8; };
+  auto u32 = [&u16](size_t at) { return u16(at) | u16(at + 2) << 16; };
+
+  if (size < 12 || memcmp(bytes, "RIFF", 4) != 0 || memcmp(bytes + 8, "WAVE", 4) != 0)
+  {
+    return false;
+  }
+
+  bool haveFormat = false;
+  size_t at = 12;
+
+  while (at + 8 <= size)
+  {
+    size_t chunkSize = u32(at + 4);
+    size_t body = at + 8;
+
+    if (memcmp(bytes + at, "fmt ", 4) == 0 && body + 16 <= size)
+    {
+      info.format = u16(body);
+      info.channels = u16(body + 2);
+      info.sampleRate = u32(body + 4);
+      info.bitsPerSample = u16(body + 14);
+
+      // WAVE_FORMAT_EXTENSIBLE keeps the real format in the sub-format GUID
+      if (info.format == 0xFFFE && chunkSize >= 26 && body + 26 <= size)
+      {
+        info.format = u16(body + 24);
+      }
+
+      haveFormat = true;
+    }
+    else if (memcmp(bytes + at, "data", 4) == 0)
+    {
+      info.dataOffset = body;
+      info.dataBytes = std::min(chunkSize, size - body);
+      return haveFormat;
+    }
+
+    at = body + chunkSize + (chunkSize & 1); // chunks are padded to even sizes
+  }
+
+  return false;
+}
+
+// Decoded audio of one file. Zones share these through SampleCache, so each
+// file (and each distinct content) is held only once.
+struct SampleBuffer
+{
+  // Settings are function-local statics so any number of translation units
+  // can include this header.
+
+  // Serve 16-bit mono files straight out of the page cache instead of copying
+  static bool& useMmap()
+  {
+    static bool value = true;
+    return value;
+  }
+
+  // 16-bit samples longer than this many seconds only keep their first
+  // streamHeadSeconds resident; the rest is read from disk while playing.
+  // Zero disables streaming.
+  static double& streamLongerThan()
+  {
+    static double value = 3.0;
+    return value;
+  }
+  static double& streamHeadSeconds()
+  {
+    static double value = 0.5;
+    return value;
+  }
+
+  // Device rate every buffer is converted to at load time; 0 keeps file rates
+  static int& targetRate()
+  {
+    static int value = 0;
+    return value;
+  }
+
+  // Octave-down copies kept per buffer so notes far above the root read
+  // band-limited frames instead of skipping and aliasing; 0 disables
+  static int& mipLevels()
+  {
+    static int value = 4;
+    return value;
+  }
+
+  // Frames per entry of the tail levels
+  static const int TAIL_BLOCK = 256;
+
+  // One octave level: low-passed and decimated by two from the level above
+  struct MipLevel
+  {
+    const int16_t* frames;
+    int frameCount;
+  };
+
+  std::string path;
+  int sample_rate = 44100;
+
+  // Native 16-bit frames; converted to float by the voice as they are read.
+  // Points into `storage`, which is either a MappedFile or a vector of frames.
+  // Only the first residentFrames are held when the buffer is streamed.
+  const int16_t* frames = nullptr;
+  int frameCount = 0;
+  int residentFrames = 0;
+  uint64_t contentHash = 0;
+  std::shared_ptr<StreamSource> stream;
+  std::vector<MipLevel> mips; // mips[0] is half the rate of `frames`
+
+  // Per TAIL_BLOCK frames of the whole sample, streamed or not: the loudest
+  // block RMS from that block to the end. Lets a voice see that nothing it has
+  // left to play can be heard (see tailLevel).
+  const float* tailLevels = nullptr;
+  int tailCount = 0;
+
+  explicit SampleBuffer(std::string path) : path(path) {}
+
+  SampleBuffer(const SampleBuffer&) = delete;
+  SampleBuffer& operator=(const SampleBuffer&) = delete;
+
+  // Read the file; called once, usually on a loader thread
+  bool decode()
+  {
+    if (!loadNative() && !loadDecoded())
+    {
+      frames = nullptr;
+      frameCount = 0;
+    }
+
+    contentHash = hashFrames(frames, frameCount, sample_rate);
+    residentFrames = frameCount;
+
+    bool resampled = needsResample();
+    if (resampled)
+    {
+      resampleTo(targetRate());
+    }
+
+    // While every frame is still in memory
+    measureTail();
+
+    if (!resampled && wav.format == 1 && wav.bitsPerSample == 16 && shouldStream())
+    {
+      streamFrom(std::make_shared<StreamSource>(path, wav.dataOffset, wav.channels, frameCount));
+    }
+
+    // A streamed tail isn't resident to filter; those voices read the base level
+    if (!streamed())
+    {
+      buildMips();
+    }
+
+    return frameCount > 0;
+  }
+
+  bool needsResample() const
+  {
+    return targetRate() > 0 && frameCount > 0 && sample_rate != targetRate();
+  }
+
+  // Convert the frames to `rate` once, so voices only apply the pitch ratio.
+  // Resampled buffers stay resident rather than streaming.
+  void resampleTo(int rate)
+  {
+    Resampler resampler(sample_rate, rate);
+    auto pcm = std::make_shared<std::vector<int16_t>>();
+    resampler.process(frames, frameCount, *pcm);
+
+    storage = pcm;
+    frames = pcm->data();
+    frameCount = residentFrames = pcm->size();
+    sample_rate = rate;
+    stream.reset();
+    mips.clear();
+    tailLevels = nullptr;
+    tailCount = 0;
+    contentHash = hashFrames(frames, frameCount, sample_rate);
+  }
+
+  // Filter and decimate the resident frames into mipLevels octave levels.
+  // Each level is half the one above, so together they stay under 1x the base.
+  void buildMips()
+  {
+    const int MIN_FRAMES = 64; // shorter levels aren't worth a table entry
+    Resampler halfband(2, 1);
+    auto levels = std::make_shared<std::vector<std::vector<int16_t>>>();
+    const int16_t* source = frames;
+    int count = frameCount;
+
+    mips.clear();
+    for (int level = 0; level < mipLevels() && int(halfband.outputLength(count)) >= MIN_FRAMES; level++)
+    {
+      levels->emplace_back();
+      halfband.process(source, count, levels->back());
+      source = levels->back().data();
+      count = levels->back().size();
+    }
+
+    for (const std::vector<int16_t>& level : *levels)
+    {
+      mips.push_back({level.data(), int(level.size())});
+    }
+    mipStorage = levels;
+  }
+
+  // Use octave levels held by something else (e.g. a mapped bank)
+  void adoptMips(const std::vector<MipLevel>& levels, std::shared_ptr<const void> owner)
+  {
+    mips = levels;
+    mipStorage = owner;
+  }
+
+  // Fill the tail levels from the resident frames, which must be all of them
+  void measureTail()
+  {
+    auto levels = std::make_shared<std::vector<float>>(tailBlocks(frameCount));
+
+    for (int block = 0; block < int(levels->size()); block++)
+    {
+      int start = block * TAIL_BLOCK, end = std::min(start + TAIL_BLOCK, frameCount);
+      double sum = 0;
+      for (int i = start; i < end; i++)
+      {
+        sum += double(frames[i]) * frames[i];
+      }
+      (*levels)[block] = std::sqrt(sum / (end - start)) * PCM_SCALE;
+    }
+
+    // Running max from the end turns block levels into "loudest from here on"
+    for (int block = int(levels->size()) - 2; block >= 0; block--)
+    {
+      (*levels)[block] = std::max((*levels)[block], (*levels)[block + 1]);
+    }
+
+    tailLevels = levels->data();
+    tailCount = levels->size();
+    tailStorage = levels;
+  }
+
+  // Use tail levels held by something else (e.g. a mapped bank)
+  void adoptTail(const float* levels, int count, std::shared_ptr<const void> owner)
+  {
+    tailLevels = levels;
+    tailCount = count;
+    tailStorage = owner;
+  }
+
+  static int tailBlocks(int frames) { return (frames + TAIL_BLOCK - 1) / TAIL_BLOCK; }
+
+  // Loudest RMS anywhere from base-level `frame` to the end, or 1 if unknown
+  float tailLevel(int frame) const
+  {
+    if (!tailLevels)
+    {
+      return 1;
+    }
+    int block = frame / TAIL_BLOCK;
+    return block < tailCount ? tailLevels[std::max(block, 0)] : 0;
+  }
+
+  // Level a voice playing at `rate` should read; rate / 2^level is its new rate.
+  // Levels keep content below 0.94 of their Nyquist (the Resampler cutoff), so
+  // one can be read up to 1 / 0.94 times faster before anything folds back.
+  int mipLevelFor(float rate) const
+  {
+    const float MAX_RATE = 1 / 0.94f;
+    int level = 0;
+    while (level < int(mips.size()) && rate > MAX_RATE)
+    {
+      rate *= 0.5f;
+      level++;
+    }
+    return level;
+  }
+
+  bool shouldStream() const
+  {
+    return streamLongerThan() > 0 && frameCount > streamLongerThan() * sample_rate;
+  }
+
+  // Keep only the head in memory and leave the rest to `source`
+  bool streamFrom(std::shared_ptr<StreamSource> source)
+  {
+    if (!source->valid())
+    {
+      return false;
+    }
+
+    int head = std::min(frameCount, int(streamHeadSeconds() * sample_rate));
+    auto pcm = std::make_shared<std::vector<int16_t>>(frames, frames + head);
+
+    storage = pcm;
+    frames = pcm->data();
+    residentFrames = head;
+    stream = source;
+    sampleStreamer().start();
+    return true;
+  }
+
+  bool streamed() const { return stream != nullptr; }
+
+  // Reader for one playback of a level (see mipLevelFor); claims a disk
+  // stream if the base level is streamed
+  SampleReader read(int level = 0) const
+  {
+    SampleReader reader;
+    if (level > 0)
+    {
+      reader.head = mips[level - 1].frames;
+      reader.headFrames = mips[level - 1].frameCount;
+      return reader;
+    }
+
+    reader.head = frames;
+    reader.headFrames = residentFrames;
+    reader.stream = stream ? sampleStreamer().acquire(stream.get(), residentFrames) : nullptr;
+    return reader;
+  }
+
+  // How far a reader can play: all of a streamed sample, or what it holds in memory
+  int playableFrames(const SampleReader& reader) const
+  {
+    return reader.stream ? frameCount : reader.headFrames;
+  }
+
+  // Make this buffer a view of frames owned by something else (e.g. a mapped bank)
+  void adopt(const int16_t* data, int count, int rate, uint64_t hash, std::shared_ptr<const void> owner)
+  {
+    storage = owner;
+    frames = data;
+    frameCount = count;
+    residentFrames = count;
+    sample_rate = rate;
+    contentHash = hash;
+    mips.clear();
+    tailLevels = nullptr;
+    tailCount = 0;
+  }
+
+  // Make this buffer a view of another one holding identical audio
+  void share(const SampleBuffer& other)
+  {
+    storage = other.storage;
+    frames = other.frames;
+    frameCount = other.frameCount;
+    residentFrames = other.residentFrames;
+    sample_rate = other.sample_rate;
+    stream = other.stream;
+    mips = other.mips;
+    mipStorage = other.mipStorage;
+    tailLevels = other.tailLevels;
+    tailCount = other.tailCount;
+    tailStorage = other.tailStorage;
+  }
+
+  // Full comparison for resident buffers; streamed ones compare their heads and hash
+  bool sameContent(const SampleBuffer& other) const
+  {
+    return contentHash == other.contentHash && frameCount == other.frameCount &&
+           sample_rate == other.sample_rate &&
+           memcmp(frames, other.frames, std::min(residentFrames, other.residentFrames) * sizeof(int16_t)) == 0;
+  }
+
+  bool sharesStorageWith(const SampleBuffer& other) const { return storage == other.storage; }
+
+  void markReady() { loaded.store(true, std::memory_order_release); }
+
+  // True once decoding has finished; frames may still be empty if the file was bad
+  bool ready() const { return loaded.load(std::memory_order_acquire); }
+
+  float frame(int index) const { return frames[index] * PCM_SCALE; }
+
+  size_t bytes() const { return residentFrames * sizeof(int16_t); }
+
+  size_t mipBytes() const
+  {
+    size_t total = 0;
+    for (const MipLevel& level : mips)
+    {
+      total += level.frameCount * sizeof(int16_t);
+    }
+    return total;
+  }
+
+  // 64-bit multiply/xorshift hash over the frames, eight bytes at a time
+  static uint64_t hashFrames(const int16_t* data, int count, int rate)
+  {
+    const uint64_t prime = 0x9E3779B97F4A7C15ull;
+    uint64_t h = uint64_t(count) * prime ^ uint64_t(rate);
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    size_t size = size_t(count) * sizeof(int16_t);
+    size_t at = 0;
+
+    for (; at + 8 <= size; at += 8)
+    {
+      uint64_t word;
+      memcpy(&word, bytes + at, 8);
+      h = (h ^ word) * prime;
+      h ^= h >> 29;
+    }
+
+    for (; at < size; at++)
+    {
+      h = (h ^ bytes[at]) * prime;
+    }
+
+    return h ^ (h >> 32);
+  }
+
+private:
+  std::atomic<bool> loaded{false};
+  std::shared_ptr<const void> storage;
+  std::shared_ptr<const void> mipStorage;
+  std::shared_ptr<const void> tailStorage;
+  WavInfo wav;
+
+  // Parse the WAV ourselves; mono 16-bit files keep their data chunk as-is
+  bool loadNative()
+  {
+    auto file = std::make_shared<MappedFile>(path);
+    WavInfo info;
+
+    if (!file->valid() || !parseWavHeader(file->bytes, file->size, info) || info.channels < 1)
+    {
+      return false;
+    }
+
+    wav = info;
+
+    bool isInt = info.format == 1 && (info.bitsPerSample == 16 || info.bitsPerSample == 24 || info.bitsPerSample == 32);
+    bool isFloat = info.format == 3 && info.bitsPerSample == 32;
+
+    if (!isInt && !isFloat)
+    {
+      return false;
+    }
+
+    sample_rate = info.sampleRate;
+    const uint8_t* data = file->bytes + info.dataOffset;
+    size_t count = info.dataBytes / (info.bitsPerSample / 8 * info.channels);
+
+    if (info.bitsPerSample == 16 && info.channels == 1 && useMmap() && info.dataOffset % sizeof(int16_t) == 0)
+    {
+      storage = file;
+      frames = reinterpret_cast<const int16_t*>(data);
+      frameCount = count;
+      return true;
+    }
+
+    // Size the buffer once and convert/downmix in a single pass
+    auto pcm = std::make_shared<std::vector<int16_t>>(count);
+
+    if (isFloat)
+    {
+      downmixFloat(reinterpret_cast<const float*>(data), info.channels, pcm->data(), count);
+    }
+    else if (info.bitsPerSample == 16)
+    {
+      downmixPcm16(reinterpret_cast<const int16_t*>(data), info.channels, pcm->data(), count);
+    }
+    else if (info.bitsPerSample == 24)
+    {
+      downmixPcm24(data, info.channels, pcm->data(), count);
+    }
+    else
+    {
+      downmixPcm32(reinterpret_cast<const int32_t*>(data), info.channels, pcm->data(), count);
+    }
+
+    storage = pcm;
+    frames = pcm->data();
+    frameCount = count;
+    return true;
+  }
+
+  // Anything else (8-bit, AIFF, ...) goes through SoundFile and is requantized
+  bool loadDecoded()
+  {
+    al::SoundFile file;
+    if (!file.open(path.c_str()) || file.channels < 1)
+    {
+      return false;
+    }
+
+    sample_rate = file.sampleRate;
+
+    auto pcm = std::make_shared<std::vector<int16_t>>(file.frameCount);
+    downmixFloat(file.data.data(), file.channels, pcm->data(), pcm->size());
+
+    storage = pcm;
+    frames = pcm->data();
+    frameCount = pcm->size();
+    return frameCount > 0;
+  }
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Logger.hpp"
+#include "SampleBuffer.hpp"
+
+// Shared store of decoded sample buffers, keyed by file path and, once
+// decoded, by content hash. Zones naming the same file get the same buffer;
+// different files with identical audio end up sharing one copy of the frames.
+class SampleCache
+{
+public:
+  // Buffer for a path, created (undecoded) on first request
+  std::shared_ptr<SampleBuffer> get(const std::string& path)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<SampleBuffer>& entry = byPath[path];
+
+    if (!entry)
+    {
+      entry = std::make_shared<SampleBuffer>(path);
+    }
+
+    return entry;
+  }
+
+  // Register a buffer that was decoded elsewhere (e.g. read from a SampleBank)
+  void insert(const std::string& path, std::shared_ptr<SampleBuffer> buffer)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    byPath[path] = buffer;
+    byContent[buffer->contentHash].push_back(buffer.get());
+  }
+
+  // Decode a buffer and fold it onto an earlier one with the same content.
+  // Safe to call from several loader threads at once.
+  void decode(SampleBuffer& buffer)
+  {
+    if (buffer.ready())
+    {
+      return;
+    }
+
+    bool ok = buffer.decode();
+
+    if (ok)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::vector<SampleBuffer*>& matches = byContent[buffer.contentHash];
+      bool shared = false;
+
+      for (SampleBuffer* other : matches)
+      {
+        if (buffer.sameContent(*other))
+        {
+          PCM_LOG(LOG_INFO, "Loaded ", buffer.path, " (same audio as ", other->path, ")");
+          buffer.share(*other);
+          shared = true;
+          break;
+        }
+      }
+
+      if (!shared)
+      {
+        matches.push_back(&buffer);
+        PCM_LOG(LOG_INFO, "Loaded ", buffer.path, " with ", buffer.frameCount, " samples");
+      }
+    }
+    else
+    {
+      PCM_LOG(LOG_WARN, "Failed to load ", buffer.path);
+    }
+
+    buffer.markReady();
+  }
+
+  // Every distinct buffer handed out so far
+  std::vector<std::shared_ptr<SampleBuffer>> buffers()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::shared_ptr<SampleBuffer>> all;
+
+    for (auto& entry : byPath)
+    {
+      all.push_back(entry.second);
+    }
+
+    return all;
+  }
+
+  // Bytes of audio actually held, counting shared frames once
+  size_t residentBytes()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t total = 0;
+
+    for (auto& entry : byContent)
+    {
+      for (SampleBuffer* buffer : entry.second)
+      {
+        total += buffer->bytes();
+      }
+    }
+
+    return total;
+  }
+
+  // Bytes held by octave levels, on top of residentBytes()
+  size_t mipBytes()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t total = 0;
+
+    for (auto& entry : byContent)
+    {
+      for (SampleBuffer* buffer : entry.second)
+      {
+        total += buffer->mipBytes();
+      }
+    }
+
+    return total;
+  }
+
+  size_t uniqueCount()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t total = 0;
+
+    for (auto& entry : byContent)
+    {
+      total += entry.second.size();
+    }
+
+    return total;
+  }
+
+private:
+  std::mutex mutex;
+  std::map<std::string, std::shared_ptr<SampleBuffer>> byPath;
+  std::unordered_map<uint64_t, std::vector<SampleBuffer*>> byContent;
+};
+
+// Process-wide cache; a function-local static so static SoundBank definitions can use it
+inline SampleCache& sampleCache()
+{
+  static SampleCache cache;
+  return cache;
+}
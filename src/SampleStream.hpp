@@ -0,0 +1,301 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>  // open
+#include <unistd.h> // pread, close
+#define PCM_HAVE_STREAMING 1
+#endif
+
+#include "PcmConvert.hpp"
+
+// Where the non-resident tail of a streamed sample lives on disk: 16-bit
+// interleaved frames starting at `dataOffset` of an open file.
+struct StreamSource
+{
+  int fd = -1;
+  uint64_t dataOffset = 0;
+  int channels = 1;
+  int frameCount = 0;
+
+  StreamSource(const std::string& path, uint64_t dataOffset, int channels, int frameCount)
+    : dataOffset(dataOffset), channels(channels), frameCount(frameCount)
+  {
+#ifdef PCM_HAVE_STREAMING
+    fd = ::open(path.c_str(), O_RDONLY);
+#endif
+  }
+
+  StreamSource(const StreamSource&) = delete;
+  StreamSource& operator=(const StreamSource&) = delete;
+
+  ~StreamSource()
+  {
+#ifdef PCM_HAVE_STREAMING
+    if (fd >= 0)
+    {
+      ::close(fd);
+    }
+#endif
+  }
+
+  bool valid() const { return fd >= 0; }
+};
+
+// Ring of upcoming frames for one playing voice. Single producer (the
+// streamer thread) and single consumer (the voice); both sides only use
+// atomics, so the audio thread never blocks on it.
+class SampleStream
+{
+public:
+  static const int CAPACITY = 1 << 16;  // frames; ~1.4 s at 48 kHz
+  static const int CHUNK = 4096;        // frames per disk read
+  static const int HEADROOM = 1 << 13;  // frames the voice may advance between consume() calls
+
+  // Frame at an absolute index of the sample, or silence if the reader is behind
+  int16_t at(int index) const
+  {
+    if (index < written.load(std::memory_order_acquire))
+    {
+      return ring[index & (CAPACITY - 1)];
+    }
+
+    underruns().fetch_add(1, std::memory_order_relaxed);
+    return 0;
+  }
+
+  // Contiguous frames [index, index + count) if they are buffered and don't wrap
+  const int16_t* span(int index, int count) const
+  {
+    int start = index & (CAPACITY - 1);
+    if (index + count <= written.load(std::memory_order_acquire) && start + count <= CAPACITY)
+    {
+      return ring + start;
+    }
+    return nullptr;
+  }
+
+  // Voice no longer needs frames below `index`; lets the reader refill them
+  void consume(int index) { consumed.store(index, std::memory_order_release); }
+
+  // Reads that found the reader behind, across every stream
+  static std::atomic<long>& underruns()
+  {
+    static std::atomic<long> count{0};
+    return count;
+  }
+
+private:
+  friend class SampleStreamer;
+
+  enum State { FREE, CLAIMING, ACTIVE, RELEASING };
+
+  std::atomic<int> state{FREE};
+  std::atomic<int> written{0};
+  std::atomic<int> consumed{0};
+  const StreamSource* source = nullptr;
+  int16_t ring[CAPACITY];
+};
+
+// Background reader that keeps every active SampleStream topped up from disk.
+// Streams are preallocated; acquire() and release() are lock-free and safe to
+// call from the audio thread.
+class SampleStreamer
+{
+public:
+  static const int MAX_STREAMS = 64;
+
+  SampleStreamer() : streams(new SampleStream[MAX_STREAMS]) {}
+
+  ~SampleStreamer()
+  {
+    running = false;
+    if (reader.joinable())
+    {
+      reader.join();
+    }
+  }
+
+  // Start the reader thread; called once streamed samples exist
+  void start()
+  {
+    bool expected = false;
+    if (started.compare_exchange_strong(expected, true))
+    {
+      running = true;
+      reader = std::thread([this] { work(); });
+    }
+  }
+
+  // Claim a stream that will deliver `source` from frame `firstFrame` onwards.
+  // Returns nullptr if every stream is busy.
+  SampleStream* acquire(const StreamSource* source, int firstFrame)
+  {
+    for (int i = 0; i < MAX_STREAMS; i++)
+    {
+      SampleStream& stream = streams[i];
+      int expected = SampleStream::FREE;
+
+      if (stream.state.load(std::memory_order_relaxed) == SampleStream::FREE &&
+          stream.state.compare_exchange_strong(expected, SampleStream::CLAIMING, std::memory_order_acquire))
+      {
+        stream.source = source;
+        stream.written.store(firstFrame, std::memory_order_relaxed);
+        stream.consumed.store(firstFrame, std::memory_order_relaxed);
+        stream.state.store(SampleStream::ACTIVE, std::memory_order_release);
+        return &stream;
+      }
+    }
+
+    exhausted.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  // Hand a stream back; the reader frees it once it is not mid-read
+  void release(SampleStream* stream)
+  {
+    if (stream)
+    {
+      stream->state.store(SampleStream::RELEASING, std::memory_order_release);
+    }
+  }
+
+  int active() const
+  {
+    int count = 0;
+    for (int i = 0; i < MAX_STREAMS; i++)
+    {
+      count += streams[i].state.load(std::memory_order_relaxed) == SampleStream::ACTIVE;
+    }
+    return count;
+  }
+
+  // acquire() calls that found no free stream
+  std::atomic<long> exhausted{0};
+
+private:
+  std::unique_ptr<SampleStream[]> streams;
+  std::thread reader;
+  std::atomic<bool> started{false};
+  std::atomic<bool> running{false};
+
+  void work()
+  {
+    std::vector<int16_t> scratch(SampleStream::CHUNK * 8);
+
+    while (running)
+    {
+      bool busy = false;
+
+      for (int i = 0; i < MAX_STREAMS; i++)
+      {
+        SampleStream& stream = streams[i];
+        int state = stream.state.load(std::memory_order_acquire);
+
+        if (state == SampleStream::RELEASING)
+        {
+          stream.source = nullptr;
+          stream.state.store(SampleStream::FREE, std::memory_order_release);
+        }
+        else if (state == SampleStream::ACTIVE)
+        {
+          busy |= fill(stream, scratch);
+        }
+      }
+
+      // Poll quickly while there is work, otherwise idle
+      std::this_thread::sleep_for(std::chrono::milliseconds(busy ? 1 : 4));
+    }
+  }
+
+  // Read one chunk into the stream if it has room; true if anything was read
+  bool fill(SampleStream& stream, std::vector<int16_t>& scratch)
+  {
+#ifdef PCM_HAVE_STREAMING
+    const StreamSource& source = *stream.source;
+    int written = stream.written.load(std::memory_order_relaxed);
+    int consumed = stream.consumed.load(std::memory_order_acquire);
+    int room = SampleStream::CAPACITY - SampleStream::HEADROOM - (written - consumed);
+    int count = std::min(std::min(room, int(SampleStream::CHUNK)), source.frameCount - written);
+
+    if (count <= 0)
+    {
+      return false;
+    }
+
+    // Don't wrap within one read
+    int start = written & (SampleStream::CAPACITY - 1);
+    count = std::min(count, SampleStream::CAPACITY - start);
+
+    size_t frameBytes = sizeof(int16_t) * source.channels;
+    if (scratch.size() < size_t(count) * source.channels)
+    {
+      scratch.resize(size_t(count) * source.channels);
+    }
+
+    ssize_t got = pread(source.fd, scratch.data(), count * frameBytes, source.dataOffset + uint64_t(written) * frameBytes);
+    if (got <= 0)
+    {
+      return false;
+    }
+
+    count = got / frameBytes;
+    downmixPcm16(scratch.data(), source.channels, stream.ring + start, count);
+    stream.written.store(written + count, std::memory_order_release);
+    return true;
+#else
+    return false;
+#endif
+  }
+};
+
+inline SampleStreamer& sampleStreamer()
+{
+  static SampleStreamer streamer;
+  return streamer;
+}
+
+// How a voice reads a sample: resident head frames, then the voice's stream
+struct SampleReader
+{
+  const int16_t* head = nullptr;
+  int headFrames = 0;
+  SampleStream* stream = nullptr;
+
+  int16_t at(int index) const
+  {
+    if (index < headFrames)
+    {
+      return head[index];
+    }
+
+    return stream ? stream->at(index) : 0;
+  }
+
+  float frame(int index) const { return at(index) * PCM_SCALE; }
+
+  // Pointer to frame `index` if frames [index, index + count) are contiguous in
+  // memory, i.e. all in the head or all buffered in one stretch of the stream
+  const int16_t* span(int index, int count) const
+  {
+    if (index + count <= headFrames)
+    {
+      return head + index;
+    }
+
+    if (index >= headFrames && stream)
+    {
+      return stream->span(index, count);
+    }
+
+    return nullptr;
+  }
+};
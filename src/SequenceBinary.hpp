@@ -0,0 +1,612 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Logger.hpp"
+#include "SequenceFile.hpp"
+
+// Packed sequences (.pcmseq): the notes of a .synthSequence file ready to
+// load without parsing, and everything needed to write the text back byte
+// for byte. Integers are LEB128 varints, signed ones zigzag-coded; a decimal
+// is a signed mantissa and exponent, the number exactly as it was written;
+// a string is a length and its bytes.
+//
+//   "PCMSEQ\0\0", version
+//   lines, notes, entries, start scale, duration scale
+//   entries      each distinct rest of a note line: string synth name,
+//                field count (6-8), decimals timbre frequency amplitude
+//                midiNote attack release [pan [interpolate]]
+//   notes        signed start change from the note before and signed
+//                duration, in ticks of 10^-scale seconds; entry index
+//   verbatim     count, then per line: lines since the last one, whether
+//                it stands in for a note's text, string. Everything the
+//                notes don't reproduce: comments, other events, spacing.
+//
+// Times are exact decimal ticks (10 us or finer for recorded files) rather
+// than sample frames, which would lose the round trip.
+
+const char SEQUENCE_MAGIC[8] = {'P', 'C', 'M', 'S', 'E', 'Q', 0, 0};
+const uint32_t SEQUENCE_VERSION = 1;
+const char* const SEQUENCE_EXTENSION = ".pcmseq";
+const int SEQUENCE_FIELDS = 8; // after the synth name, at most
+
+// The fewest bytes an entry (empty name, field count, six one-byte mantissas
+// and exponents) and a note (three one-byte varints) can be encoded in
+const size_t SEQUENCE_MIN_ENTRY_BYTES = 2 + 6 * 2;
+const size_t SEQUENCE_MIN_NOTE_BYTES = 3;
+
+struct SequenceWriter
+{
+  std::string bytes;
+
+  void varint(uint64_t value)
+  {
+    for (; value >= 0x80; value >>= 7)
+    {
+      bytes += char(value | 0x80);
+    }
+    bytes += char(value);
+  }
+
+  void zigzag(int64_t value) { varint(uint64_t(value) << 1 ^ uint64_t(value >> 63)); }
+
+  void decimal(const Decimal& d)
+  {
+    zigzag(d.mantissa);
+    zigzag(d.exponent);
+  }
+
+  void string(const std::string& text)
+  {
+    varint(text.size());
+    bytes += text;
+  }
+};
+
+// Reads what SequenceWriter wrote; past the end or on a malformed varint,
+// returns zeros and clears `ok`
+struct SequenceReader
+{
+  const uint8_t* at;
+  const uint8_t* last;
+  bool ok = true;
+
+  SequenceReader(const uint8_t* first, size_t size) : at(first), last(first + size) {}
+
+  uint64_t varint()
+  {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64 && at < last; shift += 7)
+    {
+      uint8_t byte = *at++;
+      value |= uint64_t(byte & 0x7f) << shift;
+      if (byte < 0x80)
+      {
+        return value;
+      }
+    }
+    ok = false;
+    return 0;
+  }
+
+  int64_t zigzag()
+  {
+    uint64_t value = varint();
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+  }
+
+  Decimal decimal()
+  {
+    Decimal d;
+    d.mantissa = zigzag();
+    d.exponent = int(std::max<int64_t>(std::min<int64_t>(zigzag(), 100000), -100000));
+    return d;
+  }
+
+  void string(std::string& text)
+  {
+    uint64_t length = varint();
+    if (length > uint64_t(last - at))
+    {
+      ok = false;
+      length = 0;
+    }
+    text.assign(reinterpret_cast<const char*>(at), length);
+    at += length;
+  }
+};
+
+// Everything on a note line after the duration
+struct SequenceEntry
+{
+  std::string name;
+  Decimal fields[SEQUENCE_FIELDS];
+  int fieldCount = 0;
+};
+
+// As an ostream prints a double with its default 6 digits, which is how the
+// sequencer writes, except that longer mantissas keep all their digits
+inline void formatDecimal(Decimal d, std::string& out)
+{
+  d.normalize();
+  if (d.mantissa == 0)
+  {
+    out += '0';
+    return;
+  }
+  if (d.mantissa < 0)
+  {
+    out += '-';
+  }
+
+  char digits[24];
+  int n = snprintf(digits, sizeof(digits), "%llu",
+                   (unsigned long long)(d.mantissa < 0 ? 0 - uint64_t(d.mantissa) : uint64_t(d.mantissa)));
+  int point = d.exponent + n - 1; // power of ten of the first digit
+  if (point < -4 || point >= std::max(n, 6))
+  {
+    char exponent[16];
+    snprintf(exponent, sizeof(exponent), "e%c%02d", point < 0 ? '-' : '+', std::abs(point));
+    out += digits[0];
+    if (n > 1)
+    {
+      out += '.';
+      out.append(digits + 1, n - 1);
+    }
+    out += exponent;
+  }
+  else if (d.exponent >= 0)
+  {
+    out.append(digits, n);
+    out.append(d.exponent, '0');
+  }
+  else if (point >= 0)
+  {
+    out.append(digits, point + 1);
+    out += '.';
+    out.append(digits + point + 1, n - point - 1);
+  }
+  else
+  {
+    out += "0.";
+    out.append(-point - 1, '0');
+    out.append(digits, n);
+  }
+}
+
+// The text after "@ start duration ", trailing space included, as the
+// sequencer writes it
+inline std::string entryText(const SequenceEntry& entry)
+{
+  std::string text = entry.name + " ";
+  for (int i = 0; i < entry.fieldCount; i++)
+  {
+    formatDecimal(entry.fields[i], text);
+    text += ' ';
+  }
+  return text;
+}
+
+// Whether parseSequenceLine keeps a note with this entry: a PCMEnv note with
+// a timbre in 0-255. Files packed before it checked may hold others.
+inline bool entryPlayable(const SequenceEntry& entry)
+{
+  double timbre = decimalValue<double>(entry.fields[0]);
+  return entry.name == "PCMEnv" && entry.fieldCount >= 6 && timbre >= 0 && timbre <= 255;
+}
+
+// What a note with this entry plays, as parseSequenceLine would read it
+inline PatternEvent entryEvent(const SequenceEntry& entry)
+{
+  PatternEvent e;
+  e.timbre = uint8_t(int(decimalValue<double>(entry.fields[0])));
+  e.amplitude = decimalValue<float>(entry.fields[2]);
+  e.note = decimalValue<float>(entry.fields[3]);
+  e.attack = decimalValue<float>(entry.fields[4]);
+  e.release = decimalValue<float>(entry.fields[5]);
+  e.pan = entry.fieldCount > 6 ? decimalValue<float>(entry.fields[6]) : 0;
+  e.interpolate = entry.fieldCount > 7 ? uint8_t(int(decimalValue<double>(entry.fields[7]))) : 0;
+  return e;
+}
+
+// A note line's numbers as written. Accepts the lines parseSequenceLine
+// does, and reads the same fields from them.
+inline bool parseSequenceText(const char* p, const char* end, Decimal& start, Decimal& duration, SequenceEntry& entry)
+{
+  while (p < end && (*p == ' ' || *p == '\t'))
+  {
+    p++;
+  }
+  if (end - p < 2 || p[0] != '@' || (p[1] != ' ' && p[1] != '\t'))
+  {
+    return false;
+  }
+  p++;
+  if (!parseDecimal(p, end, start) || !parseDecimal(p, end, duration))
+  {
+    return false;
+  }
+
+  while (p < end && (*p == ' ' || *p == '\t'))
+  {
+    p++;
+  }
+  const char* name = p;
+  while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+  {
+    p++;
+  }
+  entry.name.assign(name, p - name);
+
+  // timbre and interpolate must be whole; pan and interpolate are optional
+  entry.fieldCount = 0;
+  for (int i = 0; i < SEQUENCE_FIELDS && parseDecimal(p, end, entry.fields[i]); i++)
+  {
+    if ((i == 0 || i == 7) && !isInteger(decimalValue<double>(entry.fields[i])))
+    {
+      break;
+    }
+    entry.fieldCount = i + 1;
+  }
+  return entry.fieldCount >= 6 && entryPlayable(entry);
+}
+
+// mantissa * 10^(exponent + scale), as long as it stays well inside int64
+inline bool decimalTicks(const Decimal& d, int scale, int64_t& ticks)
+{
+  const int64_t LIMIT = 100000000000000000; // 1e17
+  int64_t value = d.mantissa;
+  for (int shift = d.exponent + scale; shift > 0; shift--)
+  {
+    if (value > LIMIT / 10 || value < -LIMIT / 10)
+    {
+      return false;
+    }
+    value *= 10;
+  }
+  ticks = value;
+  return d.exponent + scale >= 0 && value <= LIMIT && value >= -LIMIT;
+}
+
+struct SequenceHeader
+{
+  uint64_t lines = 0, notes = 0;
+  int startScale = 0, durationScale = 0;
+};
+
+// Reads up to the notes, checking the counts against the file's size
+inline bool readSequenceHeader(SequenceReader& reader, SequenceHeader& header, std::vector<SequenceEntry>& entries)
+{
+  size_t size = reader.last - reader.at;
+  if (size < sizeof(SEQUENCE_MAGIC) || memcmp(reader.at, SEQUENCE_MAGIC, sizeof(SEQUENCE_MAGIC)) != 0)
+  {
+    return false;
+  }
+  reader.at += sizeof(SEQUENCE_MAGIC);
+  if (reader.varint() != SEQUENCE_VERSION)
+  {
+    return false;
+  }
+
+  header.lines = reader.varint();
+  header.notes = reader.varint();
+  uint64_t entryCount = reader.varint();
+  header.startScale = int(reader.varint());
+  header.durationScale = int(reader.varint());
+  if (!reader.ok || header.startScale > 40 || header.durationScale > 40)
+  {
+    return false;
+  }
+
+  // Both counts must fit in what's left, before anything is sized by them
+  size_t left = reader.last - reader.at;
+  if (entryCount > left / SEQUENCE_MIN_ENTRY_BYTES ||
+      header.notes > (left - entryCount * SEQUENCE_MIN_ENTRY_BYTES) / SEQUENCE_MIN_NOTE_BYTES)
+  {
+    return false;
+  }
+
+  entries.resize(entryCount);
+  for (SequenceEntry& entry : entries)
+  {
+    reader.string(entry.name);
+    entry.fieldCount = int(reader.varint());
+    if (entry.fieldCount < 6 || entry.fieldCount > SEQUENCE_FIELDS)
+    {
+      return false;
+    }
+    for (int i = 0; i < entry.fieldCount; i++)
+    {
+      entry.fields[i] = reader.decimal();
+    }
+    if (!isInteger(decimalValue<double>(entry.fields[0])) ||
+        (entry.fieldCount > 7 && !isInteger(decimalValue<double>(entry.fields[7]))))
+    {
+      return false;
+    }
+  }
+  return reader.ok;
+}
+
+// Packs a .synthSequence file. Fails only if it can't be read or written,
+// or a note has a number too long to keep exactly (over 18 digits).
+inline bool encodeSequence(const std::string& textPath, const std::string& binaryPath)
+{
+  std::ifstream in(textPath, std::ios::binary);
+  if (!in)
+  {
+    PCM_LOG(LOG_ERROR, "Cannot read ", textPath);
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  std::string text = buffer.str();
+
+  struct Note
+  {
+    Decimal start, duration;
+    uint64_t entry;
+  };
+  std::vector<Note> notes;
+  std::vector<SequenceEntry> entries;
+  std::map<std::string, uint64_t> entryIndex; // by entryText
+  SequenceWriter verbatim;
+  uint64_t lines = 0, verbatimCount = 0, lastVerbatim = 0;
+  int startScale = 0, durationScale = 0;
+
+  const char* at = text.data();
+  const char* last = at + text.size();
+  for (bool more = true; more; lines++)
+  {
+    const char* end = static_cast<const char*>(memchr(at, '\n', last - at));
+    more = end != nullptr;
+    end = more ? end : last;
+
+    Note note;
+    SequenceEntry entry;
+    bool isNote = parseSequenceText(at, end, note.start, note.duration, entry);
+    std::string canonical;
+    if (isNote)
+    {
+      bool exact = note.start.exact && note.duration.exact;
+      for (int i = 0; i < entry.fieldCount; i++)
+      {
+        exact = exact && entry.fields[i].exact;
+        entry.fields[i].normalize();
+      }
+      if (!exact)
+      {
+        PCM_LOG(LOG_ERROR, textPath, ":", lines + 1, ": a number has more digits than can be packed exactly");
+        return false;
+      }
+
+      std::string key = entryText(entry);
+      auto found = entryIndex.find(key);
+      if (found == entryIndex.end())
+      {
+        found = entryIndex.emplace(key, entries.size()).first;
+        entries.push_back(entry);
+      }
+      note.entry = found->second;
+      startScale = std::max(startScale, -note.start.normalize().exponent);
+      durationScale = std::max(durationScale, -note.duration.normalize().exponent);
+      notes.push_back(note);
+
+      canonical = "@ ";
+      formatDecimal(note.start, canonical);
+      canonical += ' ';
+      formatDecimal(note.duration, canonical);
+      canonical += ' ';
+      canonical += key;
+    }
+
+    if (!isNote || canonical.size() != size_t(end - at) || memcmp(canonical.data(), at, end - at) != 0)
+    {
+      verbatim.varint(lines - lastVerbatim);
+      verbatim.varint(isNote);
+      verbatim.string(std::string(at, end));
+      lastVerbatim = lines;
+      verbatimCount++;
+    }
+    at = end + more;
+  }
+
+  SequenceWriter out;
+  out.bytes.assign(SEQUENCE_MAGIC, sizeof(SEQUENCE_MAGIC));
+  out.varint(SEQUENCE_VERSION);
+  out.varint(lines);
+  out.varint(notes.size());
+  out.varint(entries.size());
+  out.varint(startScale);
+  out.varint(durationScale);
+  for (const SequenceEntry& entry : entries)
+  {
+    out.string(entry.name);
+    out.varint(entry.fieldCount);
+    for (int i = 0; i < entry.fieldCount; i++)
+    {
+      out.decimal(entry.fields[i]);
+    }
+  }
+
+  int64_t previous = 0;
+  for (const Note& note : notes)
+  {
+    int64_t start, duration;
+    if (!decimalTicks(note.start, startScale, start) || !decimalTicks(note.duration, durationScale, duration))
+    {
+      PCM_LOG(LOG_ERROR, textPath, ": times span too many digits to pack");
+      return false;
+    }
+    out.zigzag(start - previous);
+    out.zigzag(duration);
+    out.varint(note.entry);
+    previous = start;
+  }
+  out.varint(verbatimCount);
+  out.bytes += verbatim.bytes;
+
+  std::ofstream file(binaryPath, std::ios::binary);
+  bool ok = bool(file.write(out.bytes.data(), out.bytes.size()).flush());
+  PCM_LOG(ok ? LOG_INFO : LOG_ERROR, ok ? "Wrote " : "Failed writing ", binaryPath, ": ", notes.size(), " notes, ",
+          entries.size(), " parameter sets, ", text.size(), " bytes of text in ", out.bytes.size());
+  return ok;
+}
+
+// Writes a packed sequence back out as the text it was packed from
+inline bool decodeSequence(const std::string& binaryPath, const std::string& textPath)
+{
+  MappedFile file(binaryPath);
+  SequenceReader reader(file.bytes, file.size);
+  SequenceHeader header;
+  std::vector<SequenceEntry> entries;
+  if (!file.valid() || !readSequenceHeader(reader, header, entries))
+  {
+    PCM_LOG(LOG_ERROR, "Cannot read ", binaryPath, ": not a packed sequence");
+    return false;
+  }
+
+  std::vector<std::string> texts;
+  for (const SequenceEntry& entry : entries)
+  {
+    texts.push_back(entryText(entry));
+  }
+
+  struct Note
+  {
+    int64_t start, duration;
+    uint64_t entry;
+  };
+  std::vector<Note> notes(header.notes);
+  int64_t start = 0;
+  for (Note& note : notes)
+  {
+    start += reader.zigzag();
+    note = {start, reader.zigzag(), reader.varint()};
+    reader.ok = reader.ok && note.entry < entries.size();
+  }
+
+  // Lines in order: verbatim where one was kept, otherwise the next note
+  std::string text;
+  uint64_t verbatimLeft = reader.varint();
+  uint64_t nextVerbatim = verbatimLeft ? reader.varint() : header.lines;
+  size_t next = 0;
+  for (uint64_t line = 0; line < header.lines && reader.ok; line++)
+  {
+    text += line ? "\n" : "";
+    if (line == nextVerbatim)
+    {
+      bool replacesNote = reader.varint() != 0;
+      std::string kept;
+      reader.string(kept);
+      text += kept;
+      next += replacesNote;
+      nextVerbatim = --verbatimLeft ? line + reader.varint() : header.lines;
+    }
+    else if (next < notes.size())
+    {
+      Decimal d;
+      text += "@ ";
+      d.mantissa = notes[next].start;
+      d.exponent = -header.startScale;
+      formatDecimal(d, text);
+      text += ' ';
+      d.mantissa = notes[next].duration;
+      d.exponent = -header.durationScale;
+      formatDecimal(d, text);
+      text += ' ';
+      text += texts[notes[next++].entry];
+    }
+    else
+    {
+      reader.ok = false;
+    }
+  }
+  if (!reader.ok || next != notes.size() || verbatimLeft != 0)
+  {
+    PCM_LOG(LOG_ERROR, "Cannot read ", binaryPath, ": corrupt");
+    return false;
+  }
+
+  std::ofstream out(textPath, std::ios::binary);
+  bool ok = bool(out.write(text.data(), text.size()).flush());
+  PCM_LOG(ok ? LOG_INFO : LOG_ERROR, ok ? "Wrote " : "Failed writing ", textPath, ": ", notes.size(), " notes");
+  return ok;
+}
+
+// readSynthSequence for a packed file: the same notes, without parsing
+inline double loadSequenceBinary(const std::string& path, std::vector<PatternEvent>& events, double offset = 0)
+{
+  MappedFile file(path);
+  SequenceReader reader(file.bytes, file.size);
+  SequenceHeader header;
+  std::vector<SequenceEntry> entries;
+  if (!file.valid() || !readSequenceHeader(reader, header, entries))
+  {
+    return -1;
+  }
+
+  std::vector<PatternEvent> played;
+  std::vector<bool> playable;
+  for (const SequenceEntry& entry : entries)
+  {
+    played.push_back(entryEvent(entry));
+    playable.push_back(entryPlayable(entry));
+  }
+
+  size_t used = events.size();
+  reserveEvents(events, header.notes);
+  double end = offset;
+  Decimal start, duration;
+  start.exponent = -header.startScale;
+  duration.exponent = -header.durationScale;
+  for (uint64_t i = 0; i < header.notes; i++)
+  {
+    start.mantissa += reader.zigzag();
+    duration.mantissa = reader.zigzag();
+    uint64_t entry = reader.varint();
+    if (!reader.ok || entry >= played.size())
+    {
+      events.resize(used);
+      return -1;
+    }
+    if (!playable[entry])
+    {
+      continue;
+    }
+
+    double seconds = decimalValue<double>(start), length = decimalValue<double>(duration);
+    PatternEvent e = played[entry];
+    e.start = seconds + offset;
+    e.duration = float(length);
+    events.push_back(e);
+    end = std::max(end, seconds + offset + length);
+  }
+  return end;
+}
+
+inline bool isPackedSequence(const std::string& path)
+{
+  size_t length = strlen(SEQUENCE_EXTENSION);
+  return path.size() >= length && path.compare(path.size() - length, length, SEQUENCE_EXTENSION) == 0;
+}
+
+// A .synthSequence or .pcmseq file, by its extension
+inline double loadSequence(const std::string& path, std::vector<PatternEvent>& events, double offset = 0)
+{
+  return isPackedSequence(path) ? loadSequenceBinary(path, events, offset) : readSynthSequence(path, events, offset);
+}
+
+// Packs or unpacks, whichever way makes `to` its extension's kind
+inline bool convertSequence(const std::string& from, const std::string& to)
+{
+  return isPackedSequence(to) ? encodeSequence(from, to) : decodeSequence(from, to);
+}
@@ -0,0 +1,393 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "Pattern.hpp"
+
+// parseDecimal is the inner loop of every load; a call per field costs a third
+#if defined(__GNUC__)
+#define PCM_INLINE inline __attribute__((always_inline))
+#else
+#define PCM_INLINE inline
+#endif
+
+// Loading .synthSequence files as allolib's SynthSequencer writes them for
+// PCMEnv, one note a line:
+//
+//   @ start duration PCMEnv timbre frequency amplitude midiNote attack release pan interpolate
+//
+// The file is mapped and parsed in place: no line or field is copied into a
+// std::string, and the output is sized once from the line count, so loading
+// into a table or vector that already has the room allocates nothing.
+
+// A number as written, mantissa * 10^exponent. Inexact when digits past the
+// 18th had to be dropped.
+struct Decimal
+{
+  int64_t mantissa = 0;
+  int exponent = 0;
+  bool exact = true;
+
+  // The one form of each value: no trailing zeros in the mantissa, and 0e0
+  Decimal& normalize()
+  {
+    for (; mantissa != 0 && mantissa % 10 == 0; mantissa /= 10)
+    {
+      exponent++;
+    }
+    exponent = mantissa ? exponent : 0;
+    return *this;
+  }
+};
+
+// Reads a number at `at` (after spaces), in the manner of std::from_chars,
+// which the C++14 build doesn't have: no locale, no copy, and `at` is left
+// just past it. It must end at whitespace or `last`.
+PCM_INLINE bool parseDecimal(const char*& at, const char* last, Decimal& d)
+{
+  const char* p = at;
+  while (p < last && (*p == ' ' || *p == '\t' || *p == '\r'))
+  {
+    p++;
+  }
+
+  bool negative = p < last && *p == '-';
+  if (p < last && (*p == '-' || *p == '+'))
+  {
+    p++;
+  }
+
+  uint64_t mantissa = 0;
+  int exponent = 0, significant = 0;
+  bool digits = false, exact = true;
+  for (; p < last && unsigned(*p - '0') < 10; p++, digits = true)
+  {
+    if (significant < 18)
+    {
+      mantissa = mantissa * 10 + unsigned(*p - '0');
+      significant += mantissa != 0;
+    }
+    else
+    {
+      exact = exact && *p == '0';
+      exponent++;
+    }
+  }
+  if (p < last && *p == '.')
+  {
+    for (p++; p < last && unsigned(*p - '0') < 10; p++, digits = true)
+    {
+      if (significant < 18)
+      {
+        mantissa = mantissa * 10 + unsigned(*p - '0');
+        significant += mantissa != 0;
+        exponent--;
+      }
+      else
+      {
+        exact = exact && *p == '0';
+      }
+    }
+  }
+  if (!digits)
+  {
+    return false;
+  }
+  if (p < last && (*p == 'e' || *p == 'E'))
+  {
+    const char* e = p + 1;
+    bool negativeExponent = e < last && *e == '-';
+    if (e < last && (*e == '-' || *e == '+'))
+    {
+      e++;
+    }
+    if (e < last && unsigned(*e - '0') < 10)
+    {
+      int written = 0;
+      for (; e < last && unsigned(*e - '0') < 10; e++)
+      {
+        written = std::min(written * 10 + (*e - '0'), 100000);
+      }
+      exponent += negativeExponent ? -written : written;
+      p = e;
+    }
+  }
+  if (p < last && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+  {
+    return false;
+  }
+
+  d.mantissa = negative ? -int64_t(mantissa) : int64_t(mantissa);
+  d.exponent = exponent;
+  d.exact = exact;
+  at = p;
+  return true;
+}
+
+// Rounded by the C library, for decimalValue below
+inline double decimalValueSlow(const Decimal& d, bool single)
+{
+  char text[32];
+  snprintf(text, sizeof(text), "%lldE%d", (long long)d.mantissa, d.exponent);
+  return single ? strtof(text, nullptr) : strtod(text, nullptr);
+}
+
+// The nearest float or double. Mantissas that fit the type's precision with
+// exponents whose powers of ten it holds exactly, which covers the up to 6
+// significant digits the sequencer writes, take one multiply or divide;
+// anything else goes to strtof/strtod.
+template <typename T>
+inline T decimalValue(const Decimal& d)
+{
+  static const T POWERS[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                             1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  const bool single = sizeof(T) == sizeof(float);
+  const uint64_t maxMantissa = single ? uint64_t(1) << 24 : uint64_t(1) << 53;
+  const int maxExponent = single ? 10 : 22;
+
+  uint64_t mantissa = d.mantissa < 0 ? 0 - uint64_t(d.mantissa) : uint64_t(d.mantissa);
+  if (mantissa <= maxMantissa && d.exponent >= -maxExponent && d.exponent <= maxExponent)
+  {
+    return d.exponent < 0 ? T(d.mantissa) / POWERS[-d.exponent] : T(d.mantissa) * POWERS[d.exponent];
+  }
+  return T(decimalValueSlow(d, single));
+}
+
+template <typename T>
+inline bool parseNumber(const char*& at, const char* last, T& value)
+{
+  const char* first = at;
+  Decimal d;
+  if (!parseDecimal(at, last, d))
+  {
+    return false;
+  }
+  if (d.exact)
+  {
+    value = decimalValue<T>(d);
+    return true;
+  }
+
+  // More digits than a Decimal keeps: let the C library round them all
+  char text[64];
+  while (*first == ' ' || *first == '\t' || *first == '\r')
+  {
+    first++;
+  }
+  size_t length = std::min(size_t(at - first), sizeof(text) - 1);
+  memcpy(text, first, length);
+  text[length] = 0;
+  value = sizeof(T) == sizeof(float) ? T(strtof(text, nullptr)) : T(strtod(text, nullptr));
+  return true;
+}
+
+// Timbres and interpolation modes: whole numbers only
+inline bool isInteger(double number) { return number >= -1e9 && number <= 1e9 && number == double(int(number)); }
+
+inline bool parseInteger(const char*& at, const char* last, int& value)
+{
+  double number;
+  const char* p = at;
+  if (!parseNumber(p, last, number) || !isInteger(number))
+  {
+    return false;
+  }
+  value = int(number);
+  at = p;
+  return true;
+}
+
+// One note line from `at`, which is left at the start of the next line.
+// False for anything else: comments, other event kinds, other synths' notes,
+// timbres outside 0-255, malformed lines.
+inline bool parseSequenceLine(const char*& at, const char* last, double& start, double& duration, PatternEvent& e)
+{
+  const char* end = static_cast<const char*>(memchr(at, '\n', last - at));
+  end = end ? end : last;
+  const char* p = at;
+  at = end < last ? end + 1 : last;
+
+  while (p < end && (*p == ' ' || *p == '\t'))
+  {
+    p++;
+  }
+  if (end - p < 2 || p[0] != '@' || (p[1] != ' ' && p[1] != '\t'))
+  {
+    return false;
+  }
+  p++;
+  if (!parseNumber(p, end, start) || !parseNumber(p, end, duration))
+  {
+    return false;
+  }
+
+  // The synth's name: only PCMEnv notes are played
+  while (p < end && (*p == ' ' || *p == '\t'))
+  {
+    p++;
+  }
+  const char* name = p;
+  while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+  {
+    p++;
+  }
+  if (p - name != 6 || memcmp(name, "PCMEnv", 6) != 0)
+  {
+    return false;
+  }
+
+  int timbre;
+  float frequency;
+  if (!parseInteger(p, end, timbre) || timbre < 0 || timbre > 255 || !parseNumber(p, end, frequency) ||
+      !parseNumber(p, end, e.amplitude) || !parseNumber(p, end, e.note) || !parseNumber(p, end, e.attack) ||
+      !parseNumber(p, end, e.release))
+  {
+    return false;
+  }
+
+  int interpolate = 0;
+  e.pan = 0;
+  if (parseNumber(p, end, e.pan)) // optional, as is interpolate
+  {
+    parseInteger(p, end, interpolate);
+  }
+  e.timbre = uint8_t(timbre);
+  e.interpolate = uint8_t(interpolate);
+  return true;
+}
+
+// Every note line of `path`, `offset` seconds later: reserve(lines) with an
+// upper bound on the count, then add(event) for each, in file order.
+// Returns when the last note ends, or -1 if the file can't be read.
+template <typename Reserve, typename Add>
+double scanSynthSequence(const std::string& path, double offset, Reserve reserve, Add add)
+{
+  MappedFile file(path);
+  if (!file.valid())
+  {
+    return std::ifstream(path) ? offset : -1; // empty files can't be mapped
+  }
+
+  const char* at = reinterpret_cast<const char*>(file.bytes);
+  const char* last = at + file.size;
+  size_t lines = 1;
+  for (const char* p = at; (p = static_cast<const char*>(memchr(p, '\n', last - p))); p++)
+  {
+    lines++;
+  }
+  reserve(lines);
+
+  double end = offset;
+  while (at < last)
+  {
+    double start, duration;
+    PatternEvent e;
+    if (parseSequenceLine(at, last, start, duration, e))
+    {
+      e.start = start + offset;
+      e.duration = float(duration);
+      add(e);
+      end = std::max(end, start + offset + duration);
+    }
+  }
+  return end;
+}
+
+// Room for `more` events, still growing geometrically when files are loaded
+// one after another
+inline void reserveEvents(std::vector<PatternEvent>& events, size_t more)
+{
+  if (events.capacity() < events.size() + more)
+  {
+    events.reserve(std::max(events.size() + more, events.capacity() * 2));
+  }
+}
+
+// Appends the notes of `path` to `events` without sorting: load every file
+// of an arrangement, then sort once (PatternBuffer::finish). Voices come
+// from the synth's pool when a note fires, not here.
+inline double readSynthSequence(const std::string& path, std::vector<PatternEvent>& events, double offset = 0)
+{
+  return scanSynthSequence(
+    path, offset, [&events](size_t lines) { reserveEvents(events, lines); },
+    [&events](const PatternEvent& e) { events.push_back(e); });
+}
+
+// Notes as a column per field, for long recordings that are scanned or
+// edited a field at a time (every start, every note) rather than played
+// straight away. The columns keep their capacity across clear().
+struct SequenceTable
+{
+  std::vector<double> start;
+  std::vector<float> duration, note, amplitude, attack, release, pan;
+  std::vector<uint8_t> timbre, interpolate;
+
+  size_t size() const { return count; }
+
+  void clear() { resize(0); }
+
+  void resize(size_t size)
+  {
+    start.resize(size);
+    for (std::vector<float>* column : {&duration, &note, &amplitude, &attack, &release, &pan})
+    {
+      column->resize(size);
+    }
+    timbre.resize(size);
+    interpolate.resize(size);
+    count = size;
+  }
+
+  void set(size_t i, const PatternEvent& e)
+  {
+    start[i] = e.start;
+    duration[i] = e.duration;
+    note[i] = e.note;
+    amplitude[i] = e.amplitude;
+    attack[i] = e.attack;
+    release[i] = e.release;
+    pan[i] = e.pan;
+    timbre[i] = e.timbre;
+    interpolate[i] = e.interpolate;
+  }
+
+  PatternEvent event(size_t i) const
+  {
+    PatternEvent e;
+    e.start = start[i];
+    e.duration = duration[i];
+    e.note = note[i];
+    e.amplitude = amplitude[i];
+    e.attack = attack[i];
+    e.release = release[i];
+    e.pan = pan[i];
+    e.timbre = timbre[i];
+    e.interpolate = interpolate[i];
+    return e;
+  }
+
+private:
+  size_t count = 0;
+};
+
+// Appends the notes of `path` to `table`, as readSynthSequence does
+inline double loadSynthSequence(const std::string& path, SequenceTable& table, double offset = 0)
+{
+  size_t used = table.size();
+  double end = scanSynthSequence(
+    path, offset, [&table, used](size_t lines) { table.resize(used + lines); },
+    [&table, &used](const PatternEvent& e) { table.set(used++, e); });
+  if (end >= 0)
+  {
+    table.resize(used);
+  }
+  return end;
+}
@@ -0,0 +1,1052 @@
+#pragma once
+
+#include "Pattern.hpp"
+
+// The song oldMain.cpp plays, written in Pattern's n/d/c/r vocabulary and
+// compiled into SONG at build time. patterns/*.pattern is the same song as
+// text, played with oldMain's `--patterns patterns` (PatternText.hpp).
+
+// Drum kit sample IDs, in the order of drumKit's file list in oldMain.cpp
+enum Drum
+{
+  KICK_POP, KICK_DAC, KICK_SK,
+  SNARE_DAC, CLAP_POP,
+  HAT_DANCE, HAT_DAC, HAT_SK,
+  SLAP_POP, SLIDE_POP, SLIDE_POP_OFFSET,
+  CRASH_LO, CRASH_HI,
+  SFX_BELL, SFX_BOWL_LO, SFX_BOWL_HI, SFX_BREATH, SFX_DROP_LO, SFX_DROP_HI,
+  SFX_GOURD, SFX_LOTUSBEND, SFX_MK939, SFX_SHAKE_OFFSET, SFX_SHAKE
+};
+
+constexpr float TRIPLET = (1.f/12.f)*8.f;
+
+// The names patterns/*.pattern files use for the above; give these to a PatternLibrary
+template <class Library>
+void defineSongNames(Library& library)
+{
+  static const char* DRUMS[] = {
+    "KICK_POP", "KICK_DAC", "KICK_SK",
+    "SNARE_DAC", "CLAP_POP",
+    "HAT_DANCE", "HAT_DAC", "HAT_SK",
+    "SLAP_POP", "SLIDE_POP", "SLIDE_POP_OFFSET",
+    "CRASH_LO", "CRASH_HI",
+    "SFX_BELL", "SFX_BOWL_LO", "SFX_BOWL_HI", "SFX_BREATH", "SFX_DROP_LO", "SFX_DROP_HI",
+    "SFX_GOURD", "SFX_LOTUSBEND", "SFX_MK939", "SFX_SHAKE_OFFSET", "SFX_SHAKE"
+  };
+  static_assert(sizeof(DRUMS) / sizeof(DRUMS[0]) == SFX_SHAKE + 1, "one name per Drum");
+  for (int i = 0; i <= SFX_SHAKE; i++)
+  {
+    library.define(DRUMS[i], i);
+  }
+  library.define("TRIPLET", TRIPLET);
+}
+
+template <class P>
+constexpr void pt_intro_pianolo(P& p)
+{
+  p.timbre = 5;
+  p.interpolate = INTERP_NONE;
+  p.release = 1;
+  p.strength = 1;
+  p.tune = -12;
+
+  p.n(33, 6);
+  p.n(40, 10, 10);
+  p.n(26, 12);
+  p.n(28, 9);
+  p.n(29, 6, -1);
+  p.n(36, 3);
+  p.n(45, 8);
+  p.n(28, 8, 9 + (16 * 3));
+}
+
+template <class P>
+constexpr void pt_intro_pianohi(P& p)
+{
+  p.timbre = 0;
+  p.interpolate = INTERP_NONE;
+  p.release = 20;
+  p.strength = 3;
+  p.tune = -12;
+  p.r(3);
+
+  p.n(81, 5);
+
+  p.n(91, TRIPLET);
+  p.n(86, TRIPLET);
+  p.n(88, TRIPLET);
+  p.n(84, TRIPLET);
+  p.n(86, TRIPLET);
+  p.n(81, TRIPLET);
+  p.n(84, TRIPLET);
+  p.n(79, TRIPLET);
+  p.n(81, TRIPLET);
+  p.n(74, TRIPLET);
+  p.n(76, TRIPLET, TRIPLET * 2);
+
+  p.n(87, TRIPLET, TRIPLET * 4);
+  p.r(4 * 3);
+  p.r(16 * 2);
+  p.r(7);
+  p.n(76, 1, 8);
+  p.r(16 * 3);
+}
+
+template <class P>
+constexpr void pt_intro_pizz(P& p)
+{
+  p.timbre = 4;
+  p.interpolate = INTERP_NONE;
+  p.release = 50;
+  p.strength = 1;
+  p.tune = -12;
+  p.r(6);
+
+  p.n(57);
+  p.n(64, 0.5);
+  p.n(67, 0.5);
+  p.n(69, 1, 7 + 7.5);
+  p.n(67, 0.5, 2);
+  p.n(73, 0.5, 1);
+  p.n(62, 0.5, 0.5);
+  p.n(74, 0.5, 0.5);
+  p.n(79, 0.5, 0.5);
+  p.n(59, 0.5, 2);
+  p.n(72, 1, 3);
+  p.n(84, 1, 10 + 12);
+  p.n(56, 1, 3);
+  p.r(64);
+}
+
+template <class P>
+constexpr void pt_intro_str(P& p)
+{
+  p.timbre = 2;
+  p.interpolate = INTERP_NONE;
+  p.release = 0.625;
+  p.strength = 0.75;
+  p.tune = -12 + 15.f/100.f;
+  p.r(6);
+
+  p.n(95, 1, 4);
+  p.n(57, 9, 6);
+
+  // Chords
+  p.c(53, 10);
+  p.c(57, 10);
+  p.c(60, 10);
+  p.c(64, 10);
+  p.n(50, 10);
+
+  p.c(55, 11);
+  p.c(57, 11);
+  p.c(59, 11);
+  p.c(62, 11);
+  p.c(64, 11);
+  p.n(52, 11);
+
+  p.c(53, 11);
+  p.c(57, 11);
+  p.c(60, 11);
+  p.c(62, 11);
+  p.c(64, 11);
+  p.c(67, 11);
+  p.r(2);
+
+  p.n(72, 3, 1);
+  p.n(83, 4, -2);
+  p.n(72, 8, -3);
+
+  p.c(67, 17);
+  p.r(2);
+  p.c(55, 13);
+  p.c(59, 13);
+  p.c(64, 13);
+  p.c(69, 13);
+  p.n(52, 13, 5);
+
+  p.r(16 * 3);
+}
+
+template <class P>
+constexpr void pt_intro_pianomid(P& p)
+{
+  p.timbre = 1;
+  p.interpolate = INTERP_LINEAR;
+  p.release = 20;
+  p.strength = 1;
+  p.tune = -7.f/100.f;
+  p.r(14);
+
+  p.c(69, 16);
+  p.r(5);
+  p.n(71, 11, -4);
+  p.n(79, 4);
+  p.r(8);
+  p.n(88, 1, 5);
+  p.n(93, 1, 11);
+  p.n(81, 3);
+  p.n(76, 4);
+  p.n(79, 4);
+  p.n(74, 13);
+  p.r(8);
+  p.n(69, 8);
+
+  p.r(16 * 2);
+}
+
+template <class P>
+constexpr void pt_intro_pianolegato(P& p)
+{
+  p.timbre = 5;
+  p.interpolate = INTERP_NONE;
+  p.release = 20;
+  p.strength = 1;
+  p.tune = -12.2f;
+  p.r(27);
+
+  p.n(74, 4, -2);
+  p.n(69, 4, -2);
+  p.n(76, 4, -2);
+  p.n(79, 4, -2);
+  p.n(84, 4, -2);
+  p.n(79, 4, 1);
+  p.n(81, 4, 2);
+
+  p.c(60, 4);
+  p.r(1.5);
+  p.c(62, 4);
+  p.r(0.5);
+  p.c(64, 4);
+  p.r(0.5);
+  p.c(69, 4);
+  p.r(0.5);
+  p.c(76, 4);
+  p.r(0.5);
+  p.c(79, 4);
+  p.r(1);
+  p.n(84, 4.5, 2);
+
+  p.n(76, 4, -1);
+  p.n(79, 4, -1);
+  p.n(84, 4, -2);
+  p.n(72, 4, -1);
+  p.c(55, 30);
+  p.r(1);
+  p.n(69, 4, 2);
+  p.n(52, 3 + 16);
+
+  p.r(16 * 2);
+}
+
+template <class P>
+constexpr void pt_intro_fx_doorbell(P& p)
+{
+  p.timbre = 7;
+  p.interpolate = INTERP_LINEAR;
+  p.release = 20;
+  p.strength = 4;
+  p.tune = 0;
+  p.r(11);
+
+  p.n(64, 3, 2);
+  p.r(5);
+  p.n(85, 1, 2);
+  p.n(81, 2, 6);
+  p.r(16 * 6);
+}
+
+template <class P>
+constexpr void pt_intro_fx_arp(P& p)
+{
+  p.timbre = 15;
+  p.interpolate = INTERP_LINEAR;
+  p.release = 10;
+  p.strength = 10;
+  p.tune = -12;
+
+  p.r(16);
+  p.n(81);
+  p.n(84);
+  p.n(79);
+  p.n(81);
+  p.n(76);
+  p.n(79);
+  p.n(74);
+  p.n(76);
+  p.n(72);
+  p.n(74);
+  p.n(69);
+  p.n(72);
+  p.n(74);
+  p.n(79);
+  p.n(81);
+  p.n(84);
+  p.n(91, 16, 8);
+  p.n(81, 3);
+  p.n(76, 2);
+
+  p.strength = 15;
+  p.n(79, 3);
+
+  p.r(16 * 4);
+}
+
+template <class P>
+constexpr void pt_intro_fx_enchant(P& p)
+{
+  p.timbre = 8;
+  p.interpolate = INTERP_LINEAR;
+  p.release = 0.15;
+  p.tune = -24;
+  p.r(7);
+
+  p.strength = 15;
+  p.n(71, 2, 9);
+  p.strength = 6;
+  p.n(91, 7);
+  p.n(90, 3);
+  p.n(89, 3);
+  p.n(88, 7, 10);
+  p.r(16 * 3);
+
+  p.r(11);
+  p.n(64, 5 + 12);
+  
+  p.r(4);
+}
+
+template <class P>
+constexpr void pt_intro_fx_lead(P& p)
+{
+  p.timbre = 11;
+  p.interpolate = INTERP_LINEAR;
+  p.release = 10;
+  p.strength = 5;
+  p.tune = -12;
+
+  p.r(20);
+  p.n(79, 13, -7);
+  p.n(81, 13, -7);
+  p.n(86, 13, -5);
+  p.n(91, 13);
+  p.n(91, 13, -2);
+
+  p.r(16 + 4);
+
+  p.n(79, 13, -7);
+  p.n(81, 13, -7);
+  p.n(86, 13, -5);
+  p.n(91, 13);
+  p.n(93, 7, 4);
+}
+
+template <class P>
+constexpr void pt_intro_fx_corrode(P& p)
+{
+  p.timbre = 6;
+  p.interpolate = INTERP_LINEAR;
+  p.release = 50;
+  p.strength = 10;
+  p.tune = -12;
+
+  p.r(56);
+  p.n(69, 3);
+  p.n(64, 3);
+  p.n(67, 4);
+  p.n(62, 10, 4);
+  p.r(16 * 3);
+}
+
+template <class P>
+constexpr void pt_bass(P& p, bool funky_ending=false, bool funky_intro=false)
+{
+  if (funky_intro)
+  {
+    p.n(28, 1, 1);
+    p.n(28, 2, 1);
+    p.n(28, 1, 1);
+    p.n(28, 1, 3);
+    p.n(28, 1, 1);
+  }
+  else
+  {
+    p.n(26, 1, 1);
+    p.n(26, 2, 1);
+    p.n(26, 1, 1);
+    p.n(26, 1, 3);
+    p.n(26, 1, 1);
+  }
+  
+  p.n(31);
+  p.n(35);
+  p.n(38);
+
+  p.n(29, 1, 1);
+  p.n(29, 2, 1);
+  p.n(29, 1, 1);
+  p.n(29, 1, 2);
+  p.n(29);
+  p.n(19);
+  p.n(29);
+  p.n(24, 1, 1);
+  p.n(30);
+
+  p.n(31, 1, 1);
+  p.n(31, 2, 2);
+  p.n(31);
+  p.n(31, 1, 2);
+  p.n(31);
+  p.n(36, 2);
+  p.n(40);
+  p.n(43);
+  p.n(45);
+
+  if (!funky_ending)
+  {
+    p.n(26, 2);
+    p.n(26, 2, 1);
+    p.n(26, 1, 1);
+    p.n(26, 1, 2);
+    p.n(33, 1, 1);
+  }
+  else
+  {
+    p.n(26, 2);
+    p.n(26, 2);
+    p.n(38);
+    p.n(26);
+    p.n(50);
+    p.n(44);
+    p.n(48);
+    p.n(49);
+    p.n(49, 0.5, -0.5);
+    p.n(50, 2);
+  }
+
+  // bass slide
+  p.n(41, 0.5);
+  p.n(43, 0.5);
+  p.n(44, 0.5, -0.5);
+  p.n(37, 0.5);
+  p.n(31, 0.5);
+  p.n(25, 0.5);
+  p.n(21, 0.5);
+  p.n(20, 0.5);
+  p.n(17, 0.5);
+}
+
+template <class P>
+constexpr void pt_bass_simple(P& p)
+{
+  p.n(26, 4, 1);
+  p.n(26, 1, 1);
+  p.n(26, 5);
+  p.n(36, 2);
+  p.n(38, 2);
+
+  p.n(29, 4, 1);
+  p.n(29, 1, 1);
+  p.n(29, 5);
+  p.n(36, 2);
+  p.n(38, 2);
+
+  p.n(33, 4, 1);
+  p.n(33, 1, 1);
+  p.n(33, 5);
+  p.n(45, 2);
+  p.n(38, 2);
+
+  p.n(26, 4, 1);
+  p.n(26, 1, 1);
+  p.n(26, 2, 1);
+  p.n(26, 2);
+  p.n(36);
+  p.n(43);
+  p.n(38);
+  p.n(29);
+}
+
+template <class P>
+constexpr void pt_chord_progression(P& p)
+{
+  p.c(50);
+  p.c(53);
+  p.c(57);
+  p.c(60);
+  p.c(64);
+  p.n(38, 16);
+
+  p.c(55);
+  p.c(57);
+  p.c(60);
+  p.c(64);
+  p.n(41, 16);
+
+  p.c(50);
+  p.c(55);
+  p.c(57);
+  p.c(59);
+  p.c(64);
+  p.n(43, 16);
+
+  p.c(52);
+  p.c(53);
+  p.c(55);
+  p.c(57);
+  p.c(60);
+  p.n(38, 16);
+}
+
+template <class P>
+constexpr void pt_pluck_chord(P& p, int measure, int gap=0)
+{
+  switch (measure)
+  {
+  default:
+    p.c(50, 3);
+    p.c(53, 3);
+    p.c(57, 3);
+    p.c(60, 3);
+    p.c(64, 3);
+    p.n(38, 3, gap);
+    break;
+  case 1:
+    p.c(55, 3);
+    p.c(57, 3);
+    p.c(60, 3);
+    p.c(64, 3);
+    p.n(41, 3, gap);
+    break;
+  case 2:
+    p.c(50, 3);
+    p.c(55, 3);
+    p.c(57, 3);
+    p.c(59, 3);
+    p.c(64, 3);
+    p.n(43, 3, gap);
+    break;
+  case 3:
+    p.c(52, 3);
+    p.c(53, 3);
+    p.c(55, 3);
+    p.c(57, 3);
+    p.c(60, 3);
+    p.n(38, 3, gap);
+  }
+}
+
+template <class P>
+constexpr void pt_pluck_chords(P& p)
+{
+  pt_pluck_chord(p, 0);
+  pt_pluck_chord(p, 0, 1);
+  pt_pluck_chord(p, 0);
+  pt_pluck_chord(p, 0, 3);
+
+  pt_pluck_chord(p, 1);
+  pt_pluck_chord(p, 1, 1);
+  pt_pluck_chord(p, 1);
+  pt_pluck_chord(p, 1, 3);
+
+  pt_pluck_chord(p, 2);
+  pt_pluck_chord(p, 2, 1);
+  pt_pluck_chord(p, 2);
+  pt_pluck_chord(p, 2, 3);
+
+  pt_pluck_chord(p, 3);
+  pt_pluck_chord(p, 3, 1);
+  pt_pluck_chord(p, 3);
+  pt_pluck_chord(p, 3, 3);
+}
+
+template <class P>
+constexpr void pt_drum_intro(P& p)
+{
+  p.strength = 2.25;
+  ////////////////////////////////
+  p.r(16 * 2);
+  p.r(1.5);
+
+  p.d(SFX_MK939, 0.5);
+
+  p.r(5.5);
+
+  p.d(SFX_LOTUSBEND, 6.5, 6.5);
+  p.d(KICK_DAC, 0.5);
+  p.d(KICK_DAC, 0.5);
+  p.d(KICK_DAC);
+  p.d(CRASH_LO, 1);
+  
+  p.r(16 * 4);
+  p.r(12);
+
+  p.d(KICK_SK);
+  p.d(SNARE_DAC, 2);
+  p.d(KICK_SK, 2);
+}
+
+template <class P>
+constexpr void pt_drum_chorus(P& p)
+{
+  p.strength = 2.25;
+  ////////////////////////////////
+
+  p.d(CRASH_LO);
+  p.d(KICK_POP, 4);
+  //
+  p.d(KICK_POP);
+  p.d(CLAP_POP, 4);
+  //
+  p.d(KICK_POP, 4);
+  //
+  p.d(KICK_POP);
+  p.d(CLAP_POP);
+  p.d(SLIDE_POP_OFFSET);
+  p.d(SLAP_POP, 2);
+
+  p.d(SLIDE_POP);
+  p.d(CLAP_POP, 1);
+
+  p.d(KICK_POP, 1);
+
+  ////////////////
+
+  p.d(KICK_POP, 4);
+  //
+  p.d(KICK_POP);
+  p.d(CLAP_POP, 4);
+  //
+  p.d(KICK_POP, 3);
+  //
+  p.d(CLAP_POP);
+  p.d(SLAP_POP, 0.5);
+  p.d(SLAP_POP, 0.5);
+
+  p.d(KICK_POP);
+  p.d(CLAP_POP);
+  p.d(SLAP_POP, 1);
+  p.d(CLAP_POP, 1);
+  p.d(CLAP_POP);
+  p.d(SLAP_POP, 1);
+  p.d(CLAP_POP);
+  p.d(KICK_POP, 1);
+
+  ////////////////
+
+  p.d(KICK_POP, 4);
+  //
+  p.d(KICK_POP);
+  p.d(CLAP_POP, 4);
+  //
+  p.d(KICK_POP, 4);
+  //
+  p.d(KICK_POP);
+  p.d(CLAP_POP);
+  p.d(SLAP_POP, 3);
+
+  p.d(KICK_POP, 1);
+
+  ////////////////
+
+  p.d(KICK_POP, 4);
+  //
+  p.d(KICK_POP);
+  p.d(CLAP_POP, 3);
+
+  p.d(CLAP_POP, 1);
+  //
+  p.d(SLAP_POP);
+  p.d(KICK_POP, 1);
+  p.d(CLAP_POP, 1);
+  p.d(SLIDE_POP_OFFSET, 1);
+  p.d(KICK_POP, 1);
+  //
+  p.d(CLAP_POP);
+  p.d(SLAP_POP);
+  p.d(SLIDE_POP);
+  p.d(KICK_POP, 2);
+  p.d(KICK_POP, 2);
+}
+
+template <class P>
+constexpr void pt_beat_drop(P& p)
+{
+  p.track = 0;
+  p.timbre = 14;
+  p.interpolate = INTERP_LINEAR;
+  p.volume = 0.825;
+  p.strength = 5;
+  p.transpose = 0;
+  p.tune = 0;
+  p.release = 0.001;
+  pt_bass(p);
+
+  p.track = 1;
+  p.timbre = 20;
+  p.volume = 1.25;
+  pt_bass(p);
+
+  p.track = 2;
+  p.timbre = 17;
+  p.volume = 0.75;
+  pt_chord_progression(p);
+
+  p.track = 3;
+  p.timbre = 3;
+  p.volume = 1.125;
+  pt_pluck_chords(p);
+
+  p.track = 4;
+  p.timbre = 0;
+  p.volume = 0.35;
+  p.transpose = -12;
+  p.tune = 0.5f;
+  p.release = 3;
+  p.r(16*2);
+  p.r(9);
+  p.n(79);
+  p.n(81);
+  p.n(84);
+  p.n(86);
+  p.n(88);
+  p.n(91);
+  p.n(93, 8, -5);
+  p.n(81, 8, -3);
+  p.n(86, 5);
+  p.r(4);
+
+  p.track = 11;
+  p.volume = 1;
+  pt_drum_chorus(p);
+}
+
+template <class P>
+constexpr P song()
+{
+  P p;
+
+  p.volume = 0.575;
+  p.track = 0;
+  pt_intro_pianolo(p);
+  p.track = 1;
+  pt_intro_pianohi(p);
+  p.track = 2;
+  pt_intro_pianomid(p);
+  p.track = 3;
+  pt_intro_pianolegato(p);
+  p.track = 4;
+  pt_intro_pizz(p);
+  p.track = 5;
+  pt_intro_str(p);
+  p.track = 6;
+  pt_intro_fx_doorbell(p);
+  p.track = 7;
+  pt_intro_fx_arp(p);
+  p.track = 8;
+  pt_intro_fx_enchant(p);
+  p.track = 9;
+  pt_intro_fx_lead(p);
+  p.track = 10;
+  pt_intro_fx_corrode(p);
+  p.track = 11;
+  p.volume = 1;
+  pt_drum_intro(p);
+
+  ////////////////////////////////
+  // BEAT DROP
+  ////////////////////////////////
+  pt_beat_drop(p);
+
+  ////////////////////////////////
+  // VERSE 1, PART 1
+  ////////////////////////////////
+  p.strength = 5;
+  p.reset();
+  p.track = 0;
+  p.timbre = 14;
+  p.volume = 0.5;
+  pt_bass(p, false, true);
+
+  p.reset();
+  p.track = 1;
+  p.timbre = 15;
+  p.transpose = -12;
+  p.release = 25;
+  p.r(14);
+
+  p.n(79);
+  p.c(69, 11);
+  p.c(72, 11);
+  p.c(74, 11);
+  p.c(83, 11);
+  p.n(67, 11);
+  
+  p.r(6);
+
+  p.c(65, 12);
+  p.c(69, 12);
+  p.c(72, 12);
+  p.c(76, 12);
+  p.n(62, 12);
+
+  p.r(4);
+
+  p.c(62, 13);
+  p.c(67, 13);
+  p.c(69, 13);
+  p.c(72, 13);
+  p.c(76, 13);
+  p.n(60, 13);
+
+  p.r(3);
+
+  p.reset();
+  p.track = 2;
+  p.timbre = 21;
+  p.volume = 0.625;
+  ////////////////
+  p.d(KICK_POP);
+  p.r(4);
+  p.d(CLAP_POP);
+  p.d(KICK_POP);
+  p.r(4);
+  p.d(KICK_POP);
+  p.r(2);
+  p.d(SLIDE_POP_OFFSET);
+  p.r(2);
+  p.d(CLAP_POP);
+  p.d(SLAP_POP);
+  p.d(KICK_POP);
+  p.r(2);
+  p.d(SLIDE_POP);
+  p.d(CLAP_POP);
+  p.r(1);
+  p.d(KICK_POP);
+  p.r(1);
+  ////////////////
+  for (int i = 0; i < 2; i++)
+  {
+    p.d(KICK_POP);
+    p.r(4);
+    p.d(CLAP_POP);
+    p.d(KICK_POP);
+    p.r(4);
+    p.d(KICK_POP);
+    p.r(4);
+    p.d(CLAP_POP);
+    p.d(SLAP_POP);
+    p.d(KICK_POP);
+    p.r(3);
+    p.d(KICK_POP);
+    p.r(1);
+  }
+  ////////////////
+  p.d(KICK_POP);
+  p.r(4);
+  p.d(CLAP_POP);
+  p.d(KICK_POP);
+  p.r(4);
+  p.d(KICK_POP);
+  p.d(SLIDE_POP_OFFSET);
+  p.r(4);
+  p.d(CLAP_POP);
+  p.d(SLIDE_POP);
+  p.d(KICK_POP);
+  p.r(3);
+  p.d(KICK_POP);
+  p.r(1);
+
+  p.track = 3;
+  p.r(64);
+  p.track = 4;
+  p.r(64);
+  p.track = 5;
+  p.r(64);
+
+  ////////////////////////////////
+  // VERSE 1, PART 2
+  ////////////////////////////////
+  p.reset();
+  p.track = 0;
+  p.timbre = 14;
+  p.volume = 0.5;
+  pt_bass(p, false, true);
+
+  p.reset();
+  p.track = 1;
+  p.timbre = 15;
+  p.transpose = -12;
+  p.release = 25;
+  p.c(64, 15);
+  p.c(72, 15);
+  p.c(79, 15);
+  p.c(81, 15);
+  p.n(91, 4);
+  p.n(84, 4);
+  p.n(93, 4);
+  p.n(98, 4, -1);
+
+  p.c(69, 11);
+  p.c(72, 11);
+  p.c(74, 11);
+  p.c(83, 11);
+  p.n(67, 11);
+
+  p.r(6);
+
+  p.c(65, 12);
+  p.c(69, 12);
+  p.c(72, 12);
+  p.c(76, 12);
+  p.n(62, 12);
+
+  p.r(4);
+
+  p.c(62, 13);
+  p.c(67, 13);
+  p.c(69, 13);
+  p.c(72, 13);
+  p.c(76, 13);
+  p.n(60, 13);
+
+  p.r(3);
+
+  p.reset();
+  p.track = 2;
+  p.timbre = 18;
+  p.transpose = -12;
+  p.r(14);
+
+  p.n(79);
+  p.c(69, 11);
+  p.c(72, 11);
+  p.c(74, 11);
+  p.c(83, 11);
+  p.n(67, 11);
+  
+  p.r(6);
+
+  p.c(65, 12);
+  p.c(69, 12);
+  p.c(72, 12);
+  p.c(76, 12);
+  p.n(62, 12);
+
+  p.r(4);
+
+  p.c(62, 13);
+  p.c(67, 13);
+  p.c(69, 13);
+  p.c(72, 13);
+  p.c(76, 13);
+  p.n(60, 13);
+
+  p.r(3);
+
+  p.reset();
+  p.track = 3;
+  p.timbre = 21;
+  p.volume = 0.625;
+  ////////////////
+  p.d(KICK_POP);
+  p.r(4);
+  p.d(CLAP_POP);
+  p.d(KICK_POP);
+  p.r(4);
+  p.d(KICK_POP);
+  p.r(2);
+  p.d(SLIDE_POP_OFFSET);
+  p.r(2);
+  p.d(CLAP_POP);
+  p.d(SLAP_POP);
+  p.d(KICK_POP);
+  p.r(2);
+  p.d(SLIDE_POP);
+  p.d(CLAP_POP);
+  p.r(1);
+  p.d(KICK_POP);
+  p.r(1);
+  ////////////////
+  p.d(KICK_POP);
+  p.r(4);
+  p.d(CLAP_POP);
+  p.d(KICK_POP);
+  p.r(2);
+  p.d(SLIDE_POP_OFFSET);
+  p.r(2);
+  p.d(KICK_POP, 1);
+  p.d(SFX_GOURD, 1);
+  p.d(KICK_POP);
+  p.d(SFX_BELL);
+  p.d(SLIDE_POP);
+  p.r(1);
+  p.d(SFX_BOWL_LO);
+  p.d(SFX_DROP_HI);
+  p.r(1);
+  p.d(CLAP_POP);
+  p.d(SLAP_POP);
+  p.d(KICK_POP);
+  p.r(3);
+  p.d(KICK_POP);
+  p.r(1);
+  ////////////////
+  p.d(KICK_POP);
+  p.r(4);
+  p.d(CLAP_POP);
+  p.d(KICK_POP);
+  p.r(4);
+  p.d(KICK_POP);
+  p.r(4);
+  p.d(CLAP_POP);
+  p.d(SLAP_POP);
+  p.d(KICK_POP);
+  p.r(3);
+  p.d(KICK_POP);
+  p.r(1);
+  ////////////////
+  p.d(KICK_POP);
+  p.r(4);
+  p.d(CLAP_POP);
+  p.d(KICK_POP);
+  p.r(4);
+  p.d(KICK_POP);
+  p.d(SLIDE_POP_OFFSET);
+  p.r(4);
+  p.d(CLAP_POP);
+  p.d(SLIDE_POP);
+  p.d(KICK_POP);
+  p.r(2);
+  p.d(KICK_POP);
+  p.r(1);
+  p.d(SFX_BOWL_HI);
+  p.r(1);
+
+  p.reset();
+  p.track = 4;
+  p.timbre = 5;
+  p.interpolate = INTERP_NONE;
+  p.release = 20;
+  p.volume = 0.125;
+  p.tune = -11.625f;
+  p.r(4);
+  p.n(79, 7, -3);
+  p.n(81, 7, -3);
+  p.n(86, 7, -3);
+  p.r(16);
+  p.r(8);
+  p.release = 0.01;
+  p.volume = 0.0625;
+  p.n(43, 7, 1);
+  p.r(16);
+
+  p.track = 5;
+  p.r(64);
+
+  p.finish();
+  return p;
+}
+
+// Sized in two passes: count the events, then compile exactly that many
+constexpr int SONG_EVENTS = song<PatternCount>().count;
+constexpr Pattern<SONG_EVENTS> SONG = song<Pattern<SONG_EVENTS>>();
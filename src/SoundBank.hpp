@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+#include "Patch.hpp"
+
+// The app's timbres, indexed by a note's "timbre" parameter. Benches that
+// play the bundled sequences build the same bank so their timbre numbers match.
+inline std::vector<Patch*> defaultSoundBank()
+{
+  return {
+    // temperment 
+    // new Timbre("LofiPCM/BUTTERFLY", {84, 88}, -2),
+    // new Timbre("LofiPCM/CROSSEDKEYMATRIX", {84}, -2),
+    // new Timbre("LofiPCM/DANCINGDELICATESTRING", {68}, -2),
+    // new Timbre("LofiPCM/NIGHTMARKET", {49, 61, 64, 68, 71, 75}, -2),
+    // new Timbre("LofiPCM/SKPIZZ", {36, 48, 60, 72}, -2),
+    // new Timbre("LofiPCM/TADPOLE", {36, 45, 48, 60, 72, 84, 96}, -2),
+
+    // new Timbre("LofiSynth/CORRODE", {65, 70}),
+    // new Timbre("LofiSynth/DOORBELL", {65, 82, 86}),
+    // new Timbre("LofiSynth/ENCHANTED", {53, 60, 77, 78, 79, 80}),
+    // new Timbre("LofiSynth/HIVEHOLE", {51, 63, 66, 70, 73}),
+    // new Timbre("LofiSynth/LOWBATTERY", {85}),
+    // new Timbre("LofiSynth/MYSTICAL", {87, 94}),
+    // new Timbre("LofiSynth/PATCH34", {58, 61, 65, 68, 75, 80, 87}),
+    // new Timbre("LofiSynth/SWEETDREAMS", {70, 85}),
+    // new Timbre("LofiSynth/UNSETTLINGBASS", {39, 42, 44, 48, 49, 51, 56, 57}),
+    // new Timbre("LofiSynth/WIRE", {75, 82, 85, 92}),
+
+    // new Timbre("PopSynth/CHORD-CHORUS", {51, 63, 66, 70, 73}),
+    // new Timbre("PopSynth/CHORD-INTRO", {51, 63, 66, 70, 73}),
+    // new Timbre("PopSynth/CHORD-WIRE", {51, 63, 66, 70, 73}),
+    // new Timbre("PopSynth/HOUSEPIANO", {51, 63, 66, 70, 73}),
+    // new Timbre("PopSynth/SITAR-test", {51}),
+    // new Timbre("PopSynth/LOGBASS", {32, 39, 42, 44, 48, 49, 56, 58}),
+
+    /* 00 */ new Timbre("Indian/SITAR", {60}), // Sa (C4)
+    /* 01 */ new Timbre("Indian/SITAR", {60, 67}), // Sa (C4), Pa (G4)
+    /* 02 */ new Timbre("Indian/SITAR", {60, 67, 72}), // Sa (C4), Pa (G4), High Sa (C5)
+    /* 03 */ new Timbre("Indian/SITAR", {60, 62, 64, 65, 67, 69, 71, 72}), // Sa, Re, Ga, Ma, Pa, Dha, Ni, Sa = C4, D4, E4, F4, G4, A4, B4, C5
+    /* 04 */ new Timbre("Indian/Sitar", {54, 55, 57, 60}) // Pa, Dha, Ni, Sa
+  };
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "Logger.hpp"
+#include "Patch.hpp"
+#include "ThreadPool.hpp"
+
+// Decodes every sample buffer of a sound bank on a worker pool while the app
+// runs. Voices check Sample::ready() and skip zones that haven't arrived yet.
+class SoundBankLoader
+{
+public:
+  void start(const std::vector<Patch*>& bank, unsigned threads = 0)
+  {
+    pool.reset(new ThreadPool(threads));
+    startTime = std::chrono::steady_clock::now();
+
+    for (Patch* patch : bank)
+    {
+      for (Sample* sample : patch->samples)
+      {
+        zones++;
+        if (!sample->ready())
+        {
+          queued.push_back(sample->buffer.get());
+        }
+      }
+    }
+
+    // Zones naming the same file share a buffer; decode each one once
+    std::sort(queued.begin(), queued.end());
+    queued.erase(std::unique(queued.begin(), queued.end()), queued.end());
+
+    total = queued.size();
+    PCM_LOG(LOG_INFO, "Loading ", total, " files for ", zones, " zones on ", pool->size(), " threads");
+
+    for (SampleBuffer* buffer : queued)
+    {
+      pool->submit([this, buffer] {
+        sampleCache().decode(*buffer);
+        finished();
+      });
+    }
+  }
+
+  // Block until the whole bank is resident, e.g. for offline rendering
+  void wait()
+  {
+    if (pool)
+    {
+      pool->wait();
+    }
+  }
+
+  int loaded() const { return done.load(std::memory_order_relaxed); }
+  int count() const { return total; }
+  bool complete() const { return loaded() == total; }
+  float progress() const { return total ? float(loaded()) / total : 1.f; }
+
+private:
+  std::unique_ptr<ThreadPool> pool;
+  std::vector<SampleBuffer*> queued;
+  int zones = 0;
+  std::atomic<int> done{0};
+  int total = 0;
+  std::chrono::steady_clock::time_point startTime;
+
+  void finished()
+  {
+    if (done.fetch_add(1) + 1 == total)
+    {
+      double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - startTime).count();
+      PCM_LOG(LOG_INFO, "Sound bank ready: ", total, " files in ", seconds, " s, ", sampleCache().uniqueCount(),
+              " unique, ", sampleCache().residentBytes() / (1024.0 * 1024.0), " MB + ",
+              sampleCache().mipBytes() / (1024.0 * 1024.0), " MB octave levels");
+    }
+  }
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads draining a FIFO of jobs. Meant for loader work
+// off the audio thread; submit() locks and allocates.
+class ThreadPool
+{
+public:
+  explicit ThreadPool(unsigned threadCount = 0)
+  {
+    if (threadCount == 0)
+    {
+      threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned i = 0; i < threadCount; i++)
+    {
+      workers.emplace_back([this] { work(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+
+    wake.notify_all();
+    for (auto& worker : workers)
+    {
+      worker.join();
+    }
+  }
+
+  void submit(std::function<void()> job)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobs.push_back(std::move(job));
+      pending++;
+    }
+
+    wake.notify_one();
+  }
+
+  // Block until every submitted job has finished
+  void wait()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return pending == 0; });
+  }
+
+  size_t size() const { return workers.size(); }
+
+private:
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> jobs;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable idle;
+  size_t pending = 0;
+  bool stopping = false;
+
+  void work()
+  {
+    while (true)
+    {
+      std::function<void()> job;
+
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+        if (jobs.empty())
+        {
+          return; // stopping and drained
+        }
+
+        job = std::move(jobs.front());
+        jobs.pop_front();
+      }
+
+      job();
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending--;
+      }
+
+      idle.notify_all();
+    }
+  }
+};
@@ -0,0 +1,414 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "Logger.hpp"
+#include "PCMKernel.hpp"
+#include "RenderPool.hpp"
+#include "SampleBuffer.hpp"
+
+// Batched alternative to one PCMEnv object per note. The state of every
+// playing voice lives in parallel per-slot arrays, and render() mixes all of
+// them in one pass per block, in order of the frames they read so voices on
+// the same sample run back to back while its frames are in cache.
+//
+// Slots are claimed and steered by proxy voices (PCMBatchVoice in main.cpp)
+// so PolySynth and the sequencer see the usual SynthVoice API. Everything
+// here must be called from the audio thread, which owns the slot arrays: a
+// proxy claims its slot in its first onProcess, because onTriggerOn runs on
+// whichever thread triggered the note (the GUI's, for the keyboard).
+//
+// With threads() set, render() splits the slots into fixed groups of GROUP
+// and a RenderPool renders each group into its own bus; the buses are then
+// summed in group order. Which thread rendered a group never matters, so the
+// output is bit-identical for any number of workers and any scheduling.
+class PCMVoiceEngine
+{
+public:
+  static const int MAX_VOICES = 256;
+  static const int BLOCK = 256; // frames per kernel call; longer buffers are split
+  static const int GROUP = 8;   // slots per pool task
+
+  float sampleRate = 48000; // for envelope times
+
+  // Past the attack, a slot whose remaining sample (SampleBuffer::tailLevel)
+  // times envelope and gain is below this stops early; 0 plays every slot out
+  float silenceThreshold = 3.1623e-5f; // -90 dBFS
+
+  PCMVoiceEngine()
+  {
+    for (int i = 0; i < MAX_VOICES; i++)
+    {
+      freeSlots[i] = MAX_VOICES - 1 - i;
+    }
+    freeCount = MAX_VOICES;
+  }
+
+  // Claim a slot playing `buffer` at `rate` (from an octave level where it
+  // has one). Returns -1 if every slot is busy.
+  int start(const SampleBuffer& buffer, float rate)
+  {
+    if (freeCount == 0)
+    {
+      return -1;
+    }
+
+    int slot = freeSlots[--freeCount];
+    int level = buffer.mipLevelFor(rate);
+    sources[slot] = &buffer;
+    readLevels[slot] = level;
+    readers[slot] = buffer.read(level);
+    lengths[slot] = buffer.playableFrames(readers[slot]);
+    heads[slot].start(rate / float(1 << level));
+    interpolations[slot] = INTERP_NONE;
+    leftTargets[slot] = rightTargets[slot] = 0;
+    primed[slot] = false;
+    envLevels[slot] = 0;
+    attackSteps[slot] = releaseSteps[slot] = 1;
+    releaseFrames[slot] = 1;
+    stages[slot] = ATTACK;
+    startFrames[slot] = 0;
+    holds[slot] = -1;
+
+    // Keep slots reading the same frames next to each other
+    int* at = std::upper_bound(order, order + activeCount, slot, [this](int a, int b) {
+      return std::less<const int16_t*>()(readers[a].head, readers[b].head);
+    });
+    std::copy_backward(at, order + activeCount, order + activeCount + 1);
+    *at = slot;
+    activeCount++;
+    return slot;
+  }
+
+  // This block's settings for a slot; gains already include amplitude and pan
+  void control(int slot, int interpolation, float leftGain, float rightGain, float attackSeconds, float releaseSeconds)
+  {
+    interpolations[slot] = interpolation;
+    leftTargets[slot] = leftGain;
+    rightTargets[slot] = rightGain;
+    attackSteps[slot] = 1 / std::max(attackSeconds * sampleRate, 1.f);
+    releaseFrames[slot] = std::max(releaseSeconds * sampleRate, 1.f);
+  }
+
+  // The frame of the next render() block a slot starts on: its note's onset
+  // in the block it begins in, 0 after that
+  void startAt(int slot, int frame) { startFrames[slot] = frame; }
+
+  // Release `frames` after the slot's first frame, on that exact frame, for
+  // notes whose note-off is known when they start; -1 waits for release()
+  void hold(int slot, int frames) { holds[slot] = frames; }
+
+  // Note off: fade from the current level to silence over the release time
+  void release(int slot)
+  {
+    holds[slot] = -1;
+    if (stages[slot] < RELEASE)
+    {
+      stages[slot] = RELEASE;
+      releaseSteps[slot] = envLevels[slot] / releaseFrames[slot];
+    }
+  }
+
+  // Voice stealing: fade to silence over `seconds` from any stage, keeping a
+  // release that is already faster
+  void fadeOut(int slot, float seconds)
+  {
+    holds[slot] = -1;
+    if (stages[slot] == DONE)
+    {
+      return;
+    }
+    float step = envLevels[slot] / std::max(seconds * sampleRate, 1.f);
+    releaseSteps[slot] = stages[slot] == RELEASE ? std::max(releaseSteps[slot], step) : step;
+    stages[slot] = RELEASE;
+  }
+
+  // Envelope level times the louder channel's gain, as VoiceManager compares voices
+  float loudness(int slot) const { return envLevels[slot] * std::max(leftTargets[slot], rightTargets[slot]); }
+
+  // The sample or the release ran out; the owner should stop() the slot
+  bool ended(int slot) const { return stages[slot] == DONE; }
+
+  // Hand a slot back, with its disk stream if it had one
+  void stop(int slot)
+  {
+    sampleStreamer().release(readers[slot].stream);
+    readers[slot].stream = nullptr;
+
+    int* at = std::find(order, order + activeCount, slot);
+    if (at != order + activeCount)
+    {
+      std::copy(at + 1, order + activeCount, at);
+      activeCount--;
+      freeSlots[freeCount++] = slot;
+    }
+  }
+
+  int active() const { return activeCount; }
+
+  // Render on the audio thread plus `workers` pool threads, for buffers of up
+  // to `maxFrames`. Call before audio starts; 0 workers still renders through
+  // the buses, so output matches any worker count.
+  void threads(int workers, int maxFrames)
+  {
+    pool.reset(new RenderPool(workers, &runGroup, this));
+    busFrames = maxFrames;
+    buses.assign(size_t(MAX_VOICES / GROUP) * 2 * maxFrames, 0.f);
+  }
+
+  // Mix every playing slot into `left` and `right`
+  void render(float* left, float* right, int frames)
+  {
+    auto start = std::chrono::steady_clock::now();
+
+    if (pool && frames <= busFrames)
+    {
+      renderFrames = frames;
+      int groups = (activeCount + GROUP - 1) / GROUP;
+      pool->run(groups);
+
+      // Fixed summing order, whoever rendered each bus
+      for (int group = 0; group < groups; group++)
+      {
+        const float* bus = &buses[size_t(group) * 2 * busFrames];
+        for (int i = 0; i < frames; i++)
+        {
+          left[i] += bus[i];
+          right[i] += bus[busFrames + i];
+        }
+      }
+    }
+    else
+    {
+      for (int n = 0; n < activeCount; n++)
+      {
+        renderSlot(order[n], left, right, frames, envelope);
+      }
+    }
+
+    // Against the time this buffer takes to play
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    callbacks.fetch_add(1, std::memory_order_relaxed);
+    if (seconds > frames / sampleRate)
+    {
+      deadlineMisses.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  // render() calls, and those that took longer than their buffer lasts
+  std::atomic<long> callbacks{0};
+  std::atomic<long> deadlineMisses{0};
+  std::atomic<long> silenced{0}; // slots stopped early by silenceThreshold
+
+  void printStats() const
+  {
+    long calls = callbacks.load(), misses = deadlineMisses.load();
+    double missed = calls ? 100.0 * misses / calls : 0;
+    if (pool && pool->wakeups.load() > 0)
+    {
+      PCM_LOG(LOG_INFO, "Voice engine: ", calls, " callbacks, ", misses, " over deadline (", missed, "%), ",
+              silenced.load(), " voices freed as silent, ", pool->workers(), " workers woke in ",
+              pool->wakeTotalNs.load() / 1000.0 / pool->wakeups.load(), " us on average, ",
+              pool->wakeMaxNs.load() / 1000.0, " us at worst");
+    }
+    else
+    {
+      PCM_LOG(LOG_INFO, "Voice engine: ", calls, " callbacks, ", misses, " over deadline (", missed, "%), ",
+              silenced.load(), " voices freed as silent");
+    }
+  }
+
+private:
+  enum Stage : uint8_t { ATTACK, SUSTAIN, RELEASE, DONE };
+
+  // Per-slot state
+  const SampleBuffer* sources[MAX_VOICES];
+  int readLevels[MAX_VOICES]; // head frames are 2^level base frames
+  SampleReader readers[MAX_VOICES];
+  int lengths[MAX_VOICES];
+  PlayHead heads[MAX_VOICES];
+  int interpolations[MAX_VOICES];
+  float leftTargets[MAX_VOICES];
+  float rightTargets[MAX_VOICES];
+  ParamRamp leftGains[MAX_VOICES];
+  ParamRamp rightGains[MAX_VOICES];
+  bool primed[MAX_VOICES];
+
+  // Linear attack / sustain / release envelope, as PCMEnv's gam::Env<3>
+  float envLevels[MAX_VOICES];
+  float attackSteps[MAX_VOICES];
+  float releaseSteps[MAX_VOICES];
+  float releaseFrames[MAX_VOICES];
+  Stage stages[MAX_VOICES];
+  int startFrames[MAX_VOICES];
+  int holds[MAX_VOICES]; // frames left until a scheduled release, or -1
+
+  int order[MAX_VOICES]; // active slots, sorted by the frames they read
+  int activeCount = 0;
+  int freeSlots[MAX_VOICES];
+  int freeCount = 0;
+
+  float envelope[BLOCK]; // scratch for single-threaded render()
+
+  std::unique_ptr<RenderPool> pool;
+  std::vector<float> buses; // per group: busFrames left, then busFrames right
+  int busFrames = 0;
+  int renderFrames = 0;
+
+  static void runGroup(void* engine, int group)
+  {
+    static_cast<PCMVoiceEngine*>(engine)->renderGroup(group);
+  }
+
+  // One pool task: a fixed run of slots into that run's own bus
+  void renderGroup(int group)
+  {
+    float* left = &buses[size_t(group) * 2 * busFrames];
+    float* right = left + busFrames;
+    std::fill(left, left + renderFrames, 0.f);
+    std::fill(right, right + renderFrames, 0.f);
+
+    float scratch[BLOCK];
+    int end = std::min(activeCount, (group + 1) * GROUP);
+    for (int n = group * GROUP; n < end; n++)
+    {
+      renderSlot(order[n], left, right, renderFrames, scratch);
+    }
+  }
+
+  void renderSlot(int slot, float* left, float* right, int frames, float* envelope)
+  {
+    if (stages[slot] == DONE)
+    {
+      return;
+    }
+
+    // Let the disk stream refill everything behind the play head
+    if (readers[slot].stream)
+    {
+      readers[slot].stream->consume(heads[slot].frame());
+    }
+
+    // A note starting in this block sounds from its own frame
+    int first = std::min(startFrames[slot], frames);
+    startFrames[slot] = 0;
+    left += first;
+    right += first;
+    frames -= first;
+
+    // Ramp towards this block's gains; a new note starts on them directly
+    if (primed[slot])
+    {
+      leftGains[slot].rampTo(leftTargets[slot], frames);
+      rightGains[slot].rampTo(rightTargets[slot], frames);
+    }
+    else
+    {
+      leftGains[slot].reset(leftTargets[slot]);
+      rightGains[slot].reset(rightTargets[slot]);
+      primed[slot] = true;
+    }
+
+    for (int done = 0; done < frames;)
+    {
+      int count = std::min(frames - done, int(BLOCK));
+
+      // A scheduled note-off lands on its exact frame
+      int hold = holds[slot];
+      if (hold >= 0 && hold < count)
+      {
+        envelopeBlock(slot, hold, envelope);
+        release(slot);
+        envelopeBlock(slot, count - hold, envelope + hold);
+      }
+      else
+      {
+        envelopeBlock(slot, count, envelope);
+        holds[slot] = hold >= 0 ? hold - count : hold;
+      }
+
+      int rendered = renderPCM(readers[slot], lengths[slot], heads[slot], interpolations[slot], envelope,
+                               leftGains[slot], rightGains[slot], left + done, right + done, count);
+      done += count;
+
+      if (rendered < count || stages[slot] == DONE)
+      {
+        stages[slot] = DONE;
+        break;
+      }
+
+      float gain = envLevels[slot] * std::max(leftTargets[slot], rightTargets[slot]);
+      if (stages[slot] != ATTACK &&
+          sources[slot]->tailLevel(heads[slot].frame() << readLevels[slot]) * gain < silenceThreshold)
+      {
+        stages[slot] = DONE;
+        silenced.fetch_add(1, std::memory_order_relaxed);
+        break;
+      }
+    }
+
+    leftGains[slot].settle();
+    rightGains[slot].settle();
+  }
+
+  void envelopeBlock(int slot, int count, float* envelope)
+  {
+    float level = envLevels[slot];
+    int i = 0;
+
+    if (stages[slot] == ATTACK)
+    {
+      for (float step = attackSteps[slot]; i < count && level < 1; i++)
+      {
+        envelope[i] = level;
+        level += step;
+      }
+      if (level >= 1)
+      {
+        level = 1;
+        stages[slot] = SUSTAIN;
+      }
+    }
+
+    if (stages[slot] == SUSTAIN)
+    {
+      for (; i < count; i++)
+      {
+        envelope[i] = level;
+      }
+    }
+
+    if (stages[slot] == RELEASE)
+    {
+      for (float step = releaseSteps[slot]; i < count && level > 0; i++)
+      {
+        envelope[i] = level;
+        level -= step;
+      }
+      if (level <= 0)
+      {
+        level = 0;
+        stages[slot] = DONE;
+      }
+    }
+
+    for (; i < count; i++)
+    {
+      envelope[i] = 0;
+    }
+
+    envLevels[slot] = level;
+  }
+};
+
+inline PCMVoiceEngine& pcmVoiceEngine()
+{
+  static PCMVoiceEngine engine;
+  return engine;
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "Logger.hpp"
+
+// What VoiceManager needs from a voice to choose it and silence it
+class StealableVoice
+{
+public:
+  virtual ~StealableVoice() {}
+
+  // Current envelope level times amplitude
+  virtual float loudness() const = 0;
+
+  // Fade out over VoiceManager::fadeSeconds, then free the voice
+  virtual void steal() = 0;
+};
+
+enum StealPolicy
+{
+  STEAL_OLDEST,
+  STEAL_QUIETEST,  // lowest loudness() right now
+  STEAL_SAME_NOTE, // a retriggered note fades its earlier voices; at the cap, oldest
+};
+
+// Bounds polyphony for PCMEnv voices: a hard cap on sounding voices, and a
+// CPU budget per audio callback that lowers the cap while callbacks run long
+// and lets it climb back once they don't. Voices over either limit are faded
+// out by the policy. Nothing here is locked: started(), finished() and the
+// callback brackets must all be called on the audio thread, so voices register
+// from their first onProcess rather than from onTriggerOn, which runs on
+// whichever thread triggered the note. The counters can be read anywhere.
+class VoiceManager
+{
+public:
+  static const int MAX_TRACKED = 512;   // sounding plus fading voices
+  static const int RECOVER_AFTER = 50;  // calm callbacks before the cap climbs again
+
+  // Settings; change before audio starts
+  int maxVoices = 64;
+  double budget = 0.75; // share of a buffer's duration render may take
+  StealPolicy policy = STEAL_OLDEST;
+  float fadeSeconds = 0.005f;
+  float silenceThreshold = 3.1623e-5f; // -90 dBFS; see silent(); 0 keeps every voice to its end
+
+  // Metrics
+  std::atomic<long> capSteals{0};    // stolen to make room under the cap
+  std::atomic<long> retriggers{0};   // faded by a same-note retrigger
+  std::atomic<long> budgetSteals{0}; // stolen after a callback ran over budget
+  std::atomic<long> overruns{0};     // callbacks over budget
+  std::atomic<long> silenced{0};     // freed early because the rest was inaudible
+  std::atomic<long> callbacks{0};
+  std::atomic<int> sounding{0};
+  std::atomic<int> limit{MAX_TRACKED}; // the cap the budget currently allows
+
+  // A voice started playing `key` (timbre and note); may fade others out
+  void started(StealableVoice* voice, int key)
+  {
+    Entry* entry = find(voice);
+    if (!entry)
+    {
+      if (count == MAX_TRACKED)
+      {
+        return; // only reachable with an absurd cap; the voice plays untracked
+      }
+      entry = &entries[count++];
+    }
+    *entry = Entry{voice, key, ++startCount, false};
+
+    if (policy == STEAL_SAME_NOTE)
+    {
+      for (int i = 0; i < count; i++)
+      {
+        if (!entries[i].stolen && entries[i].voice != voice && entries[i].key == key)
+        {
+          steal(entries[i]);
+          retriggers.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    }
+
+    int cap = std::min(std::min(maxVoices, int(MAX_TRACKED)), limit.load(std::memory_order_relaxed));
+    while (playing() > cap)
+    {
+      Entry* victim = choose(voice);
+      if (!victim)
+      {
+        break;
+      }
+      steal(*victim);
+      capSteals.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    sounding.store(playing(), std::memory_order_relaxed);
+  }
+
+  // The voice was freed, whether it ended, was released or was stolen
+  void finished(StealableVoice* voice)
+  {
+    Entry* entry = find(voice);
+    if (entry)
+    {
+      *entry = entries[--count];
+      sounding.store(playing(), std::memory_order_relaxed);
+    }
+  }
+
+  // Can a voice stop now? `tail` is the loudest the rest of its sample gets
+  // (SampleBuffer::tailLevel) and `gain` the envelope times output gain, which
+  // the caller knows can only fall from here (past the attack)
+  bool silent(float tail, float gain)
+  {
+    if (tail * gain >= silenceThreshold)
+    {
+      return false;
+    }
+    silenced.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Bracket the render in onSound
+  void beginCallback() { callbackStart = std::chrono::steady_clock::now(); }
+
+  void endCallback(double bufferSeconds)
+  {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - callbackStart).count();
+    callbacks.fetch_add(1, std::memory_order_relaxed);
+    int cap = limit.load(std::memory_order_relaxed);
+
+    if (seconds > budget * bufferSeconds)
+    {
+      // Hold the cap one below what just overran and fade one voice now
+      overruns.fetch_add(1, std::memory_order_relaxed);
+      calm = 0;
+      cap = std::max(1, playing() - 1);
+      Entry* victim = choose(nullptr);
+      if (victim && playing() > cap)
+      {
+        steal(*victim);
+        budgetSteals.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    else if (cap < MAX_TRACKED && ++calm >= RECOVER_AFTER)
+    {
+      calm = 0;
+      cap = cap >= maxVoices ? int(MAX_TRACKED) : cap + std::max(1, cap / 4);
+    }
+
+    limit.store(cap, std::memory_order_relaxed);
+    sounding.store(playing(), std::memory_order_relaxed);
+  }
+
+  void printStats() const
+  {
+    PCM_LOG(LOG_INFO, "Voices: cap ", maxVoices, ", ", capSteals.load(), " stolen at the cap, ", retriggers.load(),
+            " retriggered, ", budgetSteals.load(), " stolen for CPU, ", silenced.load(), " freed as silent; ",
+            overruns.load(), " of ", callbacks.load(), " callbacks over the ", int(budget * 100), "% budget");
+  }
+
+private:
+  struct Entry
+  {
+    StealableVoice* voice;
+    int key;
+    uint64_t order; // start order, for STEAL_OLDEST
+    bool stolen;    // fading out; no longer counts as sounding
+  };
+
+  Entry entries[MAX_TRACKED];
+  int count = 0;
+  uint64_t startCount = 0;
+  int calm = 0;
+  std::chrono::steady_clock::time_point callbackStart;
+
+  Entry* find(StealableVoice* voice)
+  {
+    for (int i = 0; i < count; i++)
+    {
+      if (entries[i].voice == voice)
+      {
+        return &entries[i];
+      }
+    }
+    return nullptr;
+  }
+
+  int playing() const
+  {
+    int n = 0;
+    for (int i = 0; i < count; i++)
+    {
+      n += !entries[i].stolen;
+    }
+    return n;
+  }
+
+  void steal(Entry& entry)
+  {
+    entry.stolen = true;
+    entry.voice->steal();
+  }
+
+  // Victim under the current policy, never `spare` (the note being started)
+  Entry* choose(StealableVoice* spare)
+  {
+    Entry* best = nullptr;
+    float quietest = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+      Entry& entry = entries[i];
+      if (entry.stolen || entry.voice == spare)
+      {
+        continue;
+      }
+
+      if (policy == STEAL_QUIETEST)
+      {
+        float loudness = entry.voice->loudness();
+        if (!best || loudness < quietest)
+        {
+          best = &entry;
+          quietest = loudness;
+        }
+      }
+      else if (!best || entry.order < best->order)
+      {
+        best = &entry;
+      }
+    }
+
+    return best;
+  }
+};
+
+inline VoiceManager& voiceManager()
+{
+  static VoiceManager manager;
+  return manager;
+}
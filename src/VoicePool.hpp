@@ -0,0 +1,89 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "al/scene/al_PolySynth.hpp"
+
+// Voices for the notes the audio thread starts itself (PatternPlayer's): a
+// fixed array of them, init()ed before audio starts, handed out and rendered
+// from onSound without PolySynth, whose getVoice and triggerOn take a mutex
+// and grow the pool with new voices when it runs dry. Once audio runs only
+// the audio thread touches the pool, so there is nothing to hand over and
+// nothing to lock; a note that finds every voice busy is dropped.
+template <class Voice>
+class VoicePool
+{
+public:
+  long dropped = 0; // note-ons that found every voice busy
+
+  // Before audio starts
+  void allocate(int count)
+  {
+    voices.reset(new Voice[count]);
+    size = count;
+    idle.clear();
+    playing.clear();
+    idle.reserve(count); // never grown after this, so the audio thread doesn't allocate
+    playing.reserve(count);
+    for (int i = count - 1; i >= 0; i--)
+    {
+      voices[i].init();
+      idle.push_back(&voices[i]);
+    }
+  }
+
+  int capacity() const { return size; }
+  int active() const { return int(playing.size()); }
+
+  // A voice to set up and start(), or nullptr when every voice is busy
+  Voice* take()
+  {
+    if (idle.empty())
+    {
+      dropped++;
+      return nullptr;
+    }
+    Voice* voice = idle.back();
+    idle.pop_back();
+    return voice;
+  }
+
+  // Starts a voice from take() `offset` frames into the next render
+  void start(Voice* voice, int offset)
+  {
+    voice->triggerOn(offset);
+    playing.push_back(voice);
+  }
+
+  // Adds every playing voice to the block from its start offset, as
+  // PolySynth::render does, and takes back the ones that freed themselves
+  void render(al::AudioIOData& io)
+  {
+    for (size_t i = 0; i < playing.size();)
+    {
+      Voice* voice = playing[i];
+      if (voice->active())
+      {
+        io.frame(voice->getStartOffsetFrames(io.framesPerBuffer()));
+        voice->onProcess(io);
+      }
+      if (voice->active())
+      {
+        i++;
+      }
+      else
+      {
+        playing[i] = playing.back();
+        playing.pop_back();
+        idle.push_back(voice);
+      }
+    }
+    io.frame(0);
+  }
+
+private:
+  std::unique_ptr<Voice[]> voices;
+  int size = 0;
+  std::vector<Voice*> idle, playing;
+};
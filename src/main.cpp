@@ -1,5 +1,11 @@
+#include <algorithm> // std::min, std::remove_if
+#include <chrono>
 #include <iostream>
 #include <cstdio> // for printing to stdout
+#include <cmath> // pow
+#include <cstdlib> // atoi, atof
+#include <fstream>
+#include <sstream>
 #include <vector> // store sample data
 
 // GAMMA
@@ -24,139 +30,50 @@
 #include "al/ui/al_Parameter.hpp"
 #include "al/graphics/al_Shapes.hpp"
 #include "al/graphics/al_Font.hpp"
+#include "al/io/al_Imgui.hpp"
+
+#include "Logger.hpp"
+#include "Patch.hpp"
+#include "Pattern.hpp"
+#include "PCMEnvVoice.hpp"
+#include "PCMKernel.hpp"
+#include "RtCheck.hpp"
+#include "SampleBank.hpp"
+#include "SequenceBinary.hpp"
+#include "SequenceFile.hpp"
+#include "SoundBank.hpp"
+#include "SoundBankLoader.hpp"
+#include "VoiceManager.hpp"
+#include "VoiceEngine.hpp"
+#include "VoicePool.hpp"
+
+#ifdef PCM_HAVE_RT_CHECK
+#include <glob.h>
+#endif
 
 using namespace al;
 
-struct Sample
-{
-  int pitch_root = 60;
-  int pitch_highest = 127;
-  int sample_rate = 44100;
-  std::vector<float> sampleData;
+std::vector<Patch*> SoundBank = defaultSoundBank();
 
-  Sample(std::string filename, int pitch_root, int pitch_highest)
-  {
-    this->pitch_root = pitch_root;
-    this->pitch_highest = pitch_highest;
-
-    // load sample
-    SoundFile file;
-    file.open(filename.c_str());
-    sample_rate = file.sampleRate;
-    
-    for (long long int i = 0; i < file.frameCount; i++)
-    {
-      sampleData.push_back(file.getFrame(i)[0]);
-    }
+SoundBankLoader soundBankLoader;
 
-    std::cout << "Loaded " << filename << " with " << sampleData.size() << " samples" << std::endl;
-  }
-};
+// Written by `app --pack-bank`; used instead of the WAVs when it matches SoundBank
+const char* SAMPLE_BANK_PATH = "timbre.bank";
 
-struct Timbre
-{
-  std::vector<Sample*> samples;
-
-  Timbre(std::string name, std::vector<int> pitches, int correct=0)
-  {
-    for (int i = 0; i < pitches.size(); i++)
-    {
-      int pitch = pitches[i];
-      int nextPitch;
-
-      if (i < pitches.size() - 1)
-      {
-        nextPitch = pitches[i + 1];
-      }
-      else
-      {
-        nextPitch = 127;
-      }
-
-      samples.push_back(
-        new Sample(
-          "timbre/" + name + "/" + std::to_string(pitch) + ".wav",
-          pitch - correct,
-          nextPitch - 1 - correct
-        )
-      );
-    }
-  }
-
-  Sample* getSample(int pitch)
-  {
-    // Find the sample that's most optimal for the pitch
-    for (int i = 0; i < samples.size(); i++)
-    {
-      if (pitch <= samples[i]->pitch_highest)
-      {
-        return samples[i];
-      }
-    }
-
-    return samples[0]; // Fallback to single sample
-  }
-};
-
-std::vector<Timbre> SoundBank = {
-  // temperment 
-  // Timbre("LofiPCM/BUTTERFLY", {84, 88}, -2),
-  // Timbre("LofiPCM/CROSSEDKEYMATRIX", {84}, -2),
-  // Timbre("LofiPCM/DANCINGDELICATESTRING", {68}, -2),
-  // Timbre("LofiPCM/NIGHTMARKET", {49, 61, 64, 68, 71, 75}, -2),
-  // Timbre("LofiPCM/SKPIZZ", {36, 48, 60, 72}, -2),
-  // Timbre("LofiPCM/TADPOLE", {36, 45, 48, 60, 72, 84, 96}, -2),
-
-  // Timbre("LofiSynth/CORRODE", {65, 70}),
-  // Timbre("LofiSynth/DOORBELL", {65, 82, 86}),
-  // Timbre("LofiSynth/ENCHANTED", {53, 60, 77, 78, 79, 80}),
-  // Timbre("LofiSynth/HIVEHOLE", {51, 63, 66, 70, 73}),
-  // Timbre("LofiSynth/LOWBATTERY", {85}),
-  // Timbre("LofiSynth/MYSTICAL", {87, 94}),
-  // Timbre("LofiSynth/PATCH34", {58, 61, 65, 68, 75, 80, 87}),
-  // Timbre("LofiSynth/SWEETDREAMS", {70, 85}),
-  // Timbre("LofiSynth/UNSETTLINGBASS", {39, 42, 44, 48, 49, 51, 56, 57}),
-  // Timbre("LofiSynth/WIRE", {75, 82, 85, 92}),
-
-  // Timbre("PopSynth/CHORD-CHORUS", {51, 63, 66, 70, 73}),
-  // Timbre("PopSynth/CHORD-INTRO", {51, 63, 66, 70, 73}),
-  // Timbre("PopSynth/CHORD-WIRE", {51, 63, 66, 70, 73}),
-  // Timbre("PopSynth/HOUSEPIANO", {51, 63, 66, 70, 73}),
-  // Timbre("PopSynth/SITAR-test", {51}),
-  // Timbre("PopSynth/LOGBASS", {32, 39, 42, 44, 48, 49, 56, 58}),
-
-  /* 00 */ Timbre("Indian/SITAR", {60}), // Sa (C4)
-  /* 01 */ Timbre("Indian/SITAR", {60, 67}), // Sa (C4), Pa (G4)
-  /* 02 */ Timbre("Indian/SITAR", {60, 67, 72}), // Sa (C4), Pa (G4), High Sa (C5)
-  /* 03 */ Timbre("Indian/SITAR", {60, 62, 64, 65, 67, 69, 71, 72}), // Sa, Re, Ga, Ma, Pa, Dha, Ni, Sa = C4, D4, E4, F4, G4, A4, B4, C5
-  /* 04 */ Timbre("Indian/Sitar", {54, 55, 57, 60}) // Pa, Dha, Ni, Sa
-};
-
-class PCMEnv : public SynthVoice
+class PCMEnv : public PCMEnvVoice
 {
 public:
-  gam::Pan<> mPan;
   gam::Sine<> mOsc;
-  gam::Env<3> mAmpEnv;
   gam::EnvFollow<> mEnvFollow;
   Mesh mMesh;
   float mAmp;
 
-  float attenuation = 0;
-  float rate = 0;
-  float position = 0;
-  Sample* sampleRef = nullptr;;
-  Timbre* currentTimbre = nullptr;
-  int sampleLength = 0;
+  Patch* currentTimbre = nullptr;
 
   void init() override
   {
-
+    PCMEnvVoice::init();
     mAmp = 1;
-    // Intialize envelope
-    mAmpEnv.curve(0); // make segments lines
-    mAmpEnv.levels(0, 1, 1, 0);
-    mAmpEnv.sustainPoint(2);
 
     // Set up parameters
     addDisc(mMesh, 1.0, 30);
@@ -167,67 +84,7 @@ public:
     createInternalTriggerParameter("attackTime", 2, 0.001, 3.0);
     createInternalTriggerParameter("releaseTime", 2, 0.001, 10.0);
     createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
-    createInternalTriggerParameter("interpolate", 0, 0, 1);
-  }
-
-  float linear_interpolate(std::vector<float>& data, float position, int length) {
-    int floored_position = floor(position);
-    float current_item = data[floored_position];
-    int next_position = floored_position + 1;
-
-    if (next_position < length)
-    {
-      float next_item = data[next_position];
-      float fraction = position - floored_position;
-
-      return current_item + fraction * (next_item - current_item);
-    }
-
-    return current_item;
-  }
-
-  void onProcess(AudioIOData &io) override
-  {
-    bool interpolate = getInternalParameterValue("interpolate");
-    mAmpEnv.lengths()[0] = getInternalParameterValue("attackTime");
-    mAmpEnv.lengths()[2] = getInternalParameterValue("releaseTime");
-    
-    
-    while (io())
-    {
-      mPan.pos(getInternalParameterValue("pan"));
-      float s1 = 0;
-      float s2;
-
-      // Instrument
-      if (position >= sampleLength) {
-        rate = 0;
-      }
-
-      if (rate > 0) {
-        if (interpolate) {
-          s1 = linear_interpolate(sampleRef->sampleData, position, sampleLength);
-        } else {
-          s1 = sampleRef->sampleData.at(position);
-        }
-          
-        s1 = s1 / attenuation;
-        s1 = s1 * mAmpEnv() * getInternalParameterValue("amplitude");
-      }
-
-      position += rate;
-
-      // Pan
-      mPan(s1, s1, s2);
-
-      // Output
-      io.out(0) += s1;
-      io.out(1) += s2;
-
-      if (position >= sampleLength || mAmpEnv.done()) {
-        free();
-      }
-    }
+    createInternalTriggerParameter("interpolate", INTERP_NONE, INTERP_NONE, INTERP_COUNT - 1);
   }
 
   void set(int timbre, int midiNote, float amplitude)
@@ -237,6 +94,18 @@ public:
     setInternalParameterValue("amplitude", amplitude);
   }
 
+  // Everything a bulk-loaded sequence note carries
+  void set(const PatternEvent& e)
+  {
+    set(e.timbre, int(e.note), e.amplitude);
+    setInternalParameterValue("attackTime", e.attack);
+    setInternalParameterValue("releaseTime", e.release);
+    setInternalParameterValue("pan", e.pan);
+    setInternalParameterValue("interpolate", e.interpolate);
+  }
+
+  using PCMEnvVoice::onProcess; // the audio one
+
   virtual void onProcess(Graphics &g) {
     float frequency = getInternalParameterValue("frequency");
     float amplitude = getInternalParameterValue("amplitude");
@@ -253,31 +122,147 @@ public:
 
   void onTriggerOn() override {
     int midiNote = getInternalParameterValue("midiNote");
+    int timbre = getInternalParameterValue("timbre");
 
     // Update currentTimbre with timbre parameter
-    this->currentTimbre = &SoundBank[getInternalParameterValue("timbre")];
+    this->currentTimbre = SoundBank[timbre];
 
-    // Use midiNote to find the best sample in timbre
-    this->sampleRef = this->currentTimbre->getSample(midiNote);
-    std::cout << "Sample: " << sampleRef->pitch_root << std::endl;
+    // Zone and base playback rate come straight from the patch's keymap
+    if (startNote(this->currentTimbre, midiNote, timbre)) {
+      PCM_LOG_RATE(LOG_INFO, 20, "Sample: ", sampleRef->pitch_root);
+    }
+  }
+};
 
-    // Convert midiNote to frequency to set playback rate
-    this->rate = pow(2.f, (midiNote - this->sampleRef->pitch_root) / 12.f);
-    
-    // Prepare playback of sample
-    this->sampleLength = this->sampleRef->sampleData.size();
-    this->attenuation = 2;
-    this->position = 0;
+// Stand-in for PCMEnv when the batched engine is on: PolySynth, the GUI and
+// the sequencer drive it exactly like PCMEnv (same parameters and set()), but
+// it only forwards a per-block snapshot of them to a slot of pcmVoiceEngine(),
+// which renders every playing note in one pass from MyApp::onSound.
+class PCMBatchVoice : public PCMEnv
+{
+public:
+  int slot = -1;
+
+  void onProcess(AudioIOData &io) override
+  {
+    // Claimed here rather than in onTriggerOn, which may run off the audio thread
+    if (starting) {
+      starting = false;
+      claim();
+      if (slot >= 0) {
+        pcmVoiceEngine().startAt(slot, io.frame() + 1); // as PCMEnv, from the note's onset in its first block
+      }
+    }
+
+    if (slot < 0 || pcmVoiceEngine().ended(slot)) {
+      stop();
+      return;
+    }
 
-    // Reset envelope
-    mAmpEnv.reset();
+    sendControls();
+  }
+
+  // Only records the note; the engine isn't touched until onProcess
+  void onTriggerOn() override {
+    starting = true;
+    startHold = holdFrames;
+    holdFrames = -1;
+
+    int midiNote = getInternalParameterValue("midiNote");
+    this->currentTimbre = SoundBank[getInternalParameterValue("timbre")];
+    KeyZone zone = this->currentTimbre->zone(midiNote);
+    this->sampleRef = zone.sample;
+    this->startRate = zone.rate;
+    this->startKey = int(getInternalParameterValue("timbre")) * 128 + midiNote;
+
+    // Same silent fallback as PCMEnv while the bank is loading: no slot is claimed
+    if (this->sampleRef && (!this->sampleRef->ready() || this->sampleRef->buffer->frameCount == 0))
+    {
+      this->sampleRef = nullptr;
+    }
   }
 
   void onTriggerOff() override {
-    mAmpEnv.release();
+    if (starting) {
+      startHold = 0; // off before the first block: release on its first frame
+    } else if (slot >= 0) {
+      pcmVoiceEngine().release(slot);
+    }
+  }
+
+  // Voice limiting works on the slot: VoiceManager sees the engine's level
+  // and a steal fades the slot out
+  float loudness() const override { return slot >= 0 ? pcmVoiceEngine().loudness(slot) : 0; }
+
+  void steal() override {
+    if (slot >= 0) {
+      pcmVoiceEngine().fadeOut(slot, voiceManager().fadeSeconds);
+    }
+  }
+
+private:
+  bool starting = false; // triggered, slot not yet claimed
+  float startRate = 1;
+  int startHold = -1;
+
+  void sendControls()
+  {
+    float amplitude = getInternalParameterValue("amplitude");
+    float pan = getInternalParameterValue("pan");
+
+    if (pan != lastPan) {
+      mPan.pos(pan);
+      mPan(1.f, panLeft, panRight);
+      lastPan = pan;
+    }
+
+    float gain = amplitude / attenuation;
+    pcmVoiceEngine().control(slot, getInternalParameterValue("interpolate"), gain * panLeft, gain * panRight,
+                             getInternalParameterValue("attackTime"), getInternalParameterValue("releaseTime"));
+  }
+
+  void claim()
+  {
+    if (slot >= 0) {
+      pcmVoiceEngine().stop(slot); // retriggered before the last note ended
+      slot = -1;
+    }
+    if (!this->sampleRef) {
+      return;
+    }
+
+    // Every slot busy: drop the note rather than block the audio thread
+    this->slot = pcmVoiceEngine().start(*this->sampleRef->buffer, startRate);
+    if (this->slot < 0) {
+      return;
+    }
+
+    pcmVoiceEngine().hold(this->slot, startHold);
+    this->attenuation = 2;
+    this->lastPan = 2;
+
+    // May fade out other voices to stay under the cap
+    voiceManager().started(this, startKey);
+  }
+
+  void stop()
+  {
+    if (slot >= 0) {
+      pcmVoiceEngine().stop(slot);
+      slot = -1;
+    }
+    voiceManager().finished(this);
+    free();
   }
 };
 
+// PCM_BATCH_VOICES (a CMake option) renders notes with PCMVoiceEngine
+#ifdef PCM_BATCH_VOICES
+using AppVoice = PCMBatchVoice;
+#else
+using AppVoice = PCMEnv;
+#endif
+
 
 
 
@@ -286,15 +271,26 @@ public:
 class MyApp : public App
 {
 public:
-  SynthGUIManager<PCMEnv> synthManager{"PCMEnv"};
+  SynthGUIManager<AppVoice> synthManager{"PCMEnv"};
   int octaveShift = 0;
 
+  // Sequences loaded in bulk (--sequence): one sorted array, played from
+  // onSound with voices of its own, taken as each note fires
+  PatternBuffer sequence;
+  PatternPlayer player;
+  VoicePool<AppVoice> sequenceVoices;
+
+  // Before audio starts. Twice the voice cap: a stolen voice keeps fading
+  // for a few milliseconds after the note that replaced it has started.
+  void allocateSequenceVoices() { sequenceVoices.allocate(2 * std::max(voiceManager().maxVoices, 1)); }
+
   virtual void onInit( ) override {
     imguiInit();
     navControl().active(false);  // Disable navigation via keyboard, since we
                               // will be using keyboard for note triggering
     // Set sampling rate for Gamma objects from app's audio
     gam::sampleRate(audioIO().framesPerSecond());
+    pcmVoiceEngine().sampleRate = audioIO().framesPerSecond();
   }
 
     void onCreate() override {
@@ -304,12 +300,41 @@ public:
     }
 
     void onSound(AudioIOData& io) override {
+        RtCheckScope realtime; // counts allocations and locks in PCM_RT_CHECK builds
+        voiceManager().beginCallback();
+
+        // Notes start and release on their own frames, whatever the buffer
+        // size; with every sequence voice busy the note is dropped
+        player.advance(
+          io.framesPerBuffer(),
+          [this](const PatternEvent& e, int, int offset) {
+            AppVoice* voice = sequenceVoices.take();
+            if (voice) {
+              voice->set(e);
+              voice->holdFrames = player.holdFrames(e, offset);
+              sequenceVoices.start(voice, offset);
+            }
+          },
+          [](int, int) {}); // released by holdFrames
+
         synthManager.render(io);  // Render audio
+        sequenceVoices.render(io);
+#ifdef PCM_BATCH_VOICES
+        // Voices only forwarded their controls above; mix them all here
+        pcmVoiceEngine().render(io.outBuffer(0), io.outBuffer(1), io.framesPerBuffer());
+#endif
+        voiceManager().endCallback(io.framesPerBuffer() / io.framesPerSecond());
     }
 
     void onAnimate(double dt) override {
         imguiBeginFrame();
         synthManager.drawSynthControlPanel();
+        if (!soundBankLoader.complete()) {
+          ImGui::Begin("Sound bank");
+          ImGui::Text("Loading samples %d/%d", soundBankLoader.loaded(), soundBankLoader.count());
+          ImGui::ProgressBar(soundBankLoader.progress());
+          ImGui::End();
+        }
         imguiEndFrame();
     }
 
@@ -360,10 +385,113 @@ public:
       return true;
     }
 
-      void onExit() override { imguiShutdown(); }
+      void onExit() override {
+        imguiShutdown();
+        voiceManager().printStats();
+        if (sequenceVoices.dropped > 0) {
+          PCM_LOG(LOG_WARN, "Sequence: ", sequenceVoices.dropped, " notes dropped with all ",
+                  sequenceVoices.capacity(), " voices busy");
+        }
+        RtCheck::report("Audio callbacks");
+#ifdef PCM_BATCH_VOICES
+        pcmVoiceEngine().printStats();
+#endif
+      }
 };
 
-int main()
+// `app --rt-check`: play every PCMEnv-data/*.synthSequence through onSound
+// offline, with RtCheck armed for each callback, and fail on any allocation or
+// lock it catches. Needs a PCM_RT_CHECK build; CMake runs it as a test.
+int checkSequences(MyApp& app)
+{
+#ifdef PCM_HAVE_RT_CHECK
+  AudioIOData& io = app.audioIO();
+  gam::sampleRate(io.framesPerSecond());
+  pcmVoiceEngine().sampleRate = io.framesPerSecond();
+  app.synthManager.synth().allocatePolyphony<AppVoice>(voiceManager().maxVoices);
+  app.allocateSequenceVoices();
+
+  glob_t matches;
+  glob("PCMEnv-data/*.synthSequence", 0, nullptr, &matches);
+  std::vector<std::string> paths(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+  globfree(&matches);
+
+  long total = 0;
+  for (const std::string& path : paths)
+  {
+    // Last note-off, plus the longest release the voice allows
+    std::ifstream file(path);
+    std::string line;
+    double end = 0;
+    while (std::getline(file, line))
+    {
+      std::istringstream fields(line);
+      std::string at;
+      double start, duration;
+      if (fields >> at >> start >> duration && at == "@")
+      {
+        end = std::max(end, start + duration);
+      }
+    }
+    end += 10;
+
+    // Through allolib's sequencer, then loaded in bulk into app.player.
+    // The sequencer starts each note with PolySynth::triggerOn, which locks
+    // the synth's insert list, so that pass allows locks and reports them
+    // apart; the bulk pass starts notes from app.sequenceVoices and allows
+    // nothing.
+    std::string name = path.substr(path.find('/') + 1);
+    for (int bulk = 0; bulk < 2; bulk++)
+    {
+      RtCheck::allowLocks(!bulk);
+      if (bulk)
+      {
+        app.sequence = PatternBuffer();
+        readSynthSequence(path, app.sequence.events);
+        app.sequence.finish();
+        app.player.play(app.sequence.begin(), app.sequence.end(), io.framesPerSecond());
+      }
+      else
+      {
+        app.synthManager.synthSequencer().playSequence(name);
+      }
+
+      long callbacks = long(end * io.framesPerSecond() / io.framesPerBuffer());
+      for (long i = 0; i < callbacks; i++)
+      {
+        io.zeroOut();
+        io.frame(0);
+        app.onSound(io);
+      }
+
+      RtCheck::allowLocks(false);
+
+      std::string label = name + (bulk ? " (bulk)" : "");
+      long allowed = RtCheck::allowedLocks();
+      long found = RtCheck::report(label);
+      total += found;
+      if (bulk)
+      {
+        PCM_LOG(found ? LOG_ERROR : LOG_INFO, label, ": ", callbacks, " callbacks, ", found, " real-time violations");
+      }
+      else
+      {
+        PCM_LOG(found ? LOG_ERROR : LOG_INFO, label, ": ", callbacks, " callbacks, ", found, " real-time violations, ",
+                allowed, " allowed locks in PolySynth::triggerOn");
+      }
+      logger().flush();
+    }
+  }
+
+  return paths.empty() || total > 0 ? 1 : 0;
+#else
+  (void)app;
+  PCM_LOG(LOG_ERROR, "--rt-check needs a build with PCM_RT_CHECK on glibc");
+  return 2;
+#endif
+}
+
+int main(int argc, char* argv[])
 {
   // Create app instance
   MyApp app;
@@ -371,6 +499,150 @@ int main()
   // Set up audio
   app.configureAudio(48000., 128, 2, 0);
 
+  // Logging: --log-file PATH instead of stdout, --log-level debug|info|warn|error
+  for (int i = 1; i + 1 < argc; i++)
+  {
+    std::string option = argv[i], value = argv[i + 1];
+    if (option == "--log-file" && !logger().open(value))
+    {
+      PCM_LOG(LOG_WARN, "Cannot open log file ", value, "; logging to stdout");
+    }
+    else if (option == "--log-level")
+    {
+      logger().level = value == "debug" ? LOG_DEBUG : value == "warn" ? LOG_WARN : value == "error" ? LOG_ERROR : LOG_INFO;
+    }
+  }
+
+  // Samples are converted to the device rate as they load
+  SampleBuffer::targetRate() = app.audioIO().framesPerSecond();
+
+  // The disk streams' rings (a few MB) are allocated here, not by whichever
+  // voice first touches the streamer on the audio thread
+  sampleStreamer();
+
+  // Pack the current SoundBank into a single bank file and exit
+  if (argc > 1 && std::string(argv[1]) == "--pack-bank")
+  {
+    SampleBuffer::streamLongerThan() = 0; // the bank stores every frame
+    soundBankLoader.start(SoundBank);
+    soundBankLoader.wait();
+    return SampleBank::write(argc > 2 ? argv[2] : SAMPLE_BANK_PATH, SoundBank) ? 0 : 1;
+  }
+
+  // Pack a .synthSequence into a .pcmseq, or back, by the output's extension, and exit
+  if (argc > 3 && std::string(argv[1]) == "--convert-sequence")
+  {
+    bool ok = convertSequence(argv[2], argv[3]);
+    logger().flush();
+    return ok ? 0 : 1;
+  }
+
+  // A matching packed bank replaces per-file loading with one mmap
+  SampleBank bank;
+  if (bank.open(SAMPLE_BANK_PATH))
+  {
+    if (bank.matches(SoundBank))
+    {
+      std::vector<Patch*> packed = bank.patchList();
+      for (Patch* patch : SoundBank)
+      {
+        delete patch;
+      }
+      SoundBank = packed;
+      PCM_LOG(LOG_INFO, "Using sample bank ", SAMPLE_BANK_PATH);
+    }
+    else
+    {
+      PCM_LOG(LOG_WARN, SAMPLE_BANK_PATH, " is out of date; run with --pack-bank to rebuild it");
+    }
+  }
+
+  // Voice limiting: --max-voices N, --cpu-budget 0.75, --steal oldest|quietest|same-note,
+  // --silence-db -90 (or off) to free voices whose remaining sample can't be heard
+  for (int i = 1; i + 1 < argc; i++)
+  {
+    std::string option = argv[i], value = argv[i + 1];
+    if (option == "--max-voices")
+    {
+      voiceManager().maxVoices = std::atoi(value.c_str());
+    }
+    else if (option == "--cpu-budget")
+    {
+      voiceManager().budget = std::atof(value.c_str());
+    }
+    else if (option == "--steal")
+    {
+      voiceManager().policy = value == "quietest" ? STEAL_QUIETEST : value == "same-note" ? STEAL_SAME_NOTE : STEAL_OLDEST;
+    }
+    else if (option == "--silence-db")
+    {
+      float threshold = value == "off" ? 0 : std::pow(10.f, float(std::atof(value.c_str())) / 20);
+      voiceManager().silenceThreshold = threshold;
+      pcmVoiceEngine().silenceThreshold = threshold;
+    }
+  }
+
+#ifdef PCM_BATCH_VOICES
+  // `--render-threads N` spreads voices over N worker threads besides the audio thread
+  for (int i = 1; i + 1 < argc; i++)
+  {
+    if (std::string(argv[i]) == "--render-threads")
+    {
+      pcmVoiceEngine().threads(std::atoi(argv[i + 1]), app.audioIO().framesPerBuffer());
+    }
+  }
+#endif
+
+  // Offline real-time safety check over the bundled sequences
+  if (argc > 1 && std::string(argv[1]) == "--rt-check")
+  {
+    soundBankLoader.start(SoundBank);
+    soundBankLoader.wait();
+    return checkSequences(app);
+  }
+
+  // `--sequence FILE`, repeatable: play .synthSequence or packed .pcmseq
+  // files back to back, loaded in bulk instead of through the GUI's sequencer
+  auto begin = std::chrono::steady_clock::now();
+  int files = 0;
+  double end = 0;
+  for (int i = 1; i + 1 < argc; i++)
+  {
+    if (std::string(argv[i]) == "--sequence")
+    {
+      end = loadSequence(argv[i + 1], app.sequence.events, end);
+      if (end < 0)
+      {
+        PCM_LOG(LOG_ERROR, "Cannot read sequence ", argv[i + 1]);
+        logger().flush();
+        return 1;
+      }
+      files++;
+    }
+  }
+  if (files > 0)
+  {
+    // Timbres past the end of the bank have nothing to play
+    std::vector<PatternEvent>& events = app.sequence.events;
+    size_t loaded = events.size();
+    events.erase(std::remove_if(events.begin(), events.end(),
+                                [](const PatternEvent& e) { return e.timbre >= SoundBank.size(); }),
+                 events.end());
+    if (events.size() < loaded)
+    {
+      PCM_LOG(LOG_WARN, "Sequence: skipped ", int(loaded - events.size()), " notes with no timbre in the bank");
+    }
+    app.sequence.finish();
+    app.allocateSequenceVoices();
+    app.player.play(app.sequence.begin(), app.sequence.end(), app.audioIO().framesPerSecond());
+    PCM_LOG(LOG_INFO, "Sequence: ", int(app.sequence.events.size()), " notes from ", files, " files loaded in ",
+            long(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count()),
+            " us, ", long(app.sequence.events.capacity() * sizeof(PatternEvent)), " bytes");
+  }
+
+  // Decode the bank in the background so the window and audio open right away
+  soundBankLoader.start(SoundBank);
+
   app.start();
 
   return 0;